@@ -0,0 +1,189 @@
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <vector>
+
+#include "CriticalSection.h"
+#include "ExtIO.h"
+#include "Observable.h"
+#include "TimeDelta.h"
+
+// Builds a response similar to what the module sends back for an inquiry,
+// one device per line.
+static string MakeInquiryResponse(INT32U lineCount)
+{
+    string response;
+    for (INT32U i = 0; i < lineCount; i++)
+    {
+        char line[64];
+        snprintf(line, sizeof(line), "INQUIRY 00025B00%04X 240404 -%02udB\r", i & 0xFFFF, 40 + (i % 50));
+        response += line;
+    }
+    response += "OK\r";
+    return response;
+}
+
+class CBenchObserver
+{
+  public:
+    CBenchObserver() : m_count(0)
+    {
+    }
+
+    ERROR_CODE_T OnEvent(INT32U eventInfo)
+    {
+        m_count += eventInfo;
+        return STATUS_SUCCESS;
+    }
+
+    INT32U m_count;
+};
+
+//
+// Observable
+//
+
+static void BM_ObservableRegister(benchmark::State &state)
+{
+    CBenchObserver observer;
+    for (auto _ : state)
+    {
+        Observable<INT32U> observable;
+        vector<shared_ptr<IObserverHandle<INT32U> > > handles;
+        handles.reserve(state.range(0));
+        while (handles.size() < (size_t)state.range(0))
+        {
+            handles.push_back(observable.registerObserver(&observer, &CBenchObserver::OnEvent));
+        }
+        benchmark::DoNotOptimize(handles.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ObservableRegister)->RangeMultiplier(10)->Range(1, 1000);
+
+static void BM_ObservableNotify(benchmark::State &state)
+{
+    CBenchObserver observer;
+    Observable<INT32U> observable;
+    vector<shared_ptr<IObserverHandle<INT32U> > > handles;
+    for (int64_t i = 0; i < state.range(0); i++)
+    {
+        handles.push_back(observable.registerObserver(&observer, &CBenchObserver::OnEvent));
+    }
+
+    for (auto _ : state)
+    {
+        observable.notifyObservers(1);
+    }
+    benchmark::DoNotOptimize(observer.m_count);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ObservableNotify)->RangeMultiplier(10)->Range(1, 1000);
+
+//
+// Critical sections
+//
+
+static void BM_CriticalSectionUncontended(benchmark::State &state)
+{
+    CCriticalSection cs;
+    for (auto _ : state)
+    {
+        cs.Lock(0);
+        cs.Unlock();
+    }
+}
+BENCHMARK(BM_CriticalSectionUncontended);
+
+static CCriticalSection g_contendedCs;
+
+static void BM_CriticalSectionContended(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        g_contendedCs.Lock(0);
+        g_contendedCs.Unlock();
+    }
+}
+BENCHMARK(BM_CriticalSectionContended)->Threads(2)->Threads(4)->Threads(8)->UseRealTime();
+
+static void BM_SimpleLock(benchmark::State &state)
+{
+    CCriticalSection cs;
+    for (auto _ : state)
+    {
+        CSimpleLock lock(&cs);
+        benchmark::DoNotOptimize(lock.IsLocked());
+    }
+}
+BENCHMARK(BM_SimpleLock);
+
+//
+// String helpers
+//
+
+static void BM_SplitString(benchmark::State &state)
+{
+    string response = MakeInquiryResponse(state.range(0));
+    vector<string> lines;
+    for (auto _ : state)
+    {
+        lines.clear();
+        SplitString(lines, response, '\r', true);
+        benchmark::DoNotOptimize(lines.data());
+    }
+    state.SetBytesProcessed(state.iterations() * response.size());
+}
+BENCHMARK(BM_SplitString)->RangeMultiplier(4)->Range(1, 256);
+
+static void BM_Trim(benchmark::State &state)
+{
+    string line = "  " + MakeInquiryResponse(state.range(0)) + " \r\n";
+    for (auto _ : state)
+    {
+        string copy = line;
+        benchmark::DoNotOptimize(trim(copy).data());
+    }
+    state.SetBytesProcessed(state.iterations() * line.size());
+}
+BENCHMARK(BM_Trim)->RangeMultiplier(4)->Range(1, 256);
+
+static void BM_ExtStricmp(benchmark::State &state)
+{
+    string lhs = MakeInquiryResponse(state.range(0));
+    string rhs = to_lower(lhs);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(ext_stricmp(lhs.c_str(), rhs.c_str()));
+    }
+    state.SetBytesProcessed(state.iterations() * lhs.size());
+}
+BENCHMARK(BM_ExtStricmp)->RangeMultiplier(4)->Range(1, 256);
+
+static void BM_ToString(benchmark::State &state)
+{
+    INT32S value = (INT32S)state.range(0);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(to_string<INT32S>(value).data());
+    }
+}
+BENCHMARK(BM_ToString)->Arg(7)->Arg(115200)->Arg(-2147483647);
+
+//
+// Timers
+//
+
+static void BM_TimeDeltaIsTimeExpired(benchmark::State &state)
+{
+    CTimeDelta timer;
+    timer.ResetTime(state.range(0));
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(timer.IsTimeExpired());
+    }
+}
+// 0 ms expires immediately and takes the cached path, 60000 ms never expires.
+BENCHMARK(BM_TimeDeltaIsTimeExpired)->Arg(0)->Arg(60000);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,137 @@
+#include "BTADeviceDiscovery.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <dirent.h>
+#include <mutex>
+#include <stdlib.h>
+#include <thread>
+
+#include "BTADeviceFactory.h"
+#include "CancellableUart.h"
+#include "Metrics.h"
+#include "uart.h"
+
+#define TTY_USB_PREFIX "ttyUSB"
+
+// Shared between the caller and the probe threads.
+struct DiscoveryState
+{
+    DiscoveryState(size_t portCount) : pending(portCount), devices(portCount)
+    {
+    }
+
+    mutex lock;
+    condition_variable done;
+    size_t pending;
+    vector<DiscoveredBTADevice> devices;
+};
+
+static void ProbePort(shared_ptr<DiscoveryState> pState, size_t index, INT32U port,
+                      shared_ptr<CCancellableUart> pProbeUart)
+{
+    shared_ptr<IUart> pUart = make_shared<CInstrumentedUart>(pProbeUart, (INT8U)port);
+    shared_ptr<IBTADeviceDriver> pDriver;
+
+    // The factory walks the supported baud rates in priority order itself.
+    // A probe cancelled at the deadline fails here instead of finishing late.
+    if (FAILED(CBTADeviceFactory::CreateBTADeviceDriver(pUart, pDriver)) || pProbeUart->IsCancelled())
+    {
+        pDriver.reset();
+        pUart->Close();
+    }
+
+    unique_lock<mutex> guard(pState->lock);
+    pState->devices[index].port = port;
+    pState->devices[index].pUart = pUart;
+    pState->devices[index].pDriver = pDriver;
+    pState->pending--;
+    pState->done.notify_all();
+}
+
+ERROR_CODE_T CBTADeviceDiscovery::EnumeratePorts(vector<INT32U> &portsOut)
+{
+    portsOut.clear();
+
+    DIR *pDir = opendir("/dev");
+    RETURN_EC_IF_NULL(ERROR_FAILED, pDir);
+
+    struct dirent *pEntry;
+    while ((pEntry = readdir(pDir)) != NULL)
+    {
+        const CHAR8 *pName = pEntry->d_name;
+        if (strncmp(pName, TTY_USB_PREFIX, strlen(TTY_USB_PREFIX)) != 0)
+            continue;
+
+        const CHAR8 *pNumber = pName + strlen(TTY_USB_PREFIX);
+        CHAR8 *pEnd = NULL;
+        unsigned long port = strtoul(pNumber, &pEnd, 10);
+        if (pEnd != pNumber && *pEnd == '\0')
+        {
+            portsOut.push_back((INT32U)port);
+        }
+    }
+    closedir(pDir);
+
+    sort(portsOut.begin(), portsOut.end());
+    return STATUS_SUCCESS;
+}
+
+ERROR_CODE_T CBTADeviceDiscovery::DiscoverDevices(const vector<INT32U> &ports, INT32U deadlineMS,
+                                                  vector<DiscoveredBTADevice> &devicesOut,
+                                                  const UartFaultConfig *pFaults)
+{
+    devicesOut.clear();
+    RETURN_EC_IF_TRUE(ERROR_INVALID_PARAMETER, ports.empty());
+
+    shared_ptr<DiscoveryState> pState = make_shared<DiscoveryState>(ports.size());
+    vector<shared_ptr<CCancellableUart> > probeUarts;
+    vector<thread> probes;
+    for (size_t i = 0; i < ports.size(); i++)
+    {
+        shared_ptr<IUart> pPortUart = make_shared<CuArt>(ports[i]);
+        if (pFaults != NULL)
+        {
+            // Offset the seed so the ports don't all fail in lockstep.
+            UartFaultConfig faults = *pFaults;
+            faults.seed += ports[i];
+            pPortUart = make_shared<CFaultInjectingUart>(pPortUart, faults);
+        }
+        probeUarts.push_back(make_shared<CCancellableUart>(pPortUart));
+        probes.push_back(thread(ProbePort, pState, i, ports[i], probeUarts.back()));
+    }
+
+    unique_lock<mutex> guard(pState->lock);
+    if (!pState->done.wait_for(guard, chrono::milliseconds(deadlineMS), [pState] { return pState->pending == 0; }))
+    {
+        // Cut the stragglers off so nothing is left probing in the
+        // background; they give up within one response timeout.
+        for (size_t i = 0; i < ports.size(); i++)
+        {
+            if (!pState->devices[i].pUart)
+            {
+                LogPrintf(DEBUG_NORMAL_ERROR, "discovery", "Port %u missed the discovery deadline\r\n", ports[i]);
+                probeUarts[i]->Cancel();
+            }
+        }
+    }
+    guard.unlock();
+
+    for (size_t i = 0; i < probes.size(); i++)
+    {
+        probes[i].join();
+    }
+    guard.lock();
+
+    for (size_t i = 0; i < pState->devices.size(); i++)
+    {
+        if (pState->devices[i].pDriver)
+        {
+            devicesOut.push_back(pState->devices[i]);
+        }
+    }
+
+    RETURN_EC_IF_TRUE(ERROR_FAILED, devicesOut.empty());
+    return STATUS_SUCCESS;
+}
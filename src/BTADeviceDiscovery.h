@@ -0,0 +1,33 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "BTADeviceDriver.h"
+#include "FaultInjectingUart.h"
+#include "iuart.h"
+#include "types.h"
+
+struct DiscoveredBTADevice
+{
+    INT32U port;
+    shared_ptr<IUart> pUart;
+    shared_ptr<IBTADeviceDriver> pDriver;
+};
+
+// Probes every candidate serial port at the same time instead of one after
+// another, so bringing up a rack of cards costs one probe timeout in total.
+class CBTADeviceDiscovery
+{
+  public:
+    // Lists the /dev/ttyUSB<n> ports present on this host, lowest first.
+    static ERROR_CODE_T EnumeratePorts(vector<INT32U> &portsOut);
+
+    // Runs the device factory on each port in parallel and returns the ports
+    // that produced a ready driver before the deadline. Probes still running
+    // at the deadline are cancelled and joined before this returns. With
+    // pFaults set, every port is probed and kept behind a fault injector.
+    static ERROR_CODE_T DiscoverDevices(const vector<INT32U> &ports, INT32U deadlineMS,
+                                        vector<DiscoveredBTADevice> &devicesOut,
+                                        const UartFaultConfig *pFaults = NULL);
+};
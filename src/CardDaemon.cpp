@@ -0,0 +1,86 @@
+#include "CardDaemon.h"
+
+#include "BtAddress.h"
+
+CCardDaemon::CCardDaemon(CCardOrchestrator *pOrchestrator) : m_pOrchestrator(pOrchestrator)
+{
+}
+
+CCardDaemon::~CCardDaemon()
+{
+    Stop();
+}
+
+ERROR_CODE_T CCardDaemon::AttachCard(shared_ptr<CCardStateMachine> pCard)
+{
+    RETURN_EC_IF_NULL(ERROR_INVALID_PARAMETER, pCard);
+    m_observers.push_back(pCard->registerObserver(this, &CCardDaemon::OnCardEvent));
+    return STATUS_SUCCESS;
+}
+
+ERROR_CODE_T CCardDaemon::Start(const string &socketPath)
+{
+    RETURN_EC_IF_NULL(ERROR_NOT_INITIALIZED, m_pOrchestrator);
+
+    m_server.SetCommandHandler([this](INT8U cardNumber, INT8U command, INT32U arg, SocketCommandDone done) {
+        OnCommand(cardNumber, command, arg, done);
+    });
+    return m_server.Start(socketPath);
+}
+
+void CCardDaemon::Stop(void)
+{
+    m_server.Stop();
+    m_observers.clear();
+}
+
+ERROR_CODE_T CCardDaemon::OnCardEvent(CardEvent event)
+{
+    SocketEvent socketEvent;
+    socketEvent.type = (INT8U)event.type;
+    socketEvent.cardNumber = event.cardNumber;
+    socketEvent.address = 0;
+    socketEvent.name = event.btDeviceName;
+    if (!event.btAddress.empty())
+    {
+        PackBtAddress(event.btAddress.c_str(), socketEvent.address);
+    }
+
+    m_server.Publish(socketEvent);
+    return STATUS_SUCCESS;
+}
+
+// Runs on the event server's thread. The command is queued on the card and
+// the queue drained on the card's strand, so it never overlaps a tick and a
+// pet is not stuck behind a burst of inquiries.
+void CCardDaemon::OnCommand(INT8U cardNumber, INT8U command, INT32U arg, SocketCommandDone done)
+{
+    shared_ptr<CCardStateMachine> pCard = m_pOrchestrator->GetCard(cardNumber);
+    if (!pCard)
+    {
+        done(ERROR_INVALID_PARAMETER);
+        return;
+    }
+
+    // A card that dropped out has a module that is no longer ready.
+    if (!m_pOrchestrator->IsCardActive(cardNumber))
+    {
+        done(ERROR_NOT_INITIALIZED);
+        return;
+    }
+
+    pCard->SubmitCommand(command, arg, done);
+    CCardOrchestrator *pOrchestrator = m_pOrchestrator;
+    ERROR_CODE_T result = m_pOrchestrator->PostToCard(cardNumber, [pOrchestrator, pCard, cardNumber]() {
+        // The card may have dropped out after the check above.
+        if (pOrchestrator->IsCardActive(cardNumber))
+            pCard->RunQueuedCommands();
+        else
+            pCard->CancelQueuedCommands();
+    });
+    if (FAILED(result))
+    {
+        // Nothing will drain the queue any more.
+        pCard->CancelQueuedCommands();
+    }
+}
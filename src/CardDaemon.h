@@ -0,0 +1,32 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "CardOrchestrator.h"
+#include "EventSocketServer.h"
+#include "types.h"
+
+// Daemon-mode front end: publishes every card's events on a Unix socket
+// using the EventSocketServer framing and runs commands supervisors send
+// back on the target card's strand.
+class CCardDaemon
+{
+  public:
+    CCardDaemon(CCardOrchestrator *pOrchestrator);
+    ~CCardDaemon();
+
+    // Subscribes to the card's events; call for every card before Start.
+    ERROR_CODE_T AttachCard(shared_ptr<CCardStateMachine> pCard);
+    ERROR_CODE_T Start(const string &socketPath);
+    void Stop(void);
+
+  private:
+    ERROR_CODE_T OnCardEvent(CardEvent event);
+    void OnCommand(INT8U cardNumber, INT8U command, INT32U arg, SocketCommandDone done);
+
+    CCardOrchestrator *m_pOrchestrator;
+    CEventSocketServer m_server;
+    vector<shared_ptr<IObserverHandle<CardEvent> > > m_observers;
+};
@@ -0,0 +1,625 @@
+#include "CardOrchestrator.h"
+
+#include "ClockSource.h"
+#include "ConfigShadow.h"
+#include "Metrics.h"
+#include "Profiler.h"
+#include "UartDrain.h"
+
+// Bump whenever InitializeDeviceConfiguration changes what it writes to the
+// module so cards configured by an older build get a full reconfigure.
+#define BTA_CONFIG_REVISION "1"
+
+// Read back from the module into the fingerprint. The address ties it to
+// this particular module; the others change if the module lost its
+// configuration behind our back.
+static const CHAR8 *const BTA_FINGERPRINT_OPTIONS[] = {"BDADDR", "NAME", "PROFILES", "AUTOCONN"};
+#define BTA_FINGERPRINT_TIMEOUT_MS 1000
+
+// Upper bound for discarding stale RX bytes; a quiet line returns after a
+// few character times. The factory picks the baud rate, so the drain
+// assumes the slowest one.
+#define CARD_RX_DRAIN_TIMEOUT_MS 50
+
+static uint64_t GetSteadyNowMS(void)
+{
+    return GetClockSource().GetNowUs() / 1000;
+}
+
+CCardStateMachine::CCardStateMachine(INT8U cardNumber, shared_ptr<IUart> pUart, shared_ptr<IBTADeviceDriver> pDriver,
+                                     shared_ptr<CBTAdapterConfigTable> pAdapterConfigTable,
+                                     const CardSettings &settings)
+    : m_cardNumber(cardNumber), m_pUart(pUart), m_pDriver(pDriver), m_pAdapterConfigTable(pAdapterConfigTable),
+      m_settings(settings),
+      m_status([this](DeviceStatusField_t field, bool &valueOut) { return FetchStatus(field, valueOut); },
+               settings.statusTtlMS),
+      m_commandQueue("card" + to_string(cardNumber)),
+      m_inquiryActive(false), m_inquiryStartUs(0), m_reconnect(this)
+{
+    m_linkLiveness.SetWatchdogWindow(settings.watchdogWindowMS, LIVENESS_DEFAULT_PET_PERCENT);
+}
+
+INT8U CCardStateMachine::GetCardNumber(void) const
+{
+    return m_cardNumber;
+}
+
+shared_ptr<IBTADeviceDriver> CCardStateMachine::GetDriver(void) const
+{
+    return m_pDriver;
+}
+
+ERROR_CODE_T CCardStateMachine::Setup(void)
+{
+    RETURN_EC_IF_NULL(ERROR_NOT_INITIALIZED, m_pDriver);
+
+    m_inquiryObserver = m_inquiryStream.registerObserver(this, &CCardStateMachine::OnInquiryEvent);
+
+    // A module that can't be read back is treated as not matching.
+    CConfigFingerprint fingerprint;
+    string fingerprintPath = m_settings.stateDir + "/card" + to_string(m_cardNumber) + ".fp";
+    bool readBack = SUCCEEDED(ReadFingerprint(fingerprint));
+
+    if (!m_settings.forceReset && readBack && fingerprint.MatchesStored(fingerprintPath) &&
+        m_pDriver->IsDeviceReadyForUse())
+    {
+        LogPrintf(DEBUG_TRACE_INFO, "card", "Card %u: configuration fingerprint matches, skipping factory reset\r\n",
+                  m_cardNumber);
+    }
+    else
+    {
+        // Drop the old fingerprint first so an interrupted reconfigure is
+        // never mistaken for a good one on the next start.
+        fingerprint.Remove(fingerprintPath);
+
+        LogPrintf(DEBUG_TRACE_INFO, "card", "Card %u: performing factory reset\r\n", m_cardNumber);
+        CCommandTimer resetTimer(m_cardNumber, "factory_reset");
+        resetTimer.Finish(m_pDriver->FactoryReset());
+
+        LogPrintf(DEBUG_TRACE_INFO, "card", "Card %u: running IBTADeviceDriver\r\n", m_cardNumber);
+        CCommandTimer configTimer(m_cardNumber, "config");
+        // Store what the module reports after configuring, not what was
+        // asked of it, so the next start compares like with like.
+        CConfigFingerprint applied;
+        if (SUCCEEDED(configTimer.Finish(m_pDriver->InitializeDeviceConfiguration())) &&
+            SUCCEEDED(ReadFingerprint(applied)))
+        {
+            applied.Store(fingerprintPath);
+        }
+    }
+    m_pDriver->SetDeviceMode(BTA_DEVICE_MODE_INPUT);
+    if (m_pAdapterConfigTable)
+    {
+        m_pAdapterConfigTable->SetAdapterOnline(m_cardNumber, true);
+    }
+
+    if (m_settings.mode == QualMode || m_settings.mode == PlayActiveSong)
+    {
+        RETURN_IF_FAILED(LoadScript());
+        m_sequencer.Start(&m_schedule, GetSteadyNowMS());
+    }
+
+    m_status.Invalidate();
+    return STATUS_SUCCESS;
+}
+
+void CCardStateMachine::MarkOffline(void)
+{
+    if (m_reconnect.GetState() == RECONNECT_STATE_CONNECTED)
+    {
+        NotifyDisconnection();
+    }
+    if (m_pAdapterConfigTable)
+    {
+        m_pAdapterConfigTable->SetAdapterOnline(m_cardNumber, false);
+    }
+}
+
+ERROR_CODE_T CCardStateMachine::ReadFingerprint(CConfigFingerprint &fingerprintOut)
+{
+    RETURN_EC_IF_NULL(ERROR_NOT_INITIALIZED, m_pUart);
+
+    fingerprintOut.Add("revision", BTA_CONFIG_REVISION);
+    fingerprintOut.Add("deviceMode", to_string((int)BTA_DEVICE_MODE_INPUT));
+
+    // Boot banners and leftovers from a previous run would otherwise be
+    // the first thing the read-back sees.
+    UartDrainUntilQuiet(m_pUart.get(), BAUDRATE_UNKNOWN, CARD_RX_DRAIN_TIMEOUT_MS);
+
+    // The options go out as one pipelined burst rather than a round-trip
+    // each.
+    shared_ptr<CCommandPipeline> pPipeline = make_shared<CCommandPipeline>(m_pUart);
+    pPipeline->SetUnsolicitedHandler([this](const string &line) {
+        LogPrintf(DEBUG_TRACE_INFO, "card", "Card %u: unsolicited %s\r\n", m_cardNumber, line.c_str());
+    });
+    CConfigShadow shadow(pPipeline);
+    vector<string> options(BTA_FINGERPRINT_OPTIONS,
+                           BTA_FINGERPRINT_OPTIONS + sizeof(BTA_FINGERPRINT_OPTIONS) / sizeof(BTA_FINGERPRINT_OPTIONS[0]));
+    RETURN_IF_FAILED(shadow.Populate(options, BTA_FINGERPRINT_TIMEOUT_MS));
+
+    for (size_t i = 0; i < options.size(); i++)
+    {
+        // An option the module wouldn't report still has to change the hash.
+        string value;
+        if (FAILED(shadow.GetCfgValue(value, options[i])))
+            value = "<unreadable>";
+        fingerprintOut.Add(options[i], value);
+    }
+    return STATUS_SUCCESS;
+}
+
+// One driver query per field, so the cache only asks for what a check needs.
+ERROR_CODE_T CCardStateMachine::FetchStatus(DeviceStatusField_t field, bool &valueOut)
+{
+    CCommandTimer statusTimer(m_cardNumber, "status");
+    switch (field)
+    {
+        case DEVICE_STATUS_READY:
+            valueOut = m_pDriver->IsDeviceReadyForUse();
+            break;
+        case DEVICE_STATUS_CONNECTED:
+            valueOut = m_pDriver->IsDeviceConnected();
+            break;
+        case DEVICE_STATUS_PAIRED:
+            valueOut = m_pDriver->IsPairedWithDevice();
+            break;
+        default:
+            return statusTimer.Finish(ERROR_INVALID_PARAMETER);
+    }
+    return statusTimer.Finish(STATUS_SUCCESS);
+}
+
+ERROR_CODE_T CCardStateMachine::LoadScript(void)
+{
+    if (!m_settings.scriptPath.empty())
+    {
+        RETURN_IF_FAILED(m_schedule.LoadFile(m_settings.scriptPath));
+    }
+    else
+    {
+        RETURN_IF_FAILED(m_schedule.Compile(m_settings.mode == QualMode ? CARD_QUAL_SCRIPT : CARD_PLAY_SCRIPT));
+    }
+
+    // Reject unknown commands now rather than on every cycle.
+    for (INT32U i = 0; i < m_schedule.GetCommandCount(); i++)
+    {
+        const string &name = m_schedule.GetCommand(i).name;
+        if (name != "play" && name != "inquiry")
+        {
+            LogPrintf(DEBUG_NORMAL_ERROR, "card", "Card %u: unknown script command %s\r\n", m_cardNumber,
+                      name.c_str());
+            return ERROR_INVALID_CONFIGURATION;
+        }
+    }
+
+    LogPrintf(DEBUG_TRACE_INFO, "card", "Card %u: script compiled to %u batches over %u ms\r\n", m_cardNumber,
+              m_schedule.GetBatchCount(), m_schedule.GetCycleMS());
+    return STATUS_SUCCESS;
+}
+
+void CCardStateMachine::RunScriptBatch(const CommandBatch &batch)
+{
+    for (size_t i = 0; i < batch.commands.size(); i++)
+    {
+        const ScheduledCommand &command = m_schedule.GetCommand(batch.commands[i]);
+        if (command.name == "inquiry")
+        {
+            LogPrintf(DEBUG_TRACE_INFO, "card", "Card %u: sending out inquiry command\r\n", m_cardNumber);
+            CCommandTimer inquiryTimer(m_cardNumber, "inquiry");
+            if (SUCCEEDED(inquiryTimer.Finish(m_pDriver->SendInquiry((INT8U)command.arg))))
+            {
+                m_linkLiveness.MarkActivity();
+            }
+        }
+        else if (command.name == "play")
+        {
+            CCommandTimer playTimer(m_cardNumber, "play");
+            if (playTimer.Finish(m_pDriver->PlayNextMusicSequence()) != STATUS_SUCCESS)
+            {
+                LogPrintf(DEBUG_NORMAL_ERROR, "card", "Card %u: failed to play next music sequence\r\n",
+                          m_cardNumber);
+            }
+            else
+            {
+                m_linkLiveness.MarkActivity();
+            }
+        }
+    }
+}
+
+void CCardStateMachine::PublishEvent(CardEventType_t type, const string &btAddress, const string &btDeviceName)
+{
+    CardEvent event;
+    event.type = type;
+    event.cardNumber = m_cardNumber;
+    event.btAddress = btAddress;
+    event.btDeviceName = btDeviceName;
+    notifyObservers(event);
+}
+
+void CCardStateMachine::NotifyConnection(void)
+{
+    LogPrintf(DEBUG_TRACE_INFO, "card", "Card %u: connected to device: %s\r\n", m_cardNumber,
+              m_connectDeviceAddr.c_str());
+    m_status.Invalidate();
+    // The link can come up without a known peer, e.g. on startup.
+    if (m_pAdapterConfigTable)
+    {
+        m_pAdapterConfigTable->SetConnectionState(m_cardNumber, true, m_connectDeviceAddr, "");
+    }
+    PublishEvent(CARD_EVENT_CONNECTED, m_connectDeviceAddr, "");
+}
+
+void CCardStateMachine::NotifyDisconnection(void)
+{
+    LogPrintf(DEBUG_TRACE_INFO, "card", "Card %u: disconnected from device: %s\r\n", m_cardNumber,
+              m_connectDeviceAddr.c_str());
+    m_status.Invalidate();
+    if (m_pAdapterConfigTable)
+    {
+        m_pAdapterConfigTable->SetConnectionState(m_cardNumber, false, "", "");
+    }
+    PublishEvent(CARD_EVENT_DISCONNECTED, m_connectDeviceAddr, "");
+}
+
+// Called for each device as soon as the inquiry reports it, so reconnect can
+// pick a target without waiting for the whole inquiry window.
+ERROR_CODE_T CCardStateMachine::OnInquiryEvent(InquiryEvent event)
+{
+    // Inquiry traffic can come with a link change the cache hasn't seen.
+    m_status.Invalidate();
+    if (event.type == INQUIRY_EVENT_COMPLETE)
+    {
+        LogPrintf(DEBUG_TRACE_INFO, "card", "Card %u: end of detected devices\r\n", m_cardNumber);
+        PublishEvent(CARD_EVENT_INQUIRY_COMPLETE, "", "");
+        return STATUS_SUCCESS;
+    }
+
+    LogPrintf(DEBUG_TRACE_INFO, "card", "Card %u: device: %s, Name: %s\r\n", m_cardNumber,
+              event.pDevice->m_btAddress.c_str(), event.pDevice->m_btDeviceName.c_str());
+    if (m_pAdapterConfigTable)
+    {
+        m_pAdapterConfigTable->AddDetectedDevice(m_cardNumber, event.pDevice->m_btAddress,
+                                                 event.pDevice->m_btDeviceName);
+    }
+    m_reconnect.OnInquiryResult(event.pDevice->m_btAddress);
+    PublishEvent(CARD_EVENT_DEVICE_FOUND, event.pDevice->m_btAddress, event.pDevice->m_btDeviceName);
+
+    return STATUS_SUCCESS;
+}
+
+void CCardStateMachine::NotifyDetectedDevices(void)
+{
+    LogPrintf(DEBUG_TRACE_INFO, "card", "Card %u: detected devices:\r\n", m_cardNumber);
+    for (auto device : m_detectedDeviceList)
+    {
+        LogPrintf(DEBUG_TRACE_INFO, "card", "Card %u: device: %s, Name: %s\r\n", m_cardNumber,
+                  device->m_btAddress.c_str(), device->m_btDeviceName.c_str());
+    }
+    LogPrintf(DEBUG_TRACE_INFO, "card", "Card %u: end of detected devices\r\n", m_cardNumber);
+}
+
+// Any answered command proves the module is alive, so only pet the watchdog
+// when nothing else has talked to it recently.
+void CCardStateMachine::PetWatchdogIfIdle(void)
+{
+    if (!m_linkLiveness.IsPetDue())
+        return;
+
+    if (SUCCEEDED(SendWatchdogPet(true)))
+    {
+        m_linkLiveness.MarkActivity();
+    }
+}
+
+ERROR_CODE_T CCardStateMachine::SendWatchdogPet(bool flushRxBuffer)
+{
+    CCommandTimer petTimer(m_cardNumber, "pet");
+    if (flushRxBuffer && m_pUart)
+    {
+        // Drain until the line goes quiet instead of letting the driver
+        // wait out its fixed flush timeout on every pet.
+        UartDrainUntilQuiet(m_pUart.get(), BAUDRATE_UNKNOWN, CARD_RX_DRAIN_TIMEOUT_MS);
+        flushRxBuffer = false;
+    }
+    return petTimer.Finish(m_pDriver->WatchdogPet(flushRxBuffer));
+}
+
+ERROR_CODE_T CCardStateMachine::Tick(INT32U &nextTickMSOut)
+{
+    PROFILE_ZONE("card_tick");
+    nextTickMSOut = CARD_TICK_PERIOD_MS;
+    if (!m_status.IsReady())
+    {
+        LogPrintf(DEBUG_NORMAL_ERROR, "card", "Card %u: device is no longer ready\r\n", m_cardNumber);
+        m_commandQueue.CancelAll();
+        return ERROR_NOT_INITIALIZED;
+    }
+
+    RunQueuedCommands();
+
+    AppState_t state = m_settings.mode;
+    if (m_sequencer.IsStarted())
+    {
+        // Sleep until the next batch is due rather than polling.
+        const CommandBatch *pBatch = m_sequencer.GetDueBatch(GetSteadyNowMS(), nextTickMSOut);
+        if (pBatch != NULL)
+        {
+            RunScriptBatch(*pBatch);
+            nextTickMSOut = m_sequencer.GetDelayMS(GetSteadyNowMS());
+        }
+        // A sparse script must not outsleep the pet threshold or the
+        // readiness check above.
+        INT32U maxTickMS = m_linkLiveness.GetPetThresholdMS();
+        if (maxTickMS > CARD_TICK_PERIOD_MS)
+        {
+            maxTickMS = CARD_TICK_PERIOD_MS;
+        }
+        if (nextTickMSOut > maxTickMS)
+        {
+            nextTickMSOut = maxTickMS;
+        }
+        PetWatchdogIfIdle();
+        return STATUS_SUCCESS;
+    }
+
+    if (state == OutputDevice)
+    {
+        ReconnectState_t previousState = m_reconnect.GetState();
+        m_reconnect.Poll();
+        ReconnectState_t reconnectState = m_reconnect.GetState();
+
+        if (reconnectState == RECONNECT_STATE_CONNECTED && previousState != RECONNECT_STATE_CONNECTED)
+        {
+            m_connectDeviceAddr = m_reconnect.GetPeer();
+            NotifyConnection();
+        }
+        else if (reconnectState != RECONNECT_STATE_CONNECTED && previousState == RECONNECT_STATE_CONNECTED)
+        {
+            NotifyDisconnection();
+        }
+
+        // Only report once per cleared list, not on every tick while connected.
+        if (reconnectState == RECONNECT_STATE_CONNECTED && !m_detectedDeviceList.empty() && !m_status.IsPaired())
+        {
+            m_detectedDeviceList.clear();
+            if (m_pAdapterConfigTable)
+            {
+                m_pAdapterConfigTable->ClearDetectedDeviceList(m_cardNumber);
+            }
+            NotifyDetectedDevices();
+        }
+
+        // An inquiry in progress keeps the link busy on its own.
+        if (reconnectState != RECONNECT_STATE_INQUIRY)
+        {
+            PetWatchdogIfIdle();
+        }
+    }
+    else
+    {
+        PetWatchdogIfIdle();
+    }
+
+    return STATUS_SUCCESS;
+}
+
+static AsyncCommandPriority_t GetCommandPriority(INT8U command)
+{
+    switch (command)
+    {
+        case CARD_COMMAND_WATCHDOG_PET:
+            return COMMAND_PRIORITY_CRITICAL;
+        case CARD_COMMAND_PLAY:
+            return COMMAND_PRIORITY_REALTIME;
+        case CARD_COMMAND_INQUIRY:
+            return COMMAND_PRIORITY_BULK;
+        default:
+            return COMMAND_PRIORITY_NORMAL;
+    }
+}
+
+void CCardStateMachine::SubmitCommand(INT8U command, INT32U arg, AsyncCommandCallback done)
+{
+    m_commandQueue.Submit(to_string(command), [this, command, arg]() { return RunCommand(command, arg); },
+                          AsyncCommandOptions(GetCommandPriority(command)), done);
+}
+
+void CCardStateMachine::RunQueuedCommands(void)
+{
+    while (m_commandQueue.RunOnce())
+    {
+    }
+}
+
+void CCardStateMachine::CancelQueuedCommands(void)
+{
+    m_commandQueue.CancelAll();
+}
+
+ERROR_CODE_T CCardStateMachine::RunCommand(INT8U command, INT32U arg)
+{
+    ERROR_CODE_T result;
+    switch (command)
+    {
+        case CARD_COMMAND_INQUIRY:
+        {
+            CCommandTimer inquiryTimer(m_cardNumber, "inquiry");
+            result = inquiryTimer.Finish(m_pDriver->SendInquiry((INT8U)arg));
+            break;
+        }
+        case CARD_COMMAND_PLAY:
+        {
+            CCommandTimer playTimer(m_cardNumber, "play");
+            result = playTimer.Finish(m_pDriver->PlayNextMusicSequence());
+            break;
+        }
+        case CARD_COMMAND_WATCHDOG_PET:
+            result = SendWatchdogPet(arg != 0);
+            break;
+        default:
+            return ERROR_CODE_NOT_SUPPORTED;
+    }
+
+    // Inquiries and playback can move the link whether or not they succeed.
+    if (command != CARD_COMMAND_WATCHDOG_PET)
+    {
+        m_status.Invalidate();
+    }
+    if (SUCCEEDED(result))
+    {
+        m_linkLiveness.MarkActivity();
+    }
+    return result;
+}
+
+bool CCardStateMachine::IsConnected(void)
+{
+    return m_status.IsConnected();
+}
+
+ERROR_CODE_T CCardStateMachine::RunInquiry(void)
+{
+    if (!m_inquiryActive)
+    {
+        m_inquiryStream.BeginInquiry();
+        m_inquiryStartUs = MetricsGetNowUs();
+    }
+
+    CCommandTimer pollTimer(m_cardNumber, "scan_poll");
+    ERROR_CODE_T result = pollTimer.Finish(m_pDriver->ScanForBtDevices(m_detectedDeviceList, 5));
+    // A poll answered with "still scanning" is still traffic the module saw.
+    if (result == STATUS_SUCCESS || result == STATUS_OPERATION_INCOMPLETE)
+    {
+        m_linkLiveness.MarkActivity();
+    }
+
+    m_inquiryActive = (result == STATUS_OPERATION_INCOMPLETE);
+    m_inquiryStream.PublishNewDevices(m_detectedDeviceList);
+    if (!m_inquiryActive)
+    {
+        // "scan" covers the whole inquiry window, as in the soak report.
+        CMetricsRegistry::GetInstance().RecordResult(m_cardNumber, "scan", MetricsGetNowUs() - m_inquiryStartUs,
+                                                     result);
+        m_inquiryStream.PublishComplete();
+    }
+
+    return result;
+}
+
+CCardOrchestrator::CCardOrchestrator(INT32U numThreads) : m_executor(numThreads), m_activeCards(0)
+{
+}
+
+CCardOrchestrator::~CCardOrchestrator()
+{
+    Stop();
+}
+
+ERROR_CODE_T CCardOrchestrator::AddCard(shared_ptr<CCardStateMachine> pCard)
+{
+    RETURN_EC_IF_NULL(ERROR_INVALID_PARAMETER, pCard);
+    RETURN_EC_IF_TRUE(ERROR_FAILED, m_executor.IsRunning());
+
+    lock_guard<mutex> guard(m_lock);
+    RETURN_EC_IF_TRUE(ERROR_INVALID_PARAMETER, m_cards.count(pCard->GetCardNumber()) != 0);
+
+    CardSlot slot;
+    slot.pCard = pCard;
+    slot.pStrand = make_shared<CExecutorStrand>(&m_executor);
+    slot.pActive = make_shared<atomic<bool> >(false);
+    m_cards[pCard->GetCardNumber()] = slot;
+    return STATUS_SUCCESS;
+}
+
+ERROR_CODE_T CCardOrchestrator::Start(void)
+{
+    RETURN_IF_FAILED(m_executor.Start());
+
+    lock_guard<mutex> guard(m_lock);
+    m_activeCards = (INT32U)m_cards.size();
+    map<INT8U, CardSlot>::iterator iter;
+    for (iter = m_cards.begin(); iter != m_cards.end(); ++iter)
+    {
+        CardSlot slot = iter->second;
+        *slot.pActive = true;
+        // Setup blocks on the serial port for seconds; keep it off the
+        // workers so the other cards configure in parallel.
+        slot.pStrand->PostBlocking([this, slot]() { RunSetup(slot); });
+    }
+
+    LogPrintf(DEBUG_TRACE_INFO, "card", "Running %u cards on %u threads\r\n", (INT32U)m_cards.size(),
+              m_executor.GetThreadCount());
+    return STATUS_SUCCESS;
+}
+
+void CCardOrchestrator::Stop(void)
+{
+    m_executor.Stop();
+    m_activeCards = 0;
+}
+
+ERROR_CODE_T CCardOrchestrator::PostToCard(INT8U cardNumber, ExecutorTask task)
+{
+    lock_guard<mutex> guard(m_lock);
+    map<INT8U, CardSlot>::iterator iter = m_cards.find(cardNumber);
+    RETURN_EC_IF_TRUE(ERROR_INVALID_PARAMETER, iter == m_cards.end());
+    return iter->second.pStrand->Post(task);
+}
+
+bool CCardOrchestrator::IsCardActive(INT8U cardNumber)
+{
+    lock_guard<mutex> guard(m_lock);
+    map<INT8U, CardSlot>::iterator iter = m_cards.find(cardNumber);
+    return (iter != m_cards.end()) && *iter->second.pActive;
+}
+
+shared_ptr<CCardStateMachine> CCardOrchestrator::GetCard(INT8U cardNumber)
+{
+    lock_guard<mutex> guard(m_lock);
+    map<INT8U, CardSlot>::iterator iter = m_cards.find(cardNumber);
+    return (iter == m_cards.end()) ? shared_ptr<CCardStateMachine>() : iter->second.pCard;
+}
+
+INT32U CCardOrchestrator::GetActiveCardCount(void) const
+{
+    return m_activeCards;
+}
+
+INT32U CCardOrchestrator::GetThreadCount(void) const
+{
+    return m_executor.GetThreadCount();
+}
+
+void CCardOrchestrator::RunSetup(CardSlot slot)
+{
+    if (FAILED(slot.pCard->Setup()))
+    {
+        LogPrintf(DEBUG_NORMAL_ERROR, "card", "Card %u: setup failed\r\n", slot.pCard->GetCardNumber());
+        DropCard(slot);
+        return;
+    }
+
+    slot.pStrand->Post([this, slot]() { RunTick(slot); });
+}
+
+void CCardOrchestrator::RunTick(CardSlot slot)
+{
+    INT32U nextTickMS = CARD_TICK_PERIOD_MS;
+    if (FAILED(slot.pCard->Tick(nextTickMS)))
+    {
+        DropCard(slot);
+        return;
+    }
+
+    slot.pStrand->PostAfter(nextTickMS, [this, slot]() { RunTick(slot); });
+}
+
+// Runs on the card's strand, so a command posted after this sees the flag.
+void CCardOrchestrator::DropCard(CardSlot slot)
+{
+    *slot.pActive = false;
+    slot.pCard->CancelQueuedCommands();
+    slot.pCard->MarkOffline();
+    m_activeCards--;
+}
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+
+#include "AsyncCommandQueue.h"
+#include "BTADeviceDriver.h"
+#include "BTAdapterConfigTable.h"
+#include "CommandSchedule.h"
+#include "ConfigFingerprint.h"
+#include "DeviceStatusCache.h"
+#include "InquiryStream.h"
+#include "LinkLivenessTracker.h"
+#include "Observable.h"
+#include "ReconnectStateMachine.h"
+#include "TimeDelta.h"
+#include "WorkStealingExecutor.h"
+#include "iuart.h"
+#include "types.h"
+
+// How often each card's state machine runs when no script is driving it.
+#define CARD_TICK_PERIOD_MS 100
+
+// Scripts used in qualification and playback modes unless --script names
+// another. Qualification inquires every 14 s on top of playback.
+#define CARD_QUAL_SCRIPT "every 14000 inquiry 10\nevery 100 play\n"
+#define CARD_PLAY_SCRIPT "every 100 play\n"
+
+typedef enum
+{
+    QualMode = 0,
+    PlayActiveSong = 1,
+    InputDevice = 2,
+    OutputDevice = 3,
+} AppState_t;
+
+typedef enum
+{
+    CARD_EVENT_CONNECTED = 0,
+    CARD_EVENT_DISCONNECTED = 1,
+    CARD_EVENT_DEVICE_FOUND = 2,
+    CARD_EVENT_INQUIRY_COMPLETE = 3,
+} CardEventType_t;
+
+struct CardEvent
+{
+    CardEventType_t type;
+    INT8U cardNumber;
+    // Empty for CARD_EVENT_INQUIRY_COMPLETE.
+    string btAddress;
+    string btDeviceName;
+};
+
+// Commands a supervisor can run on a card between ticks.
+typedef enum
+{
+    CARD_COMMAND_INQUIRY = 1,
+    CARD_COMMAND_PLAY = 2,
+    CARD_COMMAND_WATCHDOG_PET = 3,
+} CardCommand_t;
+
+struct CardSettings
+{
+    AppState_t mode;
+    string stateDir;
+    bool forceReset;
+    INT16U watchdogWindowMS;
+    // Overrides the built-in qualification/playback script when set.
+    string scriptPath;
+    // How long each piece of link status is reused before the module is
+    // asked again.
+    INT32U statusTtlMS;
+};
+
+// Everything one card needs to run: the driver, its inquiry and connection
+// state, and the watchdog bookkeeping. Calls are not thread-safe; the
+// orchestrator runs each card on its own strand.
+class CCardStateMachine : public IReconnectActions, public Observable<CardEvent>
+{
+  public:
+    CCardStateMachine(INT8U cardNumber, shared_ptr<IUart> pUart, shared_ptr<IBTADeviceDriver> pDriver,
+                      shared_ptr<CBTAdapterConfigTable> pAdapterConfigTable, const CardSettings &settings);
+
+    // Brings the module to a configured state, skipping the factory reset
+    // when the stored fingerprint still matches.
+    ERROR_CODE_T Setup(void);
+
+    // One pass of the state machine; nextTickMSOut says when to run it
+    // again. Fails once the module is no longer ready, after which the card
+    // should not be ticked again.
+    ERROR_CODE_T Tick(INT32U &nextTickMSOut);
+
+    // Reports the card offline and disconnected once it has failed setup or
+    // dropped out of Tick, so the adapter table stops showing it as alive.
+    void MarkOffline(void);
+
+    INT8U GetCardNumber(void) const;
+    shared_ptr<IBTADeviceDriver> GetDriver(void) const;
+
+    // Runs one CardCommand_t. Must be called on the card's strand.
+    ERROR_CODE_T RunCommand(INT8U command, INT32U arg);
+
+    // Queues a CardCommand_t from any thread. Queued commands run by
+    // priority, pets first, whenever the strand drains the queue.
+    void SubmitCommand(INT8U command, INT32U arg, AsyncCommandCallback done);
+    // Must be called on the card's strand; ticks drain the queue too.
+    void RunQueuedCommands(void);
+    void CancelQueuedCommands(void);
+
+    // IReconnectActions
+    virtual ERROR_CODE_T RunInquiry(void);
+    virtual bool IsConnected(void);
+
+  private:
+    void NotifyConnection(void);
+    void NotifyDisconnection(void);
+    void NotifyDetectedDevices(void);
+    void PublishEvent(CardEventType_t type, const string &btAddress, const string &btDeviceName);
+    ERROR_CODE_T OnInquiryEvent(InquiryEvent event);
+    ERROR_CODE_T FetchStatus(DeviceStatusField_t field, bool &valueOut);
+    ERROR_CODE_T ReadFingerprint(CConfigFingerprint &fingerprintOut);
+    ERROR_CODE_T LoadScript(void);
+    void RunScriptBatch(const CommandBatch &batch);
+    void PetWatchdogIfIdle(void);
+    ERROR_CODE_T SendWatchdogPet(bool flushRxBuffer);
+
+    INT8U m_cardNumber;
+    shared_ptr<IUart> m_pUart;
+    shared_ptr<IBTADeviceDriver> m_pDriver;
+    shared_ptr<CBTAdapterConfigTable> m_pAdapterConfigTable;
+    CardSettings m_settings;
+    CDeviceStatusCache m_status;
+    CAsyncCommandQueue m_commandQueue;
+
+    CCommandSchedule m_schedule;
+    CCommandSequencer m_sequencer;
+    bool m_inquiryActive;
+    uint64_t m_inquiryStartUs;
+    string m_connectDeviceAddr;
+    CReconnectStateMachine m_reconnect;
+    list<shared_ptr<CBTEADetectedDevice> > m_detectedDeviceList;
+    CLinkLivenessTracker m_linkLiveness;
+    CInquiryStream m_inquiryStream;
+    shared_ptr<IObserverHandle<InquiryEvent> > m_inquiryObserver;
+};
+
+// Runs every card's state machine on one shared work-stealing pool. Each
+// card gets a strand, so its setup, ticks and posted commands run in order
+// and never overlap, while different cards run in parallel on however many
+// threads the machine has.
+class CCardOrchestrator
+{
+  public:
+    CCardOrchestrator(INT32U numThreads = 0);
+    ~CCardOrchestrator();
+
+    ERROR_CODE_T AddCard(shared_ptr<CCardStateMachine> pCard);
+    ERROR_CODE_T Start(void);
+    void Stop(void);
+
+    // Runs a task on the card's strand, between ticks.
+    ERROR_CODE_T PostToCard(INT8U cardNumber, ExecutorTask task);
+    shared_ptr<CCardStateMachine> GetCard(INT8U cardNumber);
+    // False once the card failed setup or dropped out of Tick; it takes no
+    // more commands after that.
+    bool IsCardActive(INT8U cardNumber);
+
+    // Cards that haven't failed setup or dropped out of Tick.
+    INT32U GetActiveCardCount(void) const;
+    INT32U GetThreadCount(void) const;
+
+  private:
+    struct CardSlot
+    {
+        shared_ptr<CCardStateMachine> pCard;
+        shared_ptr<CExecutorStrand> pStrand;
+        shared_ptr<atomic<bool> > pActive;
+    };
+
+    void RunSetup(CardSlot slot);
+    void RunTick(CardSlot slot);
+    void DropCard(CardSlot slot);
+
+    CWorkStealingExecutor m_executor;
+    mutex m_lock;
+    map<INT8U, CardSlot> m_cards;
+    atomic<INT32U> m_activeCards;
+};
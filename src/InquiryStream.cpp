@@ -0,0 +1,59 @@
+#include "InquiryStream.h"
+
+#include "TimeDelta.h"
+
+CInquiryStream::CInquiryStream(INT32U maxDeviceAgeMS) : m_generation(0), m_maxDeviceAgeMS(maxDeviceAgeMS)
+{
+}
+
+INT32U CInquiryStream::GetNowMS(void)
+{
+    INT32U seconds;
+    INT32U uSeconds;
+    CTimeDeltaUs::GetTickCountUs(&seconds, &uSeconds);
+    return seconds * 1000 + uSeconds / 1000;
+}
+
+void CInquiryStream::BeginInquiry(void)
+{
+    m_generation++;
+    m_deviceIndex.AgeOut(GetNowMS(), m_maxDeviceAgeMS);
+}
+
+INT32U CInquiryStream::PublishNewDevices(const list<shared_ptr<CBTEADetectedDevice> > &detectedDevices)
+{
+    INT32U nowMS = GetNowMS();
+    INT32U published = 0;
+    list<shared_ptr<CBTEADetectedDevice> >::const_iterator iter;
+    for (iter = detectedDevices.begin(); iter != detectedDevices.end(); ++iter)
+    {
+        uint64_t address;
+        if (!*iter || FAILED(PackBtAddress((*iter)->m_btAddress.c_str(), address)))
+            continue;
+
+        bool isNew = false;
+        if (FAILED(m_deviceIndex.Upsert(address, (*iter)->m_btDeviceName.c_str(), nowMS, m_generation, &isNew)) ||
+            !isNew)
+            continue;
+
+        InquiryEvent event;
+        event.type = INQUIRY_EVENT_DEVICE_FOUND;
+        event.pDevice = *iter;
+        notifyObservers(event);
+        published++;
+    }
+
+    return published;
+}
+
+void CInquiryStream::PublishComplete(void)
+{
+    InquiryEvent event;
+    event.type = INQUIRY_EVENT_COMPLETE;
+    notifyObservers(event);
+}
+
+const CDetectedDeviceIndex &CInquiryStream::GetDeviceIndex(void) const
+{
+    return m_deviceIndex;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <list>
+#include <string>
+
+#include "BTADeviceDriver.h"
+#include "DetectedDeviceIndex.h"
+#include "Observable.h"
+#include "types.h"
+
+typedef enum
+{
+    INQUIRY_EVENT_DEVICE_FOUND,
+    INQUIRY_EVENT_COMPLETE,
+} InquiryEventType_t;
+
+struct InquiryEvent
+{
+    InquiryEventType_t type;
+    // Set for INQUIRY_EVENT_DEVICE_FOUND only.
+    shared_ptr<CBTEADetectedDevice> pDevice;
+};
+
+// Publishes inquiry results as soon as they show up in the detected device
+// list, one event per device, followed by a single completion event, so
+// observers can act on the first match without waiting for the window.
+class CInquiryStream : public Observable<InquiryEvent>
+{
+  public:
+    CInquiryStream(INT32U maxDeviceAgeMS = 60000);
+
+    // Starts a new generation so every device is published again; call when
+    // a new inquiry starts. Devices not seen for maxDeviceAgeMS are dropped.
+    void BeginInquiry(void);
+
+    // Publishes every device in the list that hasn't been published during
+    // this inquiry. Safe to call on every poll.
+    INT32U PublishNewDevices(const list<shared_ptr<CBTEADetectedDevice> > &detectedDevices);
+
+    void PublishComplete(void);
+
+    // Devices seen across recent inquiries, one entry per address.
+    const CDetectedDeviceIndex &GetDeviceIndex(void) const;
+
+  private:
+    static INT32U GetNowMS(void);
+
+    CDetectedDeviceIndex m_deviceIndex;
+    INT32U m_generation;
+    INT32U m_maxDeviceAgeMS;
+};
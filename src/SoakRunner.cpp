@@ -0,0 +1,162 @@
+#include "SoakRunner.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "Metrics.h"
+#include "TimeDelta.h"
+
+// Commands in the order a cycle issues them, as recorded in the metrics
+// registry.
+static const CHAR8 *g_soakCommands[] = {"config", "inquiry", "scan", "link_state", "pet"};
+
+CSoakRunner::CSoakRunner(INT8U cardNumber, shared_ptr<IBTADeviceDriver> pDriver)
+    : m_cardNumber(cardNumber), m_pDriver(pDriver), m_cyclesRun(0), m_failures(0), m_scanTimeouts(0),
+      m_elapsedUs(0), m_startTimeouts(0), m_startRssKB(0), m_endRssKB(0), m_peakRssKB(0)
+{
+}
+
+INT32U CSoakRunner::ReadStatusKB(const CHAR8 *pField)
+{
+    FILE *pFile = fopen("/proc/self/status", "r");
+    if (pFile == NULL)
+        return 0;
+
+    CHAR8 line[128];
+    INT32U value = 0;
+    size_t fieldLength = strlen(pField);
+    while (fgets(line, sizeof(line), pFile) != NULL)
+    {
+        if (strncmp(line, pField, fieldLength) == 0 && line[fieldLength] == ':')
+        {
+            value = (INT32U)strtoul(line + fieldLength + 1, NULL, 10);
+            break;
+        }
+    }
+
+    fclose(pFile);
+    return value;
+}
+
+void CSoakRunner::Count(const CHAR8 *pCommand, ERROR_CODE_T result)
+{
+    if (SUCCEEDED(result))
+        return;
+
+    m_failures++;
+    // Keep the first few for the report; the count covers the rest.
+    if (m_failedCommands.size() < 8)
+    {
+        m_failedCommands.push_back(string(pCommand) + " (" + to_string(result) + ")");
+    }
+}
+
+ERROR_CODE_T CSoakRunner::RunCycle(void)
+{
+    {
+        CCommandTimer configTimer(m_cardNumber, "config");
+        Count("config", configTimer.Finish(m_pDriver->InitializeDeviceConfiguration()));
+    }
+
+    {
+        CCommandTimer inquiryTimer(m_cardNumber, "inquiry");
+        Count("inquiry", inquiryTimer.Finish(m_pDriver->SendInquiry(10)));
+    }
+
+    {
+        // One sample covers the whole inquiry window, not each poll.
+        list<shared_ptr<CBTEADetectedDevice> > detectedDevices;
+        CCommandTimer scanTimer(m_cardNumber, "scan");
+        CTimeDelta scanDeadline(SOAK_SCAN_TIMEOUT_MS);
+        ERROR_CODE_T result;
+        while ((result = m_pDriver->ScanForBtDevices(detectedDevices, 5)) == STATUS_OPERATION_INCOMPLETE)
+        {
+            if (scanDeadline.IsTimeExpired())
+            {
+                result = ERROR_OPERATION_TIMED_OUT;
+                m_scanTimeouts++;
+                break;
+            }
+            OSTimeDly(1);
+        }
+        Count("scan", scanTimer.Finish(result));
+    }
+
+    {
+        // The driver connects on its own; time how long the link state
+        // takes to read instead.
+        CCommandTimer linkTimer(m_cardNumber, "link_state");
+        m_pDriver->IsDeviceConnected();
+        m_pDriver->IsPairedWithDevice();
+        linkTimer.Finish(STATUS_SUCCESS);
+    }
+
+    {
+        CCommandTimer petTimer(m_cardNumber, "pet");
+        Count("pet", petTimer.Finish(m_pDriver->WatchdogPet(true)));
+    }
+
+    RETURN_EC_IF_FALSE(ERROR_NOT_INITIALIZED, m_pDriver->IsDeviceReadyForUse());
+    return STATUS_SUCCESS;
+}
+
+ERROR_CODE_T CSoakRunner::Run(INT32U cycles)
+{
+    RETURN_EC_IF_NULL(ERROR_NOT_INITIALIZED, m_pDriver);
+
+    m_startTimeouts = CMetricsRegistry::GetInstance().GetCounter(m_cardNumber, METRIC_COUNTER_TIMEOUTS);
+    m_startRssKB = ReadStatusKB("VmRSS");
+
+    uint64_t startUs = MetricsGetNowUs();
+    ERROR_CODE_T result = STATUS_SUCCESS;
+    for (m_cyclesRun = 0; m_cyclesRun < cycles; m_cyclesRun++)
+    {
+        result = RunCycle();
+        if (FAILED(result))
+        {
+            LogPrintf(DEBUG_NORMAL_ERROR, "soak", "Device stopped being ready after %u cycles\r\n", m_cyclesRun);
+            m_failures++;
+            break;
+        }
+    }
+    m_elapsedUs = MetricsGetNowUs() - startUs;
+
+    m_endRssKB = ReadStatusKB("VmRSS");
+    m_peakRssKB = ReadStatusKB("VmHWM");
+    return result;
+}
+
+INT32U CSoakRunner::GetFailureCount(void) const
+{
+    return m_failures;
+}
+
+void CSoakRunner::PrintReport(FILE *pOut)
+{
+    double seconds = (double)m_elapsedUs / 1000000.0;
+    fprintf(pOut, "Soak report for card %u\n", m_cardNumber);
+    fprintf(pOut, "  cycles:      %u in %.2f s (%.2f cycles/s)\n", m_cyclesRun, seconds,
+            seconds > 0 ? m_cyclesRun / seconds : 0.0);
+
+    fprintf(pOut, "  %-12s %8s %10s %10s %10s %10s\n", "command", "count", "p50 us", "p90 us", "p99 us", "max us");
+    for (size_t i = 0; i < sizeof(g_soakCommands) / sizeof(g_soakCommands[0]); i++)
+    {
+        CLatencyHistogram *pHistogram = CMetricsRegistry::GetInstance().GetHistogram(m_cardNumber, g_soakCommands[i]);
+        fprintf(pOut, "  %-12s %8llu %10llu %10llu %10llu %10llu\n", g_soakCommands[i],
+                (unsigned long long)pHistogram->GetCount(), (unsigned long long)pHistogram->GetPercentileUs(50),
+                (unsigned long long)pHistogram->GetPercentileUs(90),
+                (unsigned long long)pHistogram->GetPercentileUs(99), (unsigned long long)pHistogram->GetMaxUs());
+    }
+
+    uint64_t timeouts =
+        CMetricsRegistry::GetInstance().GetCounter(m_cardNumber, METRIC_COUNTER_TIMEOUTS) - m_startTimeouts;
+    fprintf(pOut, "  timeouts:    %llu (%u inquiry windows over %u ms)\n", (unsigned long long)timeouts,
+            m_scanTimeouts, SOAK_SCAN_TIMEOUT_MS);
+    fprintf(pOut, "  failures:    %u\n", m_failures);
+    for (size_t i = 0; i < m_failedCommands.size(); i++)
+    {
+        fprintf(pOut, "    %s\n", m_failedCommands[i].c_str());
+    }
+    fprintf(pOut, "  rss:         %u kB -> %u kB (%+d kB), peak %u kB\n", m_startRssKB, m_endRssKB,
+            (int)m_endRssKB - (int)m_startRssKB, m_peakRssKB);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <memory>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "BTADeviceDriver.h"
+#include "types.h"
+
+// Longest a single inquiry may keep ScanForBtDevices incomplete before the
+// cycle counts it as a timeout.
+#define SOAK_SCAN_TIMEOUT_MS 15000
+
+// Runs back-to-back config/inquiry/scan/link-state/watchdog cycles against
+// one card and reports throughput, per-command latency percentiles, timeouts
+// and memory growth, for qualifying firmware and host builds in one command.
+class CSoakRunner
+{
+  public:
+    CSoakRunner(INT8U cardNumber, shared_ptr<IBTADeviceDriver> pDriver);
+
+    ERROR_CODE_T Run(INT32U cycles);
+    void PrintReport(FILE *pOut);
+
+    // Failed commands plus timeouts; a clean run has none.
+    INT32U GetFailureCount(void) const;
+
+  private:
+    ERROR_CODE_T RunCycle(void);
+    void Count(const CHAR8 *pCommand, ERROR_CODE_T result);
+
+    static INT32U ReadStatusKB(const CHAR8 *pField);
+
+    INT8U m_cardNumber;
+    shared_ptr<IBTADeviceDriver> m_pDriver;
+    INT32U m_cyclesRun;
+    INT32U m_failures;
+    INT32U m_scanTimeouts;
+    uint64_t m_elapsedUs;
+    uint64_t m_startTimeouts;
+    INT32U m_startRssKB;
+    INT32U m_endRssKB;
+    INT32U m_peakRssKB;
+    vector<string> m_failedCommands;
+};
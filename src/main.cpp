@@ -1,54 +1,132 @@
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+
 #include <memory>
 
 #include "../External/cxxopts/include/cxxopts.hpp"
 
+#include "BTADeviceDiscovery.h"
+#include "BTAdapterConfigTable.h"
 #include "BTADeviceDriver.h"
 #include "BTADeviceFactory.h"
 #include "BTASerialDevice.h"
+#include "CardDaemon.h"
+#include "CardOrchestrator.h"
+#include "FaultInjectingUart.h"
+#include "IO.h"
+#include "Metrics.h"
+#include "Profiler.h"
+#include "SoakRunner.h"
 #include "uart.h"
 
-typedef enum
-{
-    QualMode = 0,
-    PlayActiveSong = 1,
-    InputDevice = 2,
-    OutputDevice = 3,
-} AppState_t;
-
-void doMainTask(shared_ptr<IBTADeviceDriver> pBtaDeviceDriver, AppState_t state);
-CTimeDeltaSec m_TestModeTimer;
-
-bool m_inquiryActive;
-bool m_isAutoConnecting;
-string m_connectDeviceAddr;
-CTimeDelta m_autoConnectTimer;
-list<shared_ptr<CBTEADetectedDevice> > detectedDeviceList;
+shared_ptr<CBTAdapterConfigTable> m_pAdapterConfigTable;
 
 void doAppSetup()
 {
-
-    m_TestModeTimer.ResetTime(0);
-    m_inquiryActive = false;
+    // There is no AVDS backplane on Linux, so serve the adapter table from
+    // this process before any driver goes looking for it.
+    m_pAdapterConfigTable = make_shared<CBTAdapterConfigTable>();
+    if (!CIO::g_pNode)
+    {
+        CIO::g_pNode = make_shared<CLinuxAVDSNode>(m_pAdapterConfigTable);
+    }
 }
 static int port;
 static AppState_t appMode = OutputDevice;
+static string stateDir = "/var/lib/btaudiocard";
+static bool forceReset = false;
+static bool discoverPorts = false;
+static int watchdogWindowMS = LIVENESS_DEFAULT_WINDOW_MS;
+static int logLevel = DEBUG_TRACE_INFO;
+static string metricsFile;
+static string metricsSocket;
+static string sharedStateName;
+static int workerThreads = 0;
+static string scriptPath;
+static string daemonSocket;
+static int soakCycles = 0;
+static string profileTrace;
+static string uartFaults;
+static int statusTtlMS = DEVICE_STATUS_DEFAULT_TTL_MS;
+
+// How often the metrics file is rewritten.
+#define METRICS_EXPORT_PERIOD_SEC 10
+
+// Upper bound for probing every port in parallel.
+#define DISCOVERY_DEADLINE_MS 5000
 
-void doArgParse(int argc, char *argv[])
+// mkdir -p: the config fingerprints live here, so a missing
+// directory would silently force a full reconfigure on every start.
+static ERROR_CODE_T CreateStateDir(const string &path)
+{
+    for (size_t slash = path.find('/', 1); ; slash = path.find('/', slash + 1))
+    {
+        string prefix = path.substr(0, slash);
+        if (!prefix.empty() && mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST)
+        {
+            LogPrintf(DEBUG_NORMAL_ERROR, "main", "Failed to create state directory %s: %s\r\n", prefix.c_str(),
+                      strerror(errno));
+            return ERROR_FAILED;
+        }
+        if (slash == string::npos)
+            break;
+    }
+    return STATUS_SUCCESS;
+}
+
+// Returns false if an option is out of range.
+bool doArgParse(int argc, char *argv[])
 {
     cxxopts::Options options("MyApp", "Bluetooth Audio Device Controller");
 
-    options.add_options()("p,port", "Port number", cxxopts::value<int>()->default_value("0"))("m,mode", "Operating mode: input, output, qual, play", cxxopts::value<std::string>())("h,help", "Print usage");
+    options.add_options()("p,port", "Port number", cxxopts::value<int>()->default_value("0"))("m,mode", "Operating mode: input, output, qual, play", cxxopts::value<std::string>())("s,state-dir", "Directory holding per-card config fingerprints", cxxopts::value<std::string>()->default_value("/var/lib/btaudiocard"))("f,force-reset", "Always factory reset and reconfigure the module")("d,discover", "Probe every /dev/ttyUSB port in parallel instead of using --port")("w,watchdog-window", "Module watchdog window in ms; pets are only sent when the link is idle for half of it", cxxopts::value<int>()->default_value("1000"))("l,log-level", "Log level, 0 (off) to 6 (trace)", cxxopts::value<int>()->default_value("4"))("metrics-file", "Periodically write Prometheus metrics to this file", cxxopts::value<std::string>())("metrics-socket", "Serve Prometheus metrics on this Unix-domain socket", cxxopts::value<std::string>())("shared-state", "Publish card state in this POSIX shared memory object, e.g. " SHARED_ADAPTER_STATE_DEFAULT_NAME, cxxopts::value<std::string>())("script", "Command script for qual and play modes, one 'every <ms> [+<offset>] <play|inquiry> [<arg>]' per line", cxxopts::value<std::string>())("daemon", "Serve card events and commands on this Unix-domain socket", cxxopts::value<std::string>())("soak", "Run this many config/inquiry/scan cycles against the card, print a performance report and exit", cxxopts::value<int>())("bench", "Same as --soak", cxxopts::value<int>())("profile-trace", "Periodically write profiling zones as Chrome trace JSON to this file (needs ENABLE_PROFILING)", cxxopts::value<std::string>())("uart-faults", "Inject UART faults on every card's port, e.g. latency=2000,jitter=500,drop=100,corrupt=50,chunk=4,stall=1000:50000,seed=7 (rates per million)", cxxopts::value<std::string>())("status-ttl", "Reuse the module's link status for this many ms between queries", cxxopts::value<int>()->default_value("500"))("t,threads", "Worker threads shared by all cards, 0 for one per CPU", cxxopts::value<int>()->default_value("0"))("h,help", "Print usage");
 
     auto result = options.parse(argc, argv);
 
     if (result.count("help"))
     {
         std::cout << options.help() << std::endl;
-        return;
+        return true;
     }
 
     port = result["port"].as<int>();
     appMode = OutputDevice;
+    stateDir = result["state-dir"].as<std::string>();
+    forceReset = (result.count("force-reset") > 0);
+    discoverPorts = (result.count("discover") > 0);
+    watchdogWindowMS = result["watchdog-window"].as<int>();
+    logLevel = result["log-level"].as<int>();
+    workerThreads = result["threads"].as<int>();
+    statusTtlMS = result["status-ttl"].as<int>();
+    if (watchdogWindowMS < 1 || watchdogWindowMS > 0xFFFF)
+    {
+        std::cerr << "--watchdog-window must be between 1 and 65535 ms" << std::endl;
+        return false;
+    }
+    if (statusTtlMS < 0)
+    {
+        std::cerr << "--status-ttl must not be negative" << std::endl;
+        return false;
+    }
+    if (result.count("metrics-file"))
+        metricsFile = result["metrics-file"].as<std::string>();
+    if (result.count("metrics-socket"))
+        metricsSocket = result["metrics-socket"].as<std::string>();
+    if (result.count("shared-state"))
+        sharedStateName = result["shared-state"].as<std::string>();
+    if (result.count("script"))
+        scriptPath = result["script"].as<std::string>();
+    if (result.count("daemon"))
+        daemonSocket = result["daemon"].as<std::string>();
+    if (result.count("profile-trace"))
+        profileTrace = result["profile-trace"].as<std::string>();
+    if (result.count("uart-faults"))
+        uartFaults = result["uart-faults"].as<std::string>();
+    if (result.count("soak"))
+        soakCycles = result["soak"].as<int>();
+    else if (result.count("bench"))
+        soakCycles = result["bench"].as<int>();
 
     if (result.count("mode"))
     {
@@ -65,125 +143,150 @@ void doArgParse(int argc, char *argv[])
 
     std::cout << "Using port: " << port << std::endl;
     std::cout << "Using mode: " << appMode << std::endl;
+    return true;
 }
 
 int main(int argc, char *argv[])
 {
-    doArgParse(argc, argv);
-
-    doAppSetup();
+    if (!doArgParse(argc, argv))
+        return -1;
+    CBinaryLog::SetLevel((INT8U)logLevel);
+    CBinaryLog::Start();
 
-    printf("Creating UART on port %d\r\n", port);
-    shared_ptr<IUart> uart = make_shared<CuArt>(port);
+    if (FAILED(CreateStateDir(stateDir)))
+        return -1;
 
-    printf("Discovering BTA Device\r\n");
-    shared_ptr<IBTADeviceDriver> pBtaDeviceDriver;
-    if (FAILED(CBTADeviceFactory::CreateBTADeviceDriver(uart, pBtaDeviceDriver)))
+    doAppSetup();
+    if (!sharedStateName.empty())
     {
-        printf("Failed to create IBTADeviceDriver\n");
-        return -1;
+        shared_ptr<CSharedAdapterStateWriter> pSharedState = make_shared<CSharedAdapterStateWriter>();
+        if (SUCCEEDED(pSharedState->Create(sharedStateName, m_pAdapterConfigTable->GetNumTableEntries())))
+        {
+            m_pAdapterConfigTable->SetSharedStateWriter(pSharedState);
+        }
+        else
+        {
+            LogPrintf(DEBUG_NORMAL_ERROR, "main", "Failed to create shared state %s\r\n", sharedStateName.c_str());
+        }
     }
 
-    printf("Performing factory reset\r\n");
-    pBtaDeviceDriver->FactoryReset();
+    CardSettings settings;
+    settings.mode = appMode;
+    settings.stateDir = stateDir;
+    settings.forceReset = forceReset;
+    settings.watchdogWindowMS = (INT16U)watchdogWindowMS;
+    settings.scriptPath = scriptPath;
+    settings.statusTtlMS = (INT32U)statusTtlMS;
 
-    printf("Running IBTADeviceDriver\r\n");
-    pBtaDeviceDriver->InitializeDeviceConfiguration();
-    pBtaDeviceDriver->SetDeviceMode(BTA_DEVICE_MODE_INPUT);
+    UartFaultConfig faults;
+    if (!uartFaults.empty() && FAILED(faults.Parse(uartFaults)))
+        return -1;
 
-    while (true)
+    CCardOrchestrator orchestrator(workerThreads);
+    vector<shared_ptr<CCardStateMachine> > cards;
+    if (discoverPorts)
     {
-        if (!pBtaDeviceDriver->IsDeviceReadyForUse())
+        vector<INT32U> ports;
+        vector<DiscoveredBTADevice> devices;
+        LogPrintf(DEBUG_TRACE_INFO, "main", "Discovering BTA Devices on all ports\r\n");
+        if (FAILED(CBTADeviceDiscovery::EnumeratePorts(ports)) ||
+            FAILED(CBTADeviceDiscovery::DiscoverDevices(ports, DISCOVERY_DEADLINE_MS, devices,
+                                                        uartFaults.empty() ? NULL : &faults)))
         {
-            printf("This shouldn't happen!\r\n");
-            return 0;
+            LogPrintf(DEBUG_NORMAL_ERROR, "main", "No BTA Devices found\n");
+            return -1;
         }
 
-        doMainTask(pBtaDeviceDriver, OutputDevice);
-
-        OSTimeDly(10);
+        for (size_t i = 0; i < devices.size(); i++)
+        {
+            LogPrintf(DEBUG_TRACE_INFO, "main", "Found BTA Device on port %u\r\n", devices[i].port);
+            cards.push_back(make_shared<CCardStateMachine>((INT8U)devices[i].port, devices[i].pUart,
+                                                           devices[i].pDriver, m_pAdapterConfigTable, settings));
+        }
     }
-}
+    else
+    {
+        LogPrintf(DEBUG_TRACE_INFO, "main", "Creating UART on port %d\r\n", port);
+        shared_ptr<IUart> portUart = make_shared<CuArt>(port);
+        if (!uartFaults.empty())
+        {
+            // Faults sit under the instrumentation so the metrics show the
+            // degraded link the driver actually sees.
+            portUart = make_shared<CFaultInjectingUart>(portUart, faults);
+        }
+        shared_ptr<IUart> uart = make_shared<CInstrumentedUart>(portUart, (INT8U)port);
 
-static void NotifyConnection()
-{
-    printf("Connected to device: %s\r\n", m_connectDeviceAddr.c_str());
-}
-static void NotifyDisconnection()
-{
-    printf("Disconnected from device: %s\r\n", m_connectDeviceAddr.c_str());
-}
+        LogPrintf(DEBUG_TRACE_INFO, "main", "Discovering BTA Device\r\n");
+        shared_ptr<IBTADeviceDriver> pBtaDeviceDriver;
+        if (FAILED(CBTADeviceFactory::CreateBTADeviceDriver(uart, pBtaDeviceDriver)))
+        {
+            LogPrintf(DEBUG_NORMAL_ERROR, "main", "Failed to create IBTADeviceDriver\n");
+            return -1;
+        }
+        cards.push_back(
+            make_shared<CCardStateMachine>((INT8U)port, uart, pBtaDeviceDriver, m_pAdapterConfigTable, settings));
+    }
 
-static void NotifyDetectedDevices()
-{
-    printf("Detected devices:\r\n");
-    for (auto device : detectedDeviceList)
+    if (soakCycles > 0)
     {
-        printf("Device: %s, Name: %s\r\n", device->m_btAddress.c_str(), device->m_btDeviceName.c_str());
+        CSoakRunner soak(cards.front()->GetCardNumber(), cards.front()->GetDriver());
+        soak.Run((INT32U)soakCycles);
+        // The log writer shares stdout; drain it so the report isn't
+        // interleaved with the run's last log lines.
+        CBinaryLog::Flush();
+        soak.PrintReport(stdout);
+        return (soak.GetFailureCount() == 0) ? 0 : 1;
     }
-    printf("End of detected devices\r\n");
-}
 
-void doMainTask(shared_ptr<IBTADeviceDriver> pBtaDeviceDriver, AppState_t state)
-{
-
-    if (state == QualMode)
+    CCardDaemon daemon(&orchestrator);
+    for (size_t i = 0; i < cards.size(); i++)
     {
-        m_TestModeTimer.GetElapsedTime();
-        if (m_TestModeTimer.IsTimeExpired())
+        orchestrator.AddCard(cards[i]);
+        if (!daemonSocket.empty())
         {
-            printf("Sending out inquiry command\r\n");
-            pBtaDeviceDriver->SendInquiry(10);
-            m_TestModeTimer.ResetTime(14);
+            daemon.AttachCard(cards[i]);
         }
     }
+    if (!daemonSocket.empty() && FAILED(daemon.Start(daemonSocket)))
+    {
+        LogPrintf(DEBUG_NORMAL_ERROR, "main", "Failed to start daemon socket %s\r\n", daemonSocket.c_str());
+        return -1;
+    }
 
-    if (state == QualMode || state == PlayActiveSong)
+    CMetricsSocketServer metricsServer;
+    if (!metricsSocket.empty())
     {
-        if (pBtaDeviceDriver->PlayNextMusicSequence() != STATUS_SUCCESS)
-        {
-            printf("Failed to play next music sequence\r\n");
-        }
+        metricsServer.Start(metricsSocket);
     }
+    CTimeDeltaSec metricsExportTimer(METRICS_EXPORT_PERIOD_SEC);
 
-    if (state == OutputDevice)
+    if (FAILED(orchestrator.Start()))
     {
-        if (m_inquiryActive || !pBtaDeviceDriver->IsDeviceConnected())
-        {
-            ERROR_CODE_T result = pBtaDeviceDriver->ScanForBtDevices(detectedDeviceList, 5);
-
-            m_inquiryActive = (result != STATUS_SUCCESS);
-            if (!m_inquiryActive)
-            {
-                if (m_isAutoConnecting)
-                {
-                    if (m_autoConnectTimer.IsTimeExpired())
-                    {
-                        m_isAutoConnecting = false;
-                        NotifyConnection();
-                    }
-                    else if (!detectedDeviceList.empty())
-                    {
-                        m_connectDeviceAddr = detectedDeviceList.front()->m_btAddress;
-                        m_isAutoConnecting = false;
-                    }
-                }
-
-                NotifyDetectedDevices();
-            }
-        }
-        else
-        {
-            if (!pBtaDeviceDriver->IsPairedWithDevice())
-            {
-                detectedDeviceList.clear();
-                NotifyDetectedDevices();
-            }
-            pBtaDeviceDriver->WatchdogPet(true);
-        }
+        LogPrintf(DEBUG_NORMAL_ERROR, "main", "Failed to start card orchestrator\n");
+        return -1;
     }
-    else
+
+    // The cards run on the orchestrator's pool; this thread only handles
+    // periodic housekeeping until every card has dropped out.
+    while (orchestrator.GetActiveCardCount() != 0)
     {
-        pBtaDeviceDriver->WatchdogPet(true);
+        metricsExportTimer.GetElapsedTime();
+        if (metricsExportTimer.IsTimeExpired())
+        {
+            if (!metricsFile.empty())
+                CMetricsRegistry::GetInstance().ExportToFile(metricsFile);
+            if (!profileTrace.empty())
+                CProfiler::DumpChromeTrace(profileTrace);
+            metricsExportTimer.ResetTime(METRICS_EXPORT_PERIOD_SEC);
+        }
+
+        OSTimeDly(10);
     }
-}
\ No newline at end of file
+
+    LogPrintf(DEBUG_NORMAL_ERROR, "main", "No cards are ready for use\r\n");
+    daemon.Stop();
+    orchestrator.Stop();
+    if (!profileTrace.empty())
+        CProfiler::DumpChromeTrace(profileTrace);
+    return 0;
+}
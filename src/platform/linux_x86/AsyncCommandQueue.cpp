@@ -0,0 +1,198 @@
+#include "AsyncCommandQueue.h"
+
+#include <algorithm>
+
+static uint64_t GetNowUs(void)
+{
+    INT32U seconds = 0;
+    INT32U uSeconds = 0;
+    CTimeDeltaUs::GetTickCountUs(&seconds, &uSeconds);
+    return (uint64_t)seconds * 1000000 + uSeconds;
+}
+
+CAsyncCommandQueue::CAsyncCommandQueue(const string &name)
+    : m_name(name), m_stepping(false), m_nextSequence(0)
+{
+}
+
+const string &CAsyncCommandQueue::GetName(void)
+{
+    return m_name;
+}
+
+future<ERROR_CODE_T> CAsyncCommandQueue::Submit(const string &commandName, AsyncCommandStep step, INT16U timeoutMS, shared_ptr<CCancellationToken> pToken, AsyncCommandCallback callback)
+{
+    AsyncCommandOptions options(COMMAND_PRIORITY_NORMAL, timeoutMS);
+    options.pToken = pToken;
+    return Submit(commandName, step, options, callback);
+}
+
+future<ERROR_CODE_T> CAsyncCommandQueue::Submit(const string &commandName, AsyncCommandStep step, const AsyncCommandOptions &options, AsyncCommandCallback callback)
+{
+    shared_ptr<AsyncCommand> pCommand = make_shared<AsyncCommand>();
+    pCommand->name = commandName;
+    pCommand->step = step;
+    pCommand->options = options;
+    pCommand->deadlineUs = (options.deadlineMS == 0) ? UINT64_MAX : GetNowUs() + (uint64_t)options.deadlineMS * 1000;
+    pCommand->started = false;
+    pCommand->cancelRequested = false;
+    pCommand->callback = callback;
+    pCommand->pPromise = make_shared<promise<ERROR_CODE_T> >();
+
+    future<ERROR_CODE_T> result = pCommand->pPromise->get_future();
+
+    unique_lock<mutex> guard(m_lock);
+    pCommand->sequence = m_nextSequence++;
+    m_commands.push_back(pCommand);
+    return result;
+}
+
+bool CAsyncCommandQueue::IsMoreUrgent(const shared_ptr<AsyncCommand> &pLhs, const shared_ptr<AsyncCommand> &pRhs)
+{
+    if (pLhs->options.priority != pRhs->options.priority)
+        return pLhs->options.priority < pRhs->options.priority;
+
+    if (pLhs->deadlineUs != pRhs->deadlineUs)
+        return pLhs->deadlineUs < pRhs->deadlineUs;
+
+    return pLhs->sequence < pRhs->sequence;
+}
+
+// Called with m_lock held. Returns the command to step next and makes it
+// current, parking the previous one if it was preempted.
+shared_ptr<CAsyncCommandQueue::AsyncCommand> CAsyncCommandQueue::SelectNext(void)
+{
+    if (!m_pCurrent)
+    {
+        // A non-preemptible command that critical work interrupted picks up
+        // where it left off before anything else may start.
+        for (deque<shared_ptr<AsyncCommand> >::iterator iter = m_commands.begin(); iter != m_commands.end(); ++iter)
+        {
+            if ((*iter)->started && !(*iter)->options.preemptible)
+            {
+                m_pCurrent = *iter;
+                m_commands.erase(iter);
+                break;
+            }
+        }
+    }
+
+    deque<shared_ptr<AsyncCommand> >::iterator best = m_commands.end();
+    for (deque<shared_ptr<AsyncCommand> >::iterator iter = m_commands.begin(); iter != m_commands.end(); ++iter)
+    {
+        if (best == m_commands.end() || IsMoreUrgent(*iter, *best))
+            best = iter;
+    }
+
+    if (best == m_commands.end())
+        return m_pCurrent;
+
+    if (m_pCurrent)
+    {
+        // A pet can't wait out a long non-preemptible command without the
+        // module's watchdog firing.
+        bool mayPreempt = m_pCurrent->options.preemptible ||
+                          ((*best)->options.priority == COMMAND_PRIORITY_CRITICAL &&
+                           m_pCurrent->options.priority != COMMAND_PRIORITY_CRITICAL);
+        if (!mayPreempt || !IsMoreUrgent(*best, m_pCurrent))
+            return m_pCurrent;
+    }
+
+    shared_ptr<AsyncCommand> pNext = *best;
+    m_commands.erase(best);
+    if (m_pCurrent)
+    {
+        m_commands.push_back(m_pCurrent);
+    }
+
+    m_pCurrent = pNext;
+    return m_pCurrent;
+}
+
+void CAsyncCommandQueue::Complete(shared_ptr<AsyncCommand> pCommand, ERROR_CODE_T result)
+{
+    pCommand->pPromise->set_value(result);
+    if (pCommand->callback)
+    {
+        pCommand->callback(result);
+    }
+}
+
+bool CAsyncCommandQueue::RunOnce(void)
+{
+    shared_ptr<AsyncCommand> pCommand;
+    {
+        unique_lock<mutex> guard(m_lock);
+        pCommand = SelectNext();
+        if (!pCommand)
+            return false;
+        m_stepping = true;
+    }
+
+    ERROR_CODE_T result;
+    if (pCommand->options.pToken && pCommand->options.pToken->IsCancelled())
+    {
+        result = ERROR_OPERATION_CANCELLED;
+    }
+    else
+    {
+        if (!pCommand->started)
+        {
+            pCommand->started = true;
+            pCommand->timeout.ResetTime(pCommand->options.timeoutMS);
+        }
+
+        result = pCommand->step();
+        if (result == STATUS_OPERATION_INCOMPLETE && pCommand->options.timeoutMS != 0 &&
+            pCommand->timeout.IsTimeExpired())
+        {
+            result = ERROR_OPERATION_TIMED_OUT;
+        }
+    }
+
+    {
+        unique_lock<mutex> guard(m_lock);
+        m_stepping = false;
+        if (result == STATUS_OPERATION_INCOMPLETE)
+        {
+            if (!pCommand->cancelRequested)
+                return false;
+            result = ERROR_OPERATION_CANCELLED;
+        }
+        m_pCurrent.reset();
+    }
+
+    // Callbacks run without the lock held so they can submit follow-up work.
+    Complete(pCommand, result);
+    return true;
+}
+
+size_t CAsyncCommandQueue::GetPendingCount(void)
+{
+    unique_lock<mutex> guard(m_lock);
+    return m_commands.size() + (m_pCurrent ? 1 : 0);
+}
+
+void CAsyncCommandQueue::CancelAll(void)
+{
+    deque<shared_ptr<AsyncCommand> > cancelled;
+    {
+        unique_lock<mutex> guard(m_lock);
+        cancelled.swap(m_commands);
+        if (m_pCurrent && m_stepping)
+        {
+            // RunOnce owns it until the step returns.
+            m_pCurrent->cancelRequested = true;
+        }
+        else if (m_pCurrent)
+        {
+            cancelled.push_back(m_pCurrent);
+            m_pCurrent.reset();
+        }
+    }
+
+    for (size_t i = 0; i < cancelled.size(); i++)
+    {
+        Complete(cancelled[i], ERROR_OPERATION_CANCELLED);
+    }
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+
+#include "TimeDelta.h"
+#include "types.h"
+
+// Shared flag a caller keeps to cancel one specific command.
+class CCancellationToken
+{
+  public:
+    CCancellationToken() : m_cancelled(false)
+    {
+    }
+
+    void Cancel(void)
+    {
+        m_cancelled = true;
+    }
+
+    bool IsCancelled(void)
+    {
+        return m_cancelled;
+    }
+
+  private:
+    atomic<bool> m_cancelled;
+};
+
+// A command is a step function. Returning STATUS_OPERATION_INCOMPLETE means
+// "still waiting on the module, call me again later" (the same convention
+// ScanForBtDevices uses); anything else completes the command.
+typedef function<ERROR_CODE_T(void)> AsyncCommandStep;
+typedef function<void(ERROR_CODE_T)> AsyncCommandCallback;
+
+// Priority classes, most urgent first. Liveness traffic (watchdog pets) must
+// never wait behind bulk work such as inquiries and configuration bursts.
+typedef enum
+{
+    COMMAND_PRIORITY_CRITICAL = 0,
+    COMMAND_PRIORITY_REALTIME = 1,
+    COMMAND_PRIORITY_NORMAL = 2,
+    COMMAND_PRIORITY_BULK = 3,
+} AsyncCommandPriority_t;
+
+struct AsyncCommandOptions
+{
+    AsyncCommandOptions(AsyncCommandPriority_t commandPriority = COMMAND_PRIORITY_NORMAL, INT16U commandTimeoutMS = 0)
+        : priority(commandPriority), timeoutMS(commandTimeoutMS), deadlineMS(0), preemptible(false)
+    {
+    }
+
+    AsyncCommandPriority_t priority;
+    // Gives up with ERROR_OPERATION_TIMED_OUT this long after starting; 0 = never.
+    INT16U timeoutMS;
+    // Orders commands within a priority class, earliest first; 0 = no deadline.
+    INT32U deadlineMS;
+    // A multi-step command that may be parked between steps so more urgent
+    // commands can run (e.g. polling an inquiry in progress). Critical
+    // commands run between the steps of any command that isn't critical.
+    bool preemptible;
+    shared_ptr<CCancellationToken> pToken;
+};
+
+// Commands for one card. The next command is picked by priority class, then
+// deadline, then submission order, and preemptible commands yield to more
+// urgent ones at step boundaries. Submit and CancelAll may be called from
+// any thread; RunOnce from the one thread that owns the device.
+class CAsyncCommandQueue
+{
+  public:
+    CAsyncCommandQueue(const string &name = "");
+
+    future<ERROR_CODE_T> Submit(const string &commandName, AsyncCommandStep step, INT16U timeoutMS, shared_ptr<CCancellationToken> pToken = shared_ptr<CCancellationToken>(), AsyncCommandCallback callback = AsyncCommandCallback());
+    future<ERROR_CODE_T> Submit(const string &commandName, AsyncCommandStep step, const AsyncCommandOptions &options, AsyncCommandCallback callback = AsyncCommandCallback());
+
+    // Advances the current command by one step. Returns true if it made
+    // progress (a command finished), false if idle or still waiting.
+    bool RunOnce(void);
+
+    size_t GetPendingCount(void);
+    // Cancels the waiting commands and the current one. If the current
+    // command is in the middle of a step, it is cancelled when the step
+    // returns unless that step finished it.
+    void CancelAll(void);
+    const string &GetName(void);
+
+  protected:
+    struct AsyncCommand
+    {
+        string name;
+        AsyncCommandStep step;
+        AsyncCommandOptions options;
+        uint64_t deadlineUs;
+        uint64_t sequence;
+        bool started;
+        bool cancelRequested;
+        CTimeDelta timeout;
+        AsyncCommandCallback callback;
+        shared_ptr<promise<ERROR_CODE_T> > pPromise;
+    };
+
+    static bool IsMoreUrgent(const shared_ptr<AsyncCommand> &pLhs, const shared_ptr<AsyncCommand> &pRhs);
+    shared_ptr<AsyncCommand> SelectNext(void);
+    void Complete(shared_ptr<AsyncCommand> pCommand, ERROR_CODE_T result);
+
+    string m_name;
+    mutex m_lock;
+    // Waiting commands, including preempted ones that already started.
+    deque<shared_ptr<AsyncCommand> > m_commands;
+    shared_ptr<AsyncCommand> m_pCurrent;
+    bool m_stepping;
+    uint64_t m_nextSequence;
+};
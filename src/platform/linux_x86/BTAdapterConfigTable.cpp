@@ -0,0 +1,323 @@
+#include "BTAdapterConfigTable.h"
+
+#include <string.h>
+
+#include "BtAddress.h"
+
+CBTAdapterConfigTable::CBTAdapterConfigTable(INT16U numCards)
+    : m_cards(numCards), m_changedBits((numCards + 63) / 64, 0), m_numChanged(0)
+{
+}
+
+void CBTAdapterConfigTable::MarkChanged(INT8U cardNumber)
+{
+    uint64_t bit = 1ULL << (cardNumber % 64);
+    uint64_t &word = m_changedBits[cardNumber / 64];
+    if ((word & bit) == 0)
+    {
+        word |= bit;
+        m_numChanged++;
+    }
+    PublishCard(cardNumber);
+}
+
+// Called with m_cs held, which also keeps the shared table single-writer.
+void CBTAdapterConfigTable::PublishCard(INT8U cardNumber)
+{
+    if (!m_pSharedState)
+        return;
+
+    SharedCardState *pState = m_pSharedState->BeginUpdate(cardNumber);
+    if (pState == NULL)
+        return;
+
+    const CardEntry &entry = m_cards[cardNumber];
+    pState->isOnline = entry.isOnline ? 1 : 0;
+    pState->isConnected = entry.isConnected ? 1 : 0;
+    pState->peerAddress = entry.peerAddress;
+    strncpy(pState->peerName, entry.btDeviceName.c_str(), SHARED_ADAPTER_NAME_SIZE - 1);
+    pState->peerName[SHARED_ADAPTER_NAME_SIZE - 1] = '\0';
+
+    INT16U numDetected = 0;
+    DetectedDeviceList::const_iterator iter;
+    for (iter = entry.detectedDevices.begin();
+         iter != entry.detectedDevices.end() && numDetected < SHARED_ADAPTER_MAX_DETECTED; ++iter, numDetected++)
+    {
+        SharedDetectedDevice &device = pState->detected[numDetected];
+        device.address = iter->address;
+        strncpy(device.name, iter->btDeviceName.c_str(), SHARED_ADAPTER_NAME_SIZE - 1);
+        device.name[SHARED_ADAPTER_NAME_SIZE - 1] = '\0';
+    }
+    pState->numDetected = numDetected;
+
+    m_pSharedState->EndUpdate(cardNumber);
+}
+
+// Drops the card's contribution to IsPairedToIABluetoothAdapter.
+void CBTAdapterConfigTable::ReleasePeer(CardEntry &entry)
+{
+    if (entry.peerAddress == 0)
+        return;
+
+    unordered_map<uint64_t, INT32U>::iterator iter = m_peerRefCounts.find(entry.peerAddress);
+    if (iter != m_peerRefCounts.end() && --iter->second == 0)
+    {
+        m_peerRefCounts.erase(iter);
+    }
+    entry.peerAddress = 0;
+}
+
+BOOLEAN CBTAdapterConfigTable::TableChanged(bool clearChangeFlag)
+{
+    CSimpleLock myLock(&m_cs);
+    BOOLEAN changed = (m_numChanged != 0) ? TRUE : FALSE;
+    if (clearChangeFlag && changed)
+    {
+        m_changedBits.assign(m_changedBits.size(), 0);
+        m_numChanged = 0;
+    }
+    return changed;
+}
+
+INT16U CBTAdapterConfigTable::GetNumTableEntries(void)
+{
+    return (INT16U)m_cards.size();
+}
+
+INT16U CBTAdapterConfigTable::GetNumChangedEntries(void)
+{
+    CSimpleLock myLock(&m_cs);
+    return m_numChanged;
+}
+
+ERROR_CODE_T CBTAdapterConfigTable::SetAdapterOnline(INT8U cardNumber, bool isOnline)
+{
+    RETURN_EC_IF_TRUE(ERROR_INVALID_PARAMETER, cardNumber >= m_cards.size());
+    CSimpleLock myLock(&m_cs);
+
+    CardEntry &entry = m_cards[cardNumber];
+    if (entry.isOnline != isOnline)
+    {
+        entry.isOnline = isOnline;
+        MarkChanged(cardNumber);
+    }
+    return STATUS_SUCCESS;
+}
+
+ERROR_CODE_T CBTAdapterConfigTable::GetAdapterOnline(INT8U cardNumber, bool &isOnlineOut)
+{
+    RETURN_EC_IF_TRUE(ERROR_INVALID_PARAMETER, cardNumber >= m_cards.size());
+    CSimpleLock myLock(&m_cs);
+
+    isOnlineOut = m_cards[cardNumber].isOnline;
+    return STATUS_SUCCESS;
+}
+
+ERROR_CODE_T CBTAdapterConfigTable::SetConnectionState(INT8U cardNumber, bool isConnected, string btAddress,
+                                                       string btDeviceName)
+{
+    RETURN_EC_IF_TRUE(ERROR_INVALID_PARAMETER, cardNumber >= m_cards.size());
+
+    // A link whose peer the card can't name still counts as connected.
+    uint64_t peerAddress = 0;
+    if (isConnected && !btAddress.empty())
+    {
+        RETURN_IF_FAILED(PackBtAddress(btAddress.c_str(), peerAddress));
+    }
+
+    CSimpleLock myLock(&m_cs);
+    CardEntry &entry = m_cards[cardNumber];
+    if (entry.isConnected == isConnected && entry.btAddress == btAddress && entry.btDeviceName == btDeviceName)
+        return STATUS_SUCCESS;
+
+    ReleasePeer(entry);
+    entry.isConnected = isConnected;
+    entry.btAddress = btAddress;
+    entry.btDeviceName = btDeviceName;
+    if (peerAddress != 0)
+    {
+        entry.peerAddress = peerAddress;
+        m_peerRefCounts[peerAddress]++;
+    }
+
+    MarkChanged(cardNumber);
+    return STATUS_SUCCESS;
+}
+
+ERROR_CODE_T CBTAdapterConfigTable::GetConnectionState(INT8U cardNumber, bool &isConnectedOut, string &btAddressOut,
+                                                       string &btDeviceNameOut)
+{
+    RETURN_EC_IF_TRUE(ERROR_INVALID_PARAMETER, cardNumber >= m_cards.size());
+    CSimpleLock myLock(&m_cs);
+
+    const CardEntry &entry = m_cards[cardNumber];
+    isConnectedOut = entry.isConnected;
+    btAddressOut = entry.btAddress;
+    btDeviceNameOut = entry.btDeviceName;
+    return STATUS_SUCCESS;
+}
+
+ERROR_CODE_T CBTAdapterConfigTable::AddDetectedDevice(INT8U cardNumber, string btAddress, string btDeviceName)
+{
+    RETURN_EC_IF_TRUE(ERROR_INVALID_PARAMETER, cardNumber >= m_cards.size());
+
+    uint64_t address;
+    RETURN_IF_FAILED(PackBtAddress(btAddress.c_str(), address));
+
+    CSimpleLock myLock(&m_cs);
+    CardEntry &entry = m_cards[cardNumber];
+    unordered_map<uint64_t, DetectedDeviceList::iterator>::iterator found = entry.detectedIndex.find(address);
+    if (found != entry.detectedIndex.end())
+    {
+        // Repeated inquiry results keep their position; only a new name
+        // counts as a change.
+        if (found->second->btDeviceName != btDeviceName)
+        {
+            found->second->btDeviceName = btDeviceName;
+            MarkChanged(cardNumber);
+        }
+        return STATUS_SUCCESS;
+    }
+
+    DetectedDevice device;
+    device.address = address;
+    device.btAddress = btAddress;
+    device.btDeviceName = btDeviceName;
+    entry.detectedIndex[address] = entry.detectedDevices.insert(entry.detectedDevices.end(), device);
+    MarkChanged(cardNumber);
+    return STATUS_SUCCESS;
+}
+
+ERROR_CODE_T CBTAdapterConfigTable::RemoveDetectedDevice(INT8U cardNumber, string btAddress)
+{
+    RETURN_EC_IF_TRUE(ERROR_INVALID_PARAMETER, cardNumber >= m_cards.size());
+
+    uint64_t address;
+    RETURN_IF_FAILED(PackBtAddress(btAddress.c_str(), address));
+
+    CSimpleLock myLock(&m_cs);
+    CardEntry &entry = m_cards[cardNumber];
+    unordered_map<uint64_t, DetectedDeviceList::iterator>::iterator found = entry.detectedIndex.find(address);
+    if (found == entry.detectedIndex.end())
+        return STATUS_SUCCESS;
+
+    entry.detectedDevices.erase(found->second);
+    entry.detectedIndex.erase(found);
+    MarkChanged(cardNumber);
+    return STATUS_SUCCESS;
+}
+
+ERROR_CODE_T CBTAdapterConfigTable::ClearDetectedDeviceList(INT8U cardNumber)
+{
+    RETURN_EC_IF_TRUE(ERROR_INVALID_PARAMETER, cardNumber >= m_cards.size());
+    CSimpleLock myLock(&m_cs);
+
+    CardEntry &entry = m_cards[cardNumber];
+    if (entry.detectedDevices.empty())
+        return STATUS_SUCCESS;
+
+    entry.detectedDevices.clear();
+    entry.detectedIndex.clear();
+    MarkChanged(cardNumber);
+    return STATUS_SUCCESS;
+}
+
+ERROR_CODE_T CBTAdapterConfigTable::GetNextDetectedDevice(INT8U cardNumber, string previousBtAddress,
+                                                          string &btAddressOut, string &btDeviceNameOut)
+{
+    RETURN_EC_IF_TRUE(ERROR_INVALID_PARAMETER, cardNumber >= m_cards.size());
+
+    uint64_t previousAddress = 0;
+    if (!previousBtAddress.empty())
+    {
+        RETURN_IF_FAILED(PackBtAddress(previousBtAddress.c_str(), previousAddress));
+    }
+
+    CSimpleLock myLock(&m_cs);
+    CardEntry &entry = m_cards[cardNumber];
+    DetectedDeviceList::iterator next = entry.detectedDevices.begin();
+    if (previousAddress != 0)
+    {
+        unordered_map<uint64_t, DetectedDeviceList::iterator>::iterator found =
+            entry.detectedIndex.find(previousAddress);
+        RETURN_EC_IF_TRUE(ERROR_INVALID_PARAMETER, found == entry.detectedIndex.end());
+        next = found->second;
+        ++next;
+    }
+
+    if (next == entry.detectedDevices.end())
+        return ERROR_FAILED;
+
+    btAddressOut = next->btAddress;
+    btDeviceNameOut = next->btDeviceName;
+    return STATUS_SUCCESS;
+}
+
+bool CBTAdapterConfigTable::IsIABluetoothAdapter(string btAddress)
+{
+    uint64_t address;
+    if (FAILED(PackBtAddress(btAddress.c_str(), address)))
+        return false;
+
+    CSimpleLock myLock(&m_cs);
+    return m_adapterAddresses.count(address) != 0;
+}
+
+bool CBTAdapterConfigTable::IsPairedToIABluetoothAdapter(string btAddress)
+{
+    uint64_t address;
+    if (FAILED(PackBtAddress(btAddress.c_str(), address)))
+        return false;
+
+    CSimpleLock myLock(&m_cs);
+    return m_peerRefCounts.count(address) != 0;
+}
+
+ERROR_CODE_T CBTAdapterConfigTable::SetAdapterAddress(INT8U cardNumber, string btAddress)
+{
+    RETURN_EC_IF_TRUE(ERROR_INVALID_PARAMETER, cardNumber >= m_cards.size());
+
+    uint64_t address = 0;
+    if (!btAddress.empty())
+    {
+        RETURN_IF_FAILED(PackBtAddress(btAddress.c_str(), address));
+    }
+
+    CSimpleLock myLock(&m_cs);
+    CardEntry &entry = m_cards[cardNumber];
+    if (entry.adapterAddress == address)
+        return STATUS_SUCCESS;
+
+    if (entry.adapterAddress != 0)
+    {
+        // Another card may share the address only through misconfiguration,
+        // but keep the set consistent if it does.
+        bool stillUsed = false;
+        for (size_t i = 0; i < m_cards.size() && !stillUsed; i++)
+        {
+            stillUsed = (i != cardNumber && m_cards[i].adapterAddress == entry.adapterAddress);
+        }
+        if (!stillUsed)
+        {
+            m_adapterAddresses.erase(entry.adapterAddress);
+        }
+    }
+
+    entry.adapterAddress = address;
+    if (address != 0)
+    {
+        m_adapterAddresses.insert(address);
+    }
+    MarkChanged(cardNumber);
+    return STATUS_SUCCESS;
+}
+
+void CBTAdapterConfigTable::SetSharedStateWriter(shared_ptr<CSharedAdapterStateWriter> pWriter)
+{
+    CSimpleLock myLock(&m_cs);
+    m_pSharedState = pWriter;
+    for (size_t i = 0; i < m_cards.size() && i <= 0xFF; i++)
+    {
+        PublishCard((INT8U)i);
+    }
+}
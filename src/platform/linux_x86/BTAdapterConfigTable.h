@@ -0,0 +1,95 @@
+#pragma once
+
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "CPPInterfaces.h"
+#include "CriticalSection.h"
+#include "SharedAdapterState.h"
+#include "types.h"
+
+using namespace std;
+
+// Room for every card number.
+#define BT_ADAPTER_DEFAULT_CARD_COUNT 256
+
+// In-process adapter configuration table, one entry per card. Changes are
+// tracked in a bitmap so TableChanged/GetNumChangedEntries don't walk the
+// table, detected devices keep an ordered index so GetNextDetectedDevice is
+// a hash lookup plus one step, and adapter/peer addresses are kept in hashed
+// sets keyed by the packed address.
+class CBTAdapterConfigTable : public IBTAdapterConfigTable
+{
+  public:
+    CBTAdapterConfigTable(INT16U numCards = BT_ADAPTER_DEFAULT_CARD_COUNT);
+
+    virtual BOOLEAN TableChanged(bool clearChangeFlag = true);
+    virtual INT16U GetNumTableEntries(void);
+    virtual INT16U GetNumChangedEntries(void);
+    virtual ERROR_CODE_T SetAdapterOnline(INT8U cardNumber, bool isOnline);
+    virtual ERROR_CODE_T GetAdapterOnline(INT8U cardNumber, bool &isOnlineOut);
+    virtual ERROR_CODE_T SetConnectionState(INT8U cardNumber, bool isConnected, string btAddress,
+                                            string btDeviceName);
+    virtual ERROR_CODE_T GetConnectionState(INT8U cardNumber, bool &isConnectedOut, string &btAddressOut,
+                                            string &btDeviceNameOut);
+    virtual ERROR_CODE_T AddDetectedDevice(INT8U cardNumber, string btAddress, string btDeviceName);
+    virtual ERROR_CODE_T RemoveDetectedDevice(INT8U cardNumber, string btAddress);
+    virtual ERROR_CODE_T ClearDetectedDeviceList(INT8U cardNumber);
+
+    // Pass an empty previousBtAddress to get the first device. Returns
+    // ERROR_FAILED past the last device and ERROR_INVALID_PARAMETER if
+    // previousBtAddress is no longer in the list.
+    virtual ERROR_CODE_T GetNextDetectedDevice(INT8U cardNumber, string previousBtAddress, string &btAddressOut,
+                                               string &btDeviceNameOut);
+    virtual bool IsIABluetoothAdapter(string btAddress);
+    virtual bool IsPairedToIABluetoothAdapter(string btAddress);
+
+    // Registers the local address of a card's adapter for
+    // IsIABluetoothAdapter. An empty address clears it.
+    ERROR_CODE_T SetAdapterAddress(INT8U cardNumber, string btAddress);
+
+    // Mirrors every card into shared memory for other processes, starting
+    // with the current contents. Pass NULL to stop mirroring.
+    void SetSharedStateWriter(shared_ptr<CSharedAdapterStateWriter> pWriter);
+
+  private:
+    struct DetectedDevice
+    {
+        uint64_t address;
+        string btAddress;
+        string btDeviceName;
+    };
+
+    typedef list<DetectedDevice> DetectedDeviceList;
+
+    struct CardEntry
+    {
+        CardEntry() : isOnline(false), isConnected(false), adapterAddress(0), peerAddress(0)
+        {
+        }
+
+        bool isOnline;
+        bool isConnected;
+        string btAddress;
+        string btDeviceName;
+        uint64_t adapterAddress;
+        uint64_t peerAddress;
+        DetectedDeviceList detectedDevices;
+        unordered_map<uint64_t, DetectedDeviceList::iterator> detectedIndex;
+    };
+
+    void MarkChanged(INT8U cardNumber);
+    void ReleasePeer(CardEntry &entry);
+    void PublishCard(INT8U cardNumber);
+
+    CCriticalSection m_cs;
+    vector<CardEntry> m_cards;
+    vector<uint64_t> m_changedBits;
+    INT16U m_numChanged;
+    unordered_set<uint64_t> m_adapterAddresses;
+    unordered_map<uint64_t, INT32U> m_peerRefCounts;
+    shared_ptr<CSharedAdapterStateWriter> m_pSharedState;
+};
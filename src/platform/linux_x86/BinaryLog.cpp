@@ -0,0 +1,384 @@
+#include "BinaryLog.h"
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ExtIO.h"
+
+#define BINARY_LOG_IDLE_MS 2
+#define BINARY_LOG_OUTPUT_BYTES 65536
+#define BINARY_LOG_LINE_BYTES 512
+
+// Single-producer/single-consumer ring: the owning thread advances head, the
+// writer thread advances tail.
+struct BinaryLogRing
+{
+    BinaryLogRing() : head(0), tail(0), orphaned(false)
+    {
+    }
+
+    BinaryLogRecord records[BINARY_LOG_RING_RECORDS];
+    atomic<INT32U> head;
+    atomic<INT32U> tail;
+    atomic<bool> orphaned;
+};
+
+// Marks the ring as orphaned when its thread exits so the writer can drain
+// and release it.
+struct BinaryLogRingHolder
+{
+    ~BinaryLogRingHolder()
+    {
+        if (pRing)
+            pRing->orphaned = true;
+    }
+
+    shared_ptr<BinaryLogRing> pRing;
+};
+
+atomic<INT8U> CBinaryLog::m_level(DEBUG_TRACE_INFO);
+
+static mutex g_registryLock;
+static vector<shared_ptr<BinaryLogRing> > g_rings;
+static atomic<bool> g_running(false);
+static atomic<INT32U> g_dropped(0);
+static thread g_writerThread;
+static FILE *g_pOutput = stdout;
+
+static thread_local BinaryLogRingHolder t_ringHolder;
+// Used when the writer isn't running; the record is formatted synchronously.
+static thread_local BinaryLogRecord t_scratchRecord;
+
+static BinaryLogRing *GetThreadRing(void)
+{
+    if (!t_ringHolder.pRing)
+    {
+        t_ringHolder.pRing = make_shared<BinaryLogRing>();
+
+        lock_guard<mutex> guard(g_registryLock);
+        g_rings.push_back(t_ringHolder.pRing);
+    }
+    return t_ringHolder.pRing.get();
+}
+
+void CBinaryLog::SetLevel(INT8U level)
+{
+    m_level = level;
+}
+
+INT8U CBinaryLog::GetLevel(void)
+{
+    return m_level;
+}
+
+INT32U CBinaryLog::GetDroppedCount(void)
+{
+    return g_dropped;
+}
+
+void CBinaryLog::CopyModule(BinaryLogRecord *pRecord, const CHAR8 *pModule)
+{
+    if (pModule == NULL)
+    {
+        pRecord->module[0] = '\0';
+        return;
+    }
+
+    strncpy(pRecord->module, pModule, sizeof(pRecord->module) - 1);
+    pRecord->module[sizeof(pRecord->module) - 1] = '\0';
+}
+
+void CBinaryLog::StoreString(BinaryLogRecord *pRecord, const CHAR8 *pString)
+{
+    INT8U index = pRecord->argCount++;
+    pRecord->argTypes[index] = LOG_ARG_STRING;
+
+    // The last byte is kept as an empty string for arguments that no longer
+    // fit, so every stored offset points at a terminated string.
+    const size_t emptyOffset = sizeof(pRecord->strings) - 1;
+    pRecord->strings[emptyOffset] = '\0';
+
+    // Strings are copied because the caller's buffer may be gone by the time
+    // the writer formats the record. Long strings are truncated.
+    size_t space = emptyOffset - pRecord->stringBytesUsed;
+    if (space == 0)
+    {
+        pRecord->args[index].stringOffset = (INT8U)emptyOffset;
+        return;
+    }
+    pRecord->args[index].stringOffset = pRecord->stringBytesUsed;
+
+    const CHAR8 *pSource = (pString != NULL) ? pString : "(null)";
+    size_t length = ext_strnlen(pSource, space - 1);
+    memcpy(&pRecord->strings[pRecord->stringBytesUsed], pSource, length);
+    pRecord->strings[pRecord->stringBytesUsed + length] = '\0';
+    pRecord->stringBytesUsed += (INT8U)(length + 1);
+}
+
+BinaryLogRecord *CBinaryLog::BeginRecord(void)
+{
+    if (!g_running.load(memory_order_acquire))
+        return &t_scratchRecord;
+
+    BinaryLogRing *pRing = GetThreadRing();
+    INT32U head = pRing->head.load(memory_order_relaxed);
+    if (head - pRing->tail.load(memory_order_acquire) >= BINARY_LOG_RING_RECORDS)
+    {
+        g_dropped++;
+        return NULL;
+    }
+
+    return &pRing->records[head % BINARY_LOG_RING_RECORDS];
+}
+
+void CBinaryLog::CommitRecord(BinaryLogRecord *pRecord)
+{
+    if (pRecord == &t_scratchRecord)
+    {
+        CHAR8 line[BINARY_LOG_LINE_BYTES];
+        size_t length = FormatRecord(*pRecord, line, sizeof(line));
+        fwrite(line, 1, length, g_pOutput);
+        return;
+    }
+
+    BinaryLogRing *pRing = t_ringHolder.pRing.get();
+    pRing->head.store(pRing->head.load(memory_order_relaxed) + 1, memory_order_release);
+}
+
+// Formats one conversion using the stored argument. The length modifier from
+// the original format is replaced because every integer is stored 64-bit.
+static int FormatConversion(CHAR8 *pOut, size_t outSize, string spec, CHAR8 conversion, const BinaryLogRecord &record, INT8U &argIndex)
+{
+    string cleanSpec;
+    for (size_t i = 0; i < spec.size(); i++)
+    {
+        if (strchr("hlqjztL", spec[i]) == NULL)
+            cleanSpec += spec[i];
+    }
+
+    if (argIndex >= record.argCount)
+        return snprintf(pOut, outSize, "%s", "<?>");
+
+    INT8U index = argIndex++;
+    switch (conversion)
+    {
+        case 'd':
+        case 'i':
+            cleanSpec += "ll";
+            cleanSpec += conversion;
+            return snprintf(pOut, outSize, cleanSpec.c_str(), (long long)record.args[index].s);
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+            cleanSpec += "ll";
+            cleanSpec += conversion;
+            return snprintf(pOut, outSize, cleanSpec.c_str(), (unsigned long long)record.args[index].u);
+        case 'c':
+            cleanSpec += conversion;
+            return snprintf(pOut, outSize, cleanSpec.c_str(), (int)record.args[index].s);
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            cleanSpec += conversion;
+            return snprintf(pOut, outSize, cleanSpec.c_str(), record.args[index].d);
+        case 's':
+            cleanSpec += conversion;
+            if (record.argTypes[index] != LOG_ARG_STRING)
+                return snprintf(pOut, outSize, cleanSpec.c_str(), "<?>");
+            return snprintf(pOut, outSize, cleanSpec.c_str(), &record.strings[record.args[index].stringOffset]);
+        case 'p':
+            cleanSpec += conversion;
+            return snprintf(pOut, outSize, cleanSpec.c_str(), record.args[index].p);
+        default:
+            return snprintf(pOut, outSize, "%s", "<?>");
+    }
+}
+
+size_t CBinaryLog::FormatRecord(const BinaryLogRecord &record, CHAR8 *pOutBuf, size_t outBufSize)
+{
+    if (outBufSize == 0)
+        return 0;
+
+    size_t used = 0;
+    INT8U argIndex = 0;
+    const CHAR8 *pFormat = (record.pFormat != NULL) ? record.pFormat : "";
+
+    while (*pFormat != '\0' && used + 1 < outBufSize)
+    {
+        if (*pFormat != '%')
+        {
+            pOutBuf[used++] = *pFormat++;
+            continue;
+        }
+
+        if (pFormat[1] == '%')
+        {
+            pOutBuf[used++] = '%';
+            pFormat += 2;
+            continue;
+        }
+
+        // Collect flags, width, precision and length up to the conversion.
+        string spec = "%";
+        pFormat++;
+        while (*pFormat != '\0' && strchr("diuoxXcsfFeEgGaAp", *pFormat) == NULL)
+        {
+            if (*pFormat == '*')
+            {
+                // A '*' width or precision consumes an int argument.
+                if (argIndex < record.argCount)
+                    spec += to_string<int>((int)record.args[argIndex++].s);
+            }
+            else
+            {
+                spec += *pFormat;
+            }
+            pFormat++;
+        }
+
+        if (*pFormat == '\0')
+            break;
+
+        int written = FormatConversion(&pOutBuf[used], outBufSize - used, spec, *pFormat++, record, argIndex);
+        if (written > 0)
+            used += ((size_t)written < outBufSize - used) ? (size_t)written : (outBufSize - used - 1);
+    }
+
+    pOutBuf[used] = '\0';
+    return used;
+}
+
+// Drains every ring once. Returns the number of records written.
+static INT32U DrainRings(CHAR8 *pOutput, size_t outputSize)
+{
+    vector<shared_ptr<BinaryLogRing> > rings;
+    {
+        lock_guard<mutex> guard(g_registryLock);
+        rings = g_rings;
+    }
+
+    INT32U recordCount = 0;
+    size_t used = 0;
+    for (size_t i = 0; i < rings.size(); i++)
+    {
+        BinaryLogRing *pRing = rings[i].get();
+        INT32U tail = pRing->tail.load(memory_order_relaxed);
+        INT32U head = pRing->head.load(memory_order_acquire);
+        while (tail != head)
+        {
+            if (outputSize - used < BINARY_LOG_LINE_BYTES)
+            {
+                fwrite(pOutput, 1, used, g_pOutput);
+                used = 0;
+            }
+
+            used += CBinaryLog::FormatRecord(pRing->records[tail % BINARY_LOG_RING_RECORDS], &pOutput[used], BINARY_LOG_LINE_BYTES);
+            tail++;
+            recordCount++;
+        }
+        pRing->tail.store(tail, memory_order_release);
+    }
+
+    if (used > 0)
+    {
+        fwrite(pOutput, 1, used, g_pOutput);
+    }
+    if (recordCount > 0)
+    {
+        fflush(g_pOutput);
+    }
+
+    // Release rings whose threads have exited once they are empty.
+    lock_guard<mutex> guard(g_registryLock);
+    for (vector<shared_ptr<BinaryLogRing> >::iterator iter = g_rings.begin(); iter != g_rings.end();)
+    {
+        BinaryLogRing *pRing = iter->get();
+        if (pRing->orphaned && pRing->head.load(memory_order_acquire) == pRing->tail.load(memory_order_relaxed))
+            iter = g_rings.erase(iter);
+        else
+            ++iter;
+    }
+
+    return recordCount;
+}
+
+static void WriterThreadMain(void)
+{
+    vector<CHAR8> output(BINARY_LOG_OUTPUT_BYTES);
+    while (g_running)
+    {
+        if (DrainRings(&output[0], output.size()) == 0)
+        {
+            this_thread::sleep_for(chrono::milliseconds(BINARY_LOG_IDLE_MS));
+        }
+    }
+
+    // Final pass so nothing logged before Stop() is lost.
+    DrainRings(&output[0], output.size());
+}
+
+ERROR_CODE_T CBinaryLog::Start(FILE *pOutput)
+{
+    RETURN_EC_IF_NULL(ERROR_INVALID_PARAMETER, pOutput);
+    RETURN_EC_IF_TRUE(ERROR_FAILED, g_running);
+
+    g_pOutput = pOutput;
+    g_running = true;
+    g_writerThread = thread(WriterThreadMain);
+    return STATUS_SUCCESS;
+}
+
+void CBinaryLog::Stop(void)
+{
+    if (!g_running)
+        return;
+
+    g_running = false;
+    if (g_writerThread.joinable())
+    {
+        g_writerThread.join();
+    }
+}
+
+void CBinaryLog::Flush(void)
+{
+    while (g_running)
+    {
+        bool empty = true;
+        {
+            lock_guard<mutex> guard(g_registryLock);
+            for (size_t i = 0; i < g_rings.size(); i++)
+            {
+                if (g_rings[i]->head.load(memory_order_acquire) != g_rings[i]->tail.load(memory_order_acquire))
+                    empty = false;
+            }
+        }
+
+        if (empty)
+            break;
+
+        this_thread::sleep_for(chrono::milliseconds(BINARY_LOG_IDLE_MS));
+    }
+    fflush(g_pOutput);
+}
+
+// Stops the writer (draining what is queued) when the process exits without
+// calling Stop(). Defined last so it is destroyed before the state above.
+struct BinaryLogShutdown
+{
+    ~BinaryLogShutdown()
+    {
+        CBinaryLog::Stop();
+    }
+};
+static BinaryLogShutdown g_shutdown;
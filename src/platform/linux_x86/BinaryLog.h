@@ -0,0 +1,160 @@
+#pragma once
+
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+#include <type_traits>
+
+#include "types.h"
+
+#define BINARY_LOG_MAX_ARGS 8
+#define BINARY_LOG_STRING_BYTES 96
+#define BINARY_LOG_MODULE_BYTES OS_TASK_NAME_SIZE
+#define BINARY_LOG_RING_RECORDS 1024
+
+typedef enum
+{
+    LOG_ARG_SIGNED,
+    LOG_ARG_UNSIGNED,
+    LOG_ARG_DOUBLE,
+    LOG_ARG_POINTER,
+    LOG_ARG_STRING,
+} LogArgType_t;
+
+// One log call, captured without formatting. The format string pointer is the
+// record's id; it must be a string literal (or otherwise outlive the logger),
+// which every DebugPrintf/RETURN_* call site already satisfies.
+struct BinaryLogRecord
+{
+    const CHAR8 *pFormat;
+    INT8U level;
+    INT8U argCount;
+    INT8U stringBytesUsed;
+    INT8U argTypes[BINARY_LOG_MAX_ARGS];
+    union
+    {
+        int64_t s;
+        uint64_t u;
+        double d;
+        const void *p;
+        INT8U stringOffset;
+    } args[BINARY_LOG_MAX_ARGS];
+    CHAR8 module[BINARY_LOG_MODULE_BYTES];
+    CHAR8 strings[BINARY_LOG_STRING_BYTES];
+};
+
+// Appends records to a lock-free ring owned by the calling thread; a
+// background thread drains every ring, formats the records and writes them
+// out. Records are dropped (and counted) rather than blocking when a ring is
+// full.
+class CBinaryLog
+{
+  public:
+    static ERROR_CODE_T Start(FILE *pOutput = stdout);
+    static void Stop(void);
+    static void Flush(void);
+
+    // Global ceiling for messages that don't carry their own verbosity
+    // (RETURN_* macros, LogPrintf).
+    static void SetLevel(INT8U level);
+    static INT8U GetLevel(void);
+    static bool IsLevelEnabled(INT8U level)
+    {
+        return level != DEBUG_NO_LOGGING && level <= m_level.load(memory_order_relaxed);
+    }
+
+    static INT32U GetDroppedCount(void);
+
+    template <typename... Args>
+    static void Write(INT8U level, const CHAR8 *pModule, const CHAR8 *pFormat, Args... args)
+    {
+        BinaryLogRecord *pRecord = BeginRecord();
+        if (pRecord == NULL)
+            return;
+
+        pRecord->pFormat = pFormat;
+        pRecord->level = level;
+        pRecord->argCount = 0;
+        pRecord->stringBytesUsed = 0;
+        CopyModule(pRecord, pModule);
+        StoreArgs(pRecord, args...);
+        CommitRecord(pRecord);
+    }
+
+    // Formats a record into outBuf; used by the writer thread and when the
+    // logger isn't running.
+    static size_t FormatRecord(const BinaryLogRecord &record, CHAR8 *pOutBuf, size_t outBufSize);
+
+  private:
+    static BinaryLogRecord *BeginRecord(void);
+    static void CommitRecord(BinaryLogRecord *pRecord);
+    static void CopyModule(BinaryLogRecord *pRecord, const CHAR8 *pModule);
+    static void StoreString(BinaryLogRecord *pRecord, const CHAR8 *pString);
+
+    static void StoreArgs(BinaryLogRecord *)
+    {
+    }
+
+    template <typename T, typename... Rest>
+    static void StoreArgs(BinaryLogRecord *pRecord, T first, Rest... rest)
+    {
+        if (pRecord->argCount < BINARY_LOG_MAX_ARGS)
+        {
+            StoreArg(pRecord, first);
+        }
+        StoreArgs(pRecord, rest...);
+    }
+
+    static void StoreArg(BinaryLogRecord *pRecord, const CHAR8 *pString)
+    {
+        StoreString(pRecord, pString);
+    }
+
+    static void StoreArg(BinaryLogRecord *pRecord, CHAR8 *pString)
+    {
+        StoreString(pRecord, pString);
+    }
+
+    template <typename T>
+    static typename enable_if<is_integral<T>::value || is_enum<T>::value>::type StoreArg(BinaryLogRecord *pRecord, T value)
+    {
+        INT8U index = pRecord->argCount++;
+        if (is_signed<T>::value || is_enum<T>::value)
+        {
+            pRecord->argTypes[index] = LOG_ARG_SIGNED;
+            pRecord->args[index].s = (int64_t)value;
+        }
+        else
+        {
+            pRecord->argTypes[index] = LOG_ARG_UNSIGNED;
+            pRecord->args[index].u = (uint64_t)value;
+        }
+    }
+
+    template <typename T>
+    static typename enable_if<is_floating_point<T>::value>::type StoreArg(BinaryLogRecord *pRecord, T value)
+    {
+        INT8U index = pRecord->argCount++;
+        pRecord->argTypes[index] = LOG_ARG_DOUBLE;
+        pRecord->args[index].d = (double)value;
+    }
+
+    template <typename T>
+    static void StoreArg(BinaryLogRecord *pRecord, T *pValue)
+    {
+        INT8U index = pRecord->argCount++;
+        pRecord->argTypes[index] = LOG_ARG_POINTER;
+        pRecord->args[index].p = (const void *)pValue;
+    }
+
+    static atomic<INT8U> m_level;
+};
+
+#define LogPrintf(logLevel, module, format, ...)                                  \
+    do                                                                            \
+    {                                                                             \
+        if (CBinaryLog::IsLevelEnabled(logLevel))                                 \
+        {                                                                         \
+            CBinaryLog::Write((logLevel), (module), (format), ##__VA_ARGS__);     \
+        }                                                                         \
+    } while (0)
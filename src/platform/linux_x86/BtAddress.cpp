@@ -0,0 +1,66 @@
+#include "BtAddress.h"
+
+#include <string>
+
+#include "ExtIO.h"
+
+#define HEX_INVALID 0xFF
+
+static const CHAR8 g_hexDigits[] = "0123456789ABCDEF";
+
+// Branch-free apart from selects the compiler turns into cmovs, so the six
+// octets decode without mispredictions.
+static inline INT8U HexValue(CHAR8 c)
+{
+    INT8U digit = (INT8U)((INT8U)c - '0');
+    INT8U alpha = (INT8U)(((INT8U)c | 0x20) - 'a');
+    INT8U value = (digit < 10) ? digit : (INT8U)(alpha + 10);
+    return (digit < 10 || alpha < 6) ? value : HEX_INVALID;
+}
+
+ERROR_CODE_T PackBtAddress(const CHAR8 *pText, uint64_t &addressOut)
+{
+    RETURN_EC_IF_NULL(ERROR_INVALID_PARAMETER, pText);
+
+    // 17 characters with separators every third character, or 12 without.
+    INT32U stride;
+    size_t length = ext_strnlen(pText, BT_ADDRESS_STRING_SIZE);
+    if (length == BT_ADDRESS_STRING_SIZE - 1)
+        stride = 3;
+    else if (length == 12)
+        stride = 2;
+    else
+        return ERROR_INVALID_PARAMETER;
+
+    uint64_t address = 0;
+    INT8U invalid = 0;
+    for (INT32U octet = 0; octet < 6; octet++)
+    {
+        INT8U high = HexValue(pText[octet * stride]);
+        INT8U low = HexValue(pText[octet * stride + 1]);
+        invalid |= (INT8U)((high | low) & 0xF0);
+        address = (address << 8) | (uint64_t)((high << 4) | (low & 0x0F));
+
+        if (stride == 3 && octet < 5)
+        {
+            CHAR8 separator = pText[octet * stride + 2];
+            invalid |= (INT8U)((separator != ':' && separator != '-') ? 0xF0 : 0);
+        }
+    }
+
+    RETURN_EC_IF_TRUE(ERROR_INVALID_PARAMETER, invalid != 0);
+    addressOut = address;
+    return STATUS_SUCCESS;
+}
+
+void FormatBtAddress(uint64_t address, CHAR8 *pOut)
+{
+    for (INT32U octet = 0; octet < 6; octet++)
+    {
+        INT8U value = (INT8U)(address >> (8 * (5 - octet)));
+        pOut[octet * 3] = g_hexDigits[value >> 4];
+        pOut[octet * 3 + 1] = g_hexDigits[value & 0x0F];
+        pOut[octet * 3 + 2] = ':';
+    }
+    pOut[BT_ADDRESS_STRING_SIZE - 1] = '\0';
+}
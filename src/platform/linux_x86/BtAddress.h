@@ -0,0 +1,16 @@
+#pragma once
+
+#include "types.h"
+
+// Length of "xx:xx:xx:xx:xx:xx" plus the terminator.
+#define BT_ADDRESS_STRING_SIZE 18
+#define BT_ADDRESS_MASK 0xFFFFFFFFFFFFULL
+
+// Parses a 48-bit Bluetooth address into the low bits of a uint64_t. Accepts
+// "00:11:22:AA:BB:CC", "00-11-22-AA-BB-CC" and the bare "001122AABBCC" form
+// the module prints, in either case.
+ERROR_CODE_T PackBtAddress(const CHAR8 *pText, uint64_t &addressOut);
+
+// Formats a packed address as "00:11:22:AA:BB:CC" into a buffer of at least
+// BT_ADDRESS_STRING_SIZE bytes.
+void FormatBtAddress(uint64_t address, CHAR8 *pOut);
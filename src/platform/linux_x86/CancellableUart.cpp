@@ -0,0 +1,48 @@
+#include "CancellableUart.h"
+
+CCancellableUart::CCancellableUart(shared_ptr<IUart> pUart) : CUartDecorator(pUart), m_cancelled(false)
+{
+}
+
+void CCancellableUart::Cancel(void)
+{
+    m_cancelled = true;
+}
+
+bool CCancellableUart::IsCancelled(void) const
+{
+    return m_cancelled;
+}
+
+ERROR_CODE_T CCancellableUart::Open(BAUDRATE baud, BYTE_SIZE byteSize, PARITY parity, STOP_BITS stopBits)
+{
+    RETURN_EC_IF_TRUE(ERROR_FAILED, m_cancelled);
+    return m_pUart->Open(baud, byteSize, parity, stopBits);
+}
+
+INT32U CCancellableUart::RxBytesAvailable()
+{
+    return m_cancelled ? 0 : m_pUart->RxBytesAvailable();
+}
+
+void CCancellableUart::WritePort(const INT8U *pBuf, INT32U bytesToWrite, INT32U *pBytesWritten)
+{
+    if (m_cancelled)
+    {
+        if (pBytesWritten != NULL)
+            *pBytesWritten = 0;
+        return;
+    }
+    m_pUart->WritePort(pBuf, bytesToWrite, pBytesWritten);
+}
+
+void CCancellableUart::ReadPort(INT8U *pBuf, INT32U maxBytes, INT32U *pBytesRead)
+{
+    if (m_cancelled)
+    {
+        if (pBytesRead != NULL)
+            *pBytesRead = 0;
+        return;
+    }
+    m_pUart->ReadPort(pBuf, maxBytes, pBytesRead);
+}
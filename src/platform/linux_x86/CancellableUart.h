@@ -0,0 +1,31 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+#include "UartDecorator.h"
+#include "types.h"
+
+using namespace std;
+
+// IUart decorator that can be cut off from another thread. Once cancelled
+// it refuses to open, and reads and writes return at once without touching
+// the port, so whatever is talking to it gives up within one of its own
+// timeouts. The port itself is left for its owner to close, since closing
+// it under a concurrent read could hand the descriptor to someone else.
+class CCancellableUart : public CUartDecorator
+{
+  public:
+    CCancellableUart(shared_ptr<IUart> pUart);
+
+    void Cancel(void);
+    bool IsCancelled(void) const;
+
+    ERROR_CODE_T Open(BAUDRATE baud, BYTE_SIZE byteSize, PARITY parity, STOP_BITS stopBits) override;
+    INT32U RxBytesAvailable() override;
+    void WritePort(const INT8U *pBuf, INT32U bytesToWrite, INT32U *pBytesWritten) override;
+    void ReadPort(INT8U *pBuf, INT32U maxBytes, INT32U *pBytesRead) override;
+
+  private:
+    atomic<bool> m_cancelled;
+};
@@ -0,0 +1,123 @@
+#include "ClockSource.h"
+
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <thread>
+
+static CSystemClockSource g_systemClock;
+static atomic<IClockSource *> g_pClock(&g_systemClock);
+
+void SetClockSource(IClockSource *pClock)
+{
+    g_pClock.store((pClock != NULL) ? pClock : &g_systemClock, memory_order_release);
+}
+
+IClockSource &GetClockSource(void)
+{
+    return *g_pClock.load(memory_order_acquire);
+}
+
+//
+// CSystemClockSource
+//
+
+uint64_t CSystemClockSource::GetNowUs(void)
+{
+    // Monotonic, so timers and schedules don't jump with the wall clock.
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+void CSystemClockSource::SleepUs(uint64_t us)
+{
+    usleep((useconds_t)us);
+}
+
+//
+// CVirtualClockSource
+//
+
+CVirtualClockSource::CVirtualClockSource(uint64_t startUs, bool autoAdvance)
+    : m_nowUs(startUs), m_autoAdvance(autoAdvance), m_sleepers(0), m_participants(1)
+{
+}
+
+uint64_t CVirtualClockSource::GetNowUs(void)
+{
+    lock_guard<mutex> guard(m_lock);
+    return m_nowUs;
+}
+
+void CVirtualClockSource::SleepUs(uint64_t us)
+{
+    unique_lock<mutex> guard(m_lock);
+    uint64_t deadlineUs = m_nowUs + us;
+
+    multiset<uint64_t>::iterator deadline = m_deadlinesUs.insert(deadlineUs);
+    m_sleepers++;
+    m_changed.notify_all();
+    while (m_nowUs < deadlineUs)
+    {
+        // Only the earliest sleeper is woken; it may go back to sleep or do
+        // something that changes what the others are waiting for.
+        uint64_t earliestUs = *m_deadlinesUs.begin();
+        if (m_autoAdvance && m_sleepers >= m_participants && earliestUs > m_nowUs)
+        {
+            m_nowUs = earliestUs;
+            m_changed.notify_all();
+            continue;
+        }
+        m_changed.wait(guard);
+    }
+    m_deadlinesUs.erase(deadline);
+    m_sleepers--;
+
+    if (us == 0)
+    {
+        // Polling loops sleep for zero; let the rest of the test run.
+        guard.unlock();
+        this_thread::yield();
+    }
+}
+
+void CVirtualClockSource::Advance(uint64_t us)
+{
+    lock_guard<mutex> guard(m_lock);
+    m_nowUs += us;
+    m_changed.notify_all();
+}
+
+void CVirtualClockSource::SetAutoAdvance(bool autoAdvance)
+{
+    lock_guard<mutex> guard(m_lock);
+    m_autoAdvance = autoAdvance;
+    m_changed.notify_all();
+}
+
+void CVirtualClockSource::AddParticipant(void)
+{
+    lock_guard<mutex> guard(m_lock);
+    m_participants++;
+}
+
+void CVirtualClockSource::RemoveParticipant(void)
+{
+    lock_guard<mutex> guard(m_lock);
+    if (m_participants > 1)
+    {
+        m_participants--;
+    }
+    m_changed.notify_all();
+}
+
+void CVirtualClockSource::WaitForSleepers(INT32U count)
+{
+    unique_lock<mutex> guard(m_lock);
+    while (m_sleepers < count)
+    {
+        m_changed.wait(guard);
+    }
+}
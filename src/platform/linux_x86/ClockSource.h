@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <set>
+
+#include "types.h"
+
+using namespace std;
+
+// Where CTimeDelta, CTimeDeltaSec, CTimeDeltaUs and OSTimeDly get their
+// time from. The system clock is used unless a test installs another one.
+class IClockSource
+{
+  public:
+    virtual ~IClockSource()
+    {
+    }
+    virtual uint64_t GetNowUs(void) = 0;
+    virtual void SleepUs(uint64_t us) = 0;
+};
+
+class CSystemClockSource : public IClockSource
+{
+  public:
+    virtual uint64_t GetNowUs(void);
+    virtual void SleepUs(uint64_t us);
+};
+
+// Time only moves when Advance is called, or, with auto-advance on, once
+// every participating thread is asleep on the clock: it then jumps to the
+// earliest deadline, so timeout-driven code runs without waiting in real
+// time but a thread that is still working never sees time skip under it.
+class CVirtualClockSource : public IClockSource
+{
+  public:
+    CVirtualClockSource(uint64_t startUs = 0, bool autoAdvance = false);
+
+    virtual uint64_t GetNowUs(void);
+    virtual void SleepUs(uint64_t us);
+
+    void Advance(uint64_t us);
+    void SetAutoAdvance(bool autoAdvance);
+
+    // The thread driving the test counts as the first participant; add one
+    // for every other thread that sleeps on the clock, and remove it when
+    // that thread is done, or auto-advance stalls waiting for it.
+    void AddParticipant(void);
+    void RemoveParticipant(void);
+
+    // Blocks until at least this many threads are asleep on the clock, so a
+    // test can advance time once the code under test is waiting.
+    void WaitForSleepers(INT32U count);
+
+  private:
+    mutex m_lock;
+    condition_variable m_changed;
+    uint64_t m_nowUs;
+    bool m_autoAdvance;
+    INT32U m_sleepers;
+    INT32U m_participants;
+    multiset<uint64_t> m_deadlinesUs;
+};
+
+// Installs pClock for all timers; NULL restores the system clock. The
+// caller keeps ownership and must restore the clock before freeing it.
+void SetClockSource(IClockSource *pClock);
+IClockSource &GetClockSource(void);
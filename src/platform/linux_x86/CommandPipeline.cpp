@@ -0,0 +1,184 @@
+#include "CommandPipeline.h"
+
+#include "ExtIO.h"
+#include "TimeDelta.h"
+
+#define PIPELINE_RX_CHUNK 256
+#define PIPELINE_TERMINATOR "\r"
+
+static bool IsStatusLine(const string &line, ERROR_CODE_T &resultOut)
+{
+    if (line == "OK")
+    {
+        resultOut = STATUS_SUCCESS;
+        return true;
+    }
+
+    if (line.compare(0, 5, "ERROR") == 0)
+    {
+        resultOut = ERROR_FAILED;
+        return true;
+    }
+
+    return false;
+}
+
+CCommandPipeline::CCommandPipeline(weak_ptr<IUart> pUart, INT8U maxInFlight)
+    : m_pUart(pUart), m_maxInFlight(maxInFlight == 0 ? 1 : maxInFlight), m_cancel(false), m_unsolicitedCount(0)
+{
+}
+
+void CCommandPipeline::SetUnsolicitedHandler(UnsolicitedLineHandler handler)
+{
+    m_unsolicitedHandler = handler;
+}
+
+INT32U CCommandPipeline::GetUnsolicitedCount(void)
+{
+    return m_unsolicitedCount;
+}
+
+void CCommandPipeline::SetMaxInFlight(INT8U maxInFlight)
+{
+    m_maxInFlight = (maxInFlight == 0) ? 1 : maxInFlight;
+}
+
+INT8U CCommandPipeline::GetMaxInFlight(void)
+{
+    return m_maxInFlight;
+}
+
+void CCommandPipeline::SetCancelCurrentCommand(bool cancel)
+{
+    m_cancel = cancel;
+}
+
+bool CCommandPipeline::GetCancelCurrentCommand(void)
+{
+    return m_cancel;
+}
+
+ERROR_CODE_T CCommandPipeline::WriteWindow(shared_ptr<IUart> pUart, vector<PipelinedCommand> &commands, size_t &nextToSend, size_t oldest)
+{
+    // Everything that fits in the window goes out in a single write so the
+    // module sees the commands back-to-back.
+    string burst;
+    while (nextToSend < commands.size() && (nextToSend - oldest) < m_maxInFlight)
+    {
+        burst += commands[nextToSend].command;
+        burst += PIPELINE_TERMINATOR;
+        nextToSend++;
+    }
+
+    if (burst.empty())
+        return STATUS_SUCCESS;
+
+    INT32U bytesWritten = 0;
+    pUart->WritePort(reinterpret_cast<const INT8U *>(burst.data()), burst.size(), &bytesWritten);
+    RETURN_EC_IF_TRUE(ERROR_FAILED, bytesWritten != burst.size());
+
+    return STATUS_SUCCESS;
+}
+
+void CCommandPipeline::DispatchLine(vector<PipelinedCommand> &commands, size_t &oldest, size_t nextToSend, const string &line)
+{
+    if (oldest < nextToSend)
+    {
+        ERROR_CODE_T status;
+        for (size_t i = oldest; i < nextToSend; i++)
+        {
+            const string &tag = commands[i].responseTag;
+            if (!tag.empty() && line.compare(0, tag.size(), tag) == 0)
+            {
+                commands[i].response.push_back(line);
+                return;
+            }
+        }
+
+        if (IsStatusLine(line, status))
+        {
+            commands[oldest].result = status;
+            oldest++;
+            return;
+        }
+
+        // A tagged command only takes lines carrying its tag, so anything
+        // else that arrives while it is oldest came from the module unasked.
+        if (commands[oldest].responseTag.empty())
+        {
+            commands[oldest].response.push_back(line);
+            return;
+        }
+    }
+
+    m_unsolicitedCount++;
+    if (m_unsolicitedHandler)
+    {
+        m_unsolicitedHandler(line);
+    }
+}
+
+ERROR_CODE_T CCommandPipeline::Execute(vector<PipelinedCommand> &commands, INT32U timeoutMS)
+{
+    shared_ptr<IUart> pUart = m_pUart.lock();
+    RETURN_EC_IF_NULL(ERROR_NOT_INITIALIZED, pUart);
+    RETURN_EC_IF_TRUE(ERROR_INVALID_PARAMETER, timeoutMS > 0xFFFF);
+
+    for (size_t i = 0; i < commands.size(); i++)
+    {
+        commands[i].response.clear();
+        commands[i].result = STATUS_OPERATION_INCOMPLETE;
+    }
+
+    m_cancel = false;
+    m_rxPartial.clear();
+
+    size_t oldest = 0;
+    size_t nextToSend = 0;
+    CTimeDelta timeout((INT16U)timeoutMS);
+    INT8U rxBuf[PIPELINE_RX_CHUNK];
+
+    while (oldest < commands.size())
+    {
+        RETURN_IF_FAILED(WriteWindow(pUart, commands, nextToSend, oldest));
+
+        if (m_cancel || timeout.IsTimeExpired())
+        {
+            ERROR_CODE_T reason = m_cancel ? STATUS_OPERATION_INCOMPLETE : ERROR_OPERATION_TIMED_OUT;
+            for (size_t i = oldest; i < commands.size(); i++)
+            {
+                commands[i].result = reason;
+            }
+            return reason;
+        }
+
+        // ReadPort returns as soon as anything arrives (or after the driver's
+        // inter-character timeout), so there is no polling delay here.
+        INT32U bytesRead = 0;
+        pUart->ReadPort(rxBuf, sizeof(rxBuf), &bytesRead);
+
+        for (INT32U i = 0; i < bytesRead; i++)
+        {
+            CHAR8 c = (CHAR8)rxBuf[i];
+            if (c != '\r' && c != '\n')
+            {
+                m_rxPartial += c;
+                continue;
+            }
+
+            trim(m_rxPartial);
+            if (!m_rxPartial.empty())
+            {
+                DispatchLine(commands, oldest, nextToSend, m_rxPartial);
+                m_rxPartial.clear();
+            }
+        }
+    }
+
+    for (size_t i = 0; i < commands.size(); i++)
+    {
+        RETURN_IF_FAILED(commands[i].result);
+    }
+
+    return STATUS_SUCCESS;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "interfaces/iuart.h"
+#include "types.h"
+
+// A single command submitted to the pipeline. If responseTag is set, response
+// lines starting with it are routed to this command regardless of its position
+// in the pipeline (for modules that echo the command name in the reply). The
+// final OK/ERROR goes to the oldest outstanding command, and so do untagged
+// lines when that command is untagged too; any other line is unsolicited.
+struct PipelinedCommand
+{
+    PipelinedCommand(const string &cmd = "", const string &tag = "")
+        : command(cmd), responseTag(tag), result(STATUS_OPERATION_INCOMPLETE)
+    {
+    }
+
+    string command;
+    string responseTag;
+    vector<string> response;
+    ERROR_CODE_T result;
+};
+
+typedef function<void(const string &line)> UnsolicitedLineHandler;
+
+class CCommandPipeline
+{
+  public:
+    CCommandPipeline(weak_ptr<IUart> pUart, INT8U maxInFlight = 8);
+
+    // Sends the commands back-to-back, keeping up to maxInFlight outstanding,
+    // and collects each response. Returns the first failure, if any.
+    ERROR_CODE_T Execute(vector<PipelinedCommand> &commands, INT32U timeoutMS);
+
+    void SetMaxInFlight(INT8U maxInFlight);
+    INT8U GetMaxInFlight(void);
+
+    void SetCancelCurrentCommand(bool cancel);
+    bool GetCancelCurrentCommand(void);
+
+    // Receives lines that belong to no outstanding command, e.g. connection
+    // events the module reports on its own.
+    void SetUnsolicitedHandler(UnsolicitedLineHandler handler);
+    INT32U GetUnsolicitedCount(void);
+
+  private:
+    ERROR_CODE_T WriteWindow(shared_ptr<IUart> pUart, vector<PipelinedCommand> &commands, size_t &nextToSend, size_t oldest);
+    void DispatchLine(vector<PipelinedCommand> &commands, size_t &oldest, size_t nextToSend, const string &line);
+
+    weak_ptr<IUart> m_pUart;
+    INT8U m_maxInFlight;
+    atomic<bool> m_cancel;
+    string m_rxPartial;
+    UnsolicitedLineHandler m_unsolicitedHandler;
+    INT32U m_unsolicitedCount;
+};
@@ -0,0 +1,240 @@
+#include "CommandSchedule.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+static uint64_t Gcd(uint64_t a, uint64_t b)
+{
+    while (b != 0)
+    {
+        uint64_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+static bool ParseNumber(const string &text, INT32U &valueOut)
+{
+    if (text.empty())
+        return false;
+
+    CHAR8 *pEnd = NULL;
+    unsigned long value = strtoul(text.c_str(), &pEnd, 10);
+    if (*pEnd != '\0' || value > 0xFFFFFFFFUL)
+        return false;
+
+    valueOut = (INT32U)value;
+    return true;
+}
+
+CCommandSchedule::CCommandSchedule() : m_cycleMS(0)
+{
+}
+
+ERROR_CODE_T CCommandSchedule::ParseLine(const string &line, INT32U lineNumber)
+{
+    string text = line.substr(0, line.find('#'));
+    istringstream stream(text);
+    vector<string> tokens;
+    string token;
+    while (stream >> token)
+    {
+        tokens.push_back(token);
+    }
+    if (tokens.empty())
+        return STATUS_SUCCESS;
+
+    ScheduledCommand command;
+    command.arg = 0;
+    command.offsetMS = 0;
+
+    size_t next = 2;
+    bool valid = tokens.size() >= 3 && tokens[0] == "every" && ParseNumber(tokens[1], command.periodMS) &&
+                 command.periodMS != 0;
+    if (valid && tokens[next][0] == '+')
+    {
+        valid = ParseNumber(tokens[next].substr(1), command.offsetMS) && command.offsetMS < command.periodMS;
+        next++;
+    }
+    valid = valid && next < tokens.size();
+    if (valid)
+    {
+        command.name = tokens[next++];
+    }
+    if (valid && next < tokens.size())
+    {
+        valid = ParseNumber(tokens[next++], command.arg);
+    }
+    valid = valid && next == tokens.size();
+
+    if (!valid)
+    {
+        LogPrintf(DEBUG_NORMAL_ERROR, "schedule", "Invalid script line %u: %s\n", lineNumber, line.c_str());
+        return ERROR_INVALID_CONFIGURATION;
+    }
+
+    m_commands.push_back(command);
+    return STATUS_SUCCESS;
+}
+
+ERROR_CODE_T CCommandSchedule::Compile(const string &scriptText)
+{
+    m_commands.clear();
+    m_batches.clear();
+    m_cycleMS = 0;
+
+    istringstream stream(scriptText);
+    string line;
+    INT32U lineNumber = 0;
+    while (getline(stream, line))
+    {
+        RETURN_IF_FAILED(ParseLine(line, ++lineNumber));
+    }
+    RETURN_EC_IF_TRUE(ERROR_INVALID_CONFIGURATION, m_commands.empty());
+
+    return BuildBatches();
+}
+
+ERROR_CODE_T CCommandSchedule::LoadFile(const string &path)
+{
+    ifstream file(path.c_str());
+    RETURN_EC_IF_FALSE(ERROR_FAILED, file.is_open());
+
+    stringstream contents;
+    contents << file.rdbuf();
+    return Compile(contents.str());
+}
+
+ERROR_CODE_T CCommandSchedule::BuildBatches(void)
+{
+    uint64_t cycleMS = 1;
+    for (size_t i = 0; i < m_commands.size(); i++)
+    {
+        cycleMS = cycleMS / Gcd(cycleMS, m_commands[i].periodMS) * m_commands[i].periodMS;
+        RETURN_EC_IF_TRUE(ERROR_INVALID_CONFIGURATION, cycleMS > COMMAND_SCHEDULE_MAX_CYCLE_MS);
+    }
+
+    // Every firing within one cycle, grouped by offset. Commands keep script
+    // order within a batch.
+    map<INT32U, vector<INT16U> > firings;
+    INT32U count = 0;
+    for (size_t i = 0; i < m_commands.size(); i++)
+    {
+        for (uint64_t t = m_commands[i].offsetMS; t < cycleMS; t += m_commands[i].periodMS)
+        {
+            RETURN_EC_IF_TRUE(ERROR_INVALID_CONFIGURATION, ++count > COMMAND_SCHEDULE_MAX_BATCHES);
+            firings[(INT32U)t].push_back((INT16U)i);
+        }
+    }
+
+    map<INT32U, vector<INT16U> >::iterator iter;
+    for (iter = firings.begin(); iter != firings.end(); ++iter)
+    {
+        CommandBatch batch;
+        batch.offsetMS = iter->first;
+        batch.commands.swap(iter->second);
+        sort(batch.commands.begin(), batch.commands.end());
+        m_batches.push_back(batch);
+    }
+
+    m_cycleMS = (INT32U)cycleMS;
+    return STATUS_SUCCESS;
+}
+
+INT32U CCommandSchedule::GetCommandCount(void) const
+{
+    return (INT32U)m_commands.size();
+}
+
+const ScheduledCommand &CCommandSchedule::GetCommand(INT32U index) const
+{
+    return m_commands[index];
+}
+
+INT32U CCommandSchedule::GetBatchCount(void) const
+{
+    return (INT32U)m_batches.size();
+}
+
+const CommandBatch &CCommandSchedule::GetBatch(INT32U index) const
+{
+    return m_batches[index];
+}
+
+INT32U CCommandSchedule::GetCycleMS(void) const
+{
+    return m_cycleMS;
+}
+
+CCommandSequencer::CCommandSequencer() : m_pSchedule(NULL), m_cycleStartMS(0), m_batchIndex(0)
+{
+}
+
+void CCommandSequencer::Start(const CCommandSchedule *pSchedule, uint64_t nowMS)
+{
+    m_pSchedule = pSchedule;
+    m_cycleStartMS = nowMS;
+    m_batchIndex = 0;
+}
+
+bool CCommandSequencer::IsStarted(void) const
+{
+    return m_pSchedule != NULL && m_pSchedule->GetBatchCount() != 0;
+}
+
+uint64_t CCommandSequencer::GetDueTime(void) const
+{
+    return m_cycleStartMS + m_pSchedule->GetBatch(m_batchIndex).offsetMS;
+}
+
+const CommandBatch *CCommandSequencer::GetDueBatch(uint64_t nowMS, INT32U &delayMSOut)
+{
+    delayMSOut = 0;
+    if (!IsStarted())
+        return NULL;
+
+    INT32U cycleMS = m_pSchedule->GetCycleMS();
+    if (nowMS >= m_cycleStartMS + 2 * (uint64_t)cycleMS)
+    {
+        // Resynchronize on the cycle boundary just behind now.
+        m_cycleStartMS += (nowMS - m_cycleStartMS) / cycleMS * cycleMS;
+        m_batchIndex = 0;
+        while (m_batchIndex + 1 < m_pSchedule->GetBatchCount() &&
+               m_cycleStartMS + m_pSchedule->GetBatch(m_batchIndex + 1).offsetMS <= nowMS)
+        {
+            m_batchIndex++;
+        }
+    }
+
+    uint64_t dueMS = GetDueTime();
+    if (dueMS > nowMS)
+    {
+        delayMSOut = (INT32U)(dueMS - nowMS);
+        return NULL;
+    }
+
+    const CommandBatch *pBatch = &m_pSchedule->GetBatch(m_batchIndex);
+    if (++m_batchIndex == m_pSchedule->GetBatchCount())
+    {
+        m_batchIndex = 0;
+        m_cycleStartMS += cycleMS;
+    }
+
+    delayMSOut = GetDelayMS(nowMS);
+    return pBatch;
+}
+
+INT32U CCommandSequencer::GetDelayMS(uint64_t nowMS) const
+{
+    if (!IsStarted())
+        return 0;
+
+    uint64_t dueMS = GetDueTime();
+    return (dueMS > nowMS) ? (INT32U)(dueMS - nowMS) : 0;
+}
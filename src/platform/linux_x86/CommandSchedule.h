@@ -0,0 +1,86 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "types.h"
+
+using namespace std;
+
+// Longest cycle a script may compile to; keeps the batch table small.
+#define COMMAND_SCHEDULE_MAX_CYCLE_MS 3600000
+#define COMMAND_SCHEDULE_MAX_BATCHES 65536
+
+struct ScheduledCommand
+{
+    string name;
+    INT32U arg;
+    INT32U periodMS;
+    INT32U offsetMS;
+};
+
+// Commands due at the same instant, in script order.
+struct CommandBatch
+{
+    INT32U offsetMS;
+    vector<INT16U> commands;
+};
+
+// A periodic command script compiled once into the batches of one cycle,
+// so running it is a table walk rather than per-command timer checks.
+// Script lines look like
+//
+//     every <periodMS> [+<offsetMS>] <command> [<arg>]
+//
+// with '#' starting a comment. The cycle is the least common multiple of the
+// periods.
+class CCommandSchedule
+{
+  public:
+    CCommandSchedule();
+
+    ERROR_CODE_T Compile(const string &scriptText);
+    ERROR_CODE_T LoadFile(const string &path);
+
+    INT32U GetCommandCount(void) const;
+    const ScheduledCommand &GetCommand(INT32U index) const;
+    INT32U GetBatchCount(void) const;
+    const CommandBatch &GetBatch(INT32U index) const;
+    INT32U GetCycleMS(void) const;
+
+  private:
+    ERROR_CODE_T ParseLine(const string &line, INT32U lineNumber);
+    ERROR_CODE_T BuildBatches(void);
+
+    vector<ScheduledCommand> m_commands;
+    vector<CommandBatch> m_batches;
+    INT32U m_cycleMS;
+};
+
+// Walks a compiled schedule against absolute time. Due times are computed
+// from the cycle start rather than from when the last batch ran, so timing
+// doesn't drift however late individual batches run.
+class CCommandSequencer
+{
+  public:
+    CCommandSequencer();
+
+    void Start(const CCommandSchedule *pSchedule, uint64_t nowMS);
+    bool IsStarted(void) const;
+
+    // Returns the batch that is due, or NULL if none is. Either way
+    // delayMSOut is set to the time until the next batch is due. A sequencer
+    // that has fallen more than a cycle behind skips ahead instead of
+    // replaying the backlog.
+    const CommandBatch *GetDueBatch(uint64_t nowMS, INT32U &delayMSOut);
+
+    // Time until the next batch is due, 0 if it already is.
+    INT32U GetDelayMS(uint64_t nowMS) const;
+
+  private:
+    uint64_t GetDueTime(void) const;
+
+    const CCommandSchedule *m_pSchedule;
+    uint64_t m_cycleStartMS;
+    INT32U m_batchIndex;
+};
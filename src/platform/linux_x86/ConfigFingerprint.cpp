@@ -0,0 +1,86 @@
+#include "ConfigFingerprint.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#define FNV1A_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV1A_PRIME 0x100000001b3ULL
+
+CConfigFingerprint::CConfigFingerprint()
+    : m_hash(FNV1A_OFFSET_BASIS)
+{
+}
+
+void CConfigFingerprint::HashBytes(const CHAR8 *pData, size_t length)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        m_hash ^= (INT8U)pData[i];
+        m_hash *= FNV1A_PRIME;
+    }
+}
+
+void CConfigFingerprint::Add(const string &key, const string &value)
+{
+    // Hash the terminators too so ("ab","c") and ("a","bc") differ.
+    HashBytes(key.c_str(), key.size() + 1);
+    HashBytes(value.c_str(), value.size() + 1);
+}
+
+uint64_t CConfigFingerprint::GetValue(void)
+{
+    return m_hash;
+}
+
+ERROR_CODE_T CConfigFingerprint::Load(const string &path, uint64_t &valueOut)
+{
+    FILE *pFile = fopen(path.c_str(), "r");
+    if (pFile == NULL)
+        return ERROR_FAILED;
+
+    int fieldsRead = fscanf(pFile, "%" SCNx64, &valueOut);
+    fclose(pFile);
+
+    RETURN_EC_IF_TRUE(ERROR_INVALID_CONFIGURATION, fieldsRead != 1);
+    return STATUS_SUCCESS;
+}
+
+ERROR_CODE_T CConfigFingerprint::Store(const string &path)
+{
+    // Write to a temporary file and rename it into place so a crash can never
+    // leave a truncated fingerprint behind.
+    string tmpPath = path + ".tmp";
+    FILE *pFile = fopen(tmpPath.c_str(), "w");
+    if (pFile == NULL)
+    {
+        LogPrintf(DEBUG_NORMAL_ERROR, "config", "Failed to write config fingerprint %s: %s\n", tmpPath.c_str(), strerror(errno));
+        return ERROR_FAILED;
+    }
+
+    fprintf(pFile, "%016" PRIx64 "\n", m_hash);
+    fflush(pFile);
+    fsync(fileno(pFile));
+    fclose(pFile);
+
+    RETURN_EC_IF_TRUE(ERROR_FAILED, rename(tmpPath.c_str(), path.c_str()) != 0);
+    return STATUS_SUCCESS;
+}
+
+ERROR_CODE_T CConfigFingerprint::Remove(const string &path)
+{
+    if (unlink(path.c_str()) != 0 && errno != ENOENT)
+        return ERROR_FAILED;
+
+    return STATUS_SUCCESS;
+}
+
+bool CConfigFingerprint::MatchesStored(const string &path)
+{
+    uint64_t storedValue;
+    if (FAILED(Load(path, storedValue)))
+        return false;
+
+    return storedValue == m_hash;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+
+#include "types.h"
+
+// A 64-bit FNV-1a hash over the key/value pairs that describe an applied
+// configuration. It is persisted per card so startup can tell whether the
+// module still holds what was last written to it.
+class CConfigFingerprint
+{
+  public:
+    CConfigFingerprint();
+
+    void Add(const string &key, const string &value);
+    uint64_t GetValue(void);
+
+    ERROR_CODE_T Load(const string &path, uint64_t &valueOut);
+    ERROR_CODE_T Store(const string &path);
+    ERROR_CODE_T Remove(const string &path);
+    bool MatchesStored(const string &path);
+
+  private:
+    void HashBytes(const CHAR8 *pData, size_t length);
+
+    uint64_t m_hash;
+};
@@ -0,0 +1,72 @@
+#include "ConfigShadow.h"
+
+#include <algorithm>
+
+#include "ExtIO.h"
+
+CConfigShadow::CConfigShadow(shared_ptr<CCommandPipeline> pPipeline)
+    : m_pPipeline(pPipeline), m_populated(false)
+{
+}
+
+ERROR_CODE_T CConfigShadow::Populate(const vector<string> &cfgOptions, INT32U timeoutMS)
+{
+    RETURN_EC_IF_NULL(ERROR_NOT_INITIALIZED, m_pPipeline);
+
+    vector<PipelinedCommand> commands;
+    commands.reserve(cfgOptions.size());
+    for (size_t i = 0; i < cfgOptions.size(); i++)
+    {
+        // Tag with the '=' so "NAME" doesn't also claim "NAME_SHORT=...".
+        commands.push_back(PipelinedCommand("GET " + cfgOptions[i], cfgOptions[i] + "="));
+    }
+
+    ERROR_CODE_T result = m_pPipeline->Execute(commands, timeoutMS);
+
+    CSimpleLock myLock(&m_cs);
+    m_values.clear();
+    for (size_t i = 0; i < commands.size(); i++)
+    {
+        const string &option = cfgOptions[i];
+        if (FAILED(commands[i].result))
+        {
+            LogPrintf(DEBUG_NORMAL_ERROR, "cfgshadow", "Could not read %s\r\n", option.c_str());
+            continue;
+        }
+
+        // The module answers "OPTION=value"; strip the echoed name.
+        string value = commands[i].response.empty() ? "" : commands[i].response.front();
+        value.erase(0, min(value.size(), option.size() + 1));
+
+        m_values[option] = trim(value);
+    }
+
+    RETURN_EC_IF_TRUE(result, m_values.empty() && !cfgOptions.empty());
+    m_populated = true;
+
+    return STATUS_SUCCESS;
+}
+
+bool CConfigShadow::IsPopulated(void)
+{
+    return m_populated;
+}
+
+void CConfigShadow::Invalidate(void)
+{
+    CSimpleLock myLock(&m_cs);
+    m_values.clear();
+    m_populated = false;
+}
+
+ERROR_CODE_T CConfigShadow::GetCfgValue(string &outString, const string cfgOption)
+{
+    CSimpleLock myLock(&m_cs);
+    RETURN_EC_IF_FALSE(ERROR_NOT_INITIALIZED, m_populated);
+
+    map<string, string>::iterator iter = m_values.find(cfgOption);
+    RETURN_EC_IF_TRUE(ERROR_INVALID_PARAMETER, iter == m_values.end());
+
+    outString = iter->second;
+    return STATUS_SUCCESS;
+}
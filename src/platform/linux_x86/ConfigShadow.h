@@ -0,0 +1,32 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "CommandPipeline.h"
+#include "CriticalSection.h"
+#include "types.h"
+
+// In-memory copy of the module configuration. The shadow is populated once
+// with a single pipelined burst of GETs and serves reads from memory.
+// Options the module wouldn't read back are left out rather than failing
+// the rest.
+class CConfigShadow
+{
+  public:
+    CConfigShadow(shared_ptr<CCommandPipeline> pPipeline);
+
+    // Fails only if none of the options could be read.
+    ERROR_CODE_T Populate(const vector<string> &cfgOptions, INT32U timeoutMS);
+    bool IsPopulated(void);
+    void Invalidate(void);
+
+    ERROR_CODE_T GetCfgValue(string &outString, const string cfgOption);
+
+  private:
+    shared_ptr<CCommandPipeline> m_pPipeline;
+    CCriticalSection m_cs;
+    map<string, string> m_values;
+    bool m_populated;
+};
@@ -41,7 +41,7 @@ INT8U CCriticalSection::Lock(INT16U timeout, BOOLEAN logTaskInfo, CHAR8 *pIDStri
 
         if (m_taskLogging && logTaskInfo && pIDString)
         {
-            printf("Locked by [%s] on CS [%s]\n", pIDString, m_csName);
+            LogPrintf(DEBUG_TRACE_INFO, m_csName, "Locked by [%s] on CS [%s]\n", pIDString, m_csName);
         }
 
         return 0;
@@ -70,7 +70,7 @@ INT8U CCriticalSection::Unlock(BOOLEAN logTaskInfo, CHAR8 *pIDString)
 
     if (m_taskLogging && logTaskInfo && pIDString)
     {
-        printf("Unlocked by [%s] on CS [%s]\n", pIDString, m_csName);
+        LogPrintf(DEBUG_TRACE_INFO, m_csName, "Unlocked by [%s] on CS [%s]\n", pIDString, m_csName);
     }
 
     return 0;
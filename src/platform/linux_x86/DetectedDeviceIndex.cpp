@@ -0,0 +1,196 @@
+#include "DetectedDeviceIndex.h"
+
+#include <string.h>
+
+#define INVALID_SLOT 0xFFFFFFFF
+
+CDetectedDeviceIndex::CDetectedDeviceIndex(INT32U initialCapacity) : m_mask(0), m_size(0)
+{
+    INT32U capacity = 8;
+    while (capacity < initialCapacity)
+    {
+        capacity <<= 1;
+    }
+
+    DetectedDeviceEntry empty;
+    memset(&empty, 0, sizeof(empty));
+    m_entries.assign(capacity, empty);
+    m_mask = capacity - 1;
+}
+
+INT32U CDetectedDeviceIndex::GetHomeSlot(uint64_t address) const
+{
+    // Vendor prefixes repeat across nearby devices, so mix every bit before
+    // taking the low ones.
+    uint64_t hash = address * 0x9E3779B97F4A7C15ULL;
+    return (INT32U)(hash >> 32) & m_mask;
+}
+
+INT32U CDetectedDeviceIndex::FindSlot(uint64_t address) const
+{
+    for (INT32U slot = GetHomeSlot(address);; slot = (slot + 1) & m_mask)
+    {
+        if (m_entries[slot].address == address)
+            return slot;
+        if (m_entries[slot].address == 0)
+            return INVALID_SLOT;
+    }
+}
+
+ERROR_CODE_T CDetectedDeviceIndex::Upsert(uint64_t address, const CHAR8 *pName, INT32U nowMS, INT32U generation,
+                                          bool *pIsNew)
+{
+    address &= BT_ADDRESS_MASK;
+    RETURN_EC_IF_TRUE(ERROR_INVALID_PARAMETER, address == 0);
+
+    // Keep the load factor at or below 3/4 so probe runs stay short.
+    if ((m_size + 1) * 4 > (m_mask + 1) * 3)
+    {
+        Grow();
+    }
+
+    INT32U slot = GetHomeSlot(address);
+    while (m_entries[slot].address != 0 && m_entries[slot].address != address)
+    {
+        slot = (slot + 1) & m_mask;
+    }
+
+    DetectedDeviceEntry &entry = m_entries[slot];
+    bool isNew = (entry.address == 0) || (entry.generation != generation);
+    if (entry.address == 0)
+    {
+        entry.address = address;
+        m_size++;
+    }
+
+    entry.lastSeenMS = nowMS;
+    entry.generation = generation;
+    if (pName != NULL)
+    {
+        strncpy(entry.name, pName, DETECTED_DEVICE_NAME_SIZE - 1);
+        entry.name[DETECTED_DEVICE_NAME_SIZE - 1] = '\0';
+    }
+
+    if (pIsNew != NULL)
+    {
+        *pIsNew = isNew;
+    }
+    return STATUS_SUCCESS;
+}
+
+const DetectedDeviceEntry *CDetectedDeviceIndex::Find(uint64_t address) const
+{
+    address &= BT_ADDRESS_MASK;
+    if (address == 0)
+        return NULL;
+
+    INT32U slot = FindSlot(address);
+    return (slot == INVALID_SLOT) ? NULL : &m_entries[slot];
+}
+
+bool CDetectedDeviceIndex::Remove(uint64_t address)
+{
+    address &= BT_ADDRESS_MASK;
+    if (address == 0)
+        return false;
+
+    INT32U slot = FindSlot(address);
+    if (slot == INVALID_SLOT)
+        return false;
+
+    RemoveSlot(slot);
+    return true;
+}
+
+// Backward-shift deletion: pull later members of the probe run into the hole
+// so lookups never need tombstones.
+void CDetectedDeviceIndex::RemoveSlot(INT32U slot)
+{
+    INT32U hole = slot;
+    for (INT32U next = (hole + 1) & m_mask; m_entries[next].address != 0; next = (next + 1) & m_mask)
+    {
+        INT32U home = GetHomeSlot(m_entries[next].address);
+        // The entry may move back only if its home slot isn't between the
+        // hole and its current position.
+        if (((next - home) & m_mask) >= ((next - hole) & m_mask))
+        {
+            m_entries[hole] = m_entries[next];
+            hole = next;
+        }
+    }
+
+    memset(&m_entries[hole], 0, sizeof(DetectedDeviceEntry));
+    m_size--;
+}
+
+INT32U CDetectedDeviceIndex::AgeOut(INT32U nowMS, INT32U maxAgeMS)
+{
+    INT32U removed = 0;
+    INT32U slot = 0;
+    while (slot <= m_mask)
+    {
+        if (m_entries[slot].address != 0 && (INT32U)(nowMS - m_entries[slot].lastSeenMS) > maxAgeMS)
+        {
+            // The shift may pull an unchecked entry into this slot, so look
+            // at it again before moving on.
+            RemoveSlot(slot);
+            removed++;
+            continue;
+        }
+        slot++;
+    }
+
+    return removed;
+}
+
+INT32U CDetectedDeviceIndex::GetSize(void) const
+{
+    return m_size;
+}
+
+void CDetectedDeviceIndex::Clear(void)
+{
+    DetectedDeviceEntry empty;
+    memset(&empty, 0, sizeof(empty));
+    m_entries.assign(m_entries.size(), empty);
+    m_size = 0;
+}
+
+const DetectedDeviceEntry *CDetectedDeviceIndex::GetNext(INT32U *pCursor) const
+{
+    if (pCursor == NULL)
+        return NULL;
+
+    while (*pCursor <= m_mask)
+    {
+        const DetectedDeviceEntry *pEntry = &m_entries[(*pCursor)++];
+        if (pEntry->address != 0)
+            return pEntry;
+    }
+
+    return NULL;
+}
+
+void CDetectedDeviceIndex::Grow(void)
+{
+    vector<DetectedDeviceEntry> oldEntries;
+    oldEntries.swap(m_entries);
+
+    DetectedDeviceEntry empty;
+    memset(&empty, 0, sizeof(empty));
+    m_entries.assign(oldEntries.size() * 2, empty);
+    m_mask = (INT32U)m_entries.size() - 1;
+
+    for (size_t i = 0; i < oldEntries.size(); i++)
+    {
+        if (oldEntries[i].address == 0)
+            continue;
+
+        INT32U slot = GetHomeSlot(oldEntries[i].address);
+        while (m_entries[slot].address != 0)
+        {
+            slot = (slot + 1) & m_mask;
+        }
+        m_entries[slot] = oldEntries[i];
+    }
+}
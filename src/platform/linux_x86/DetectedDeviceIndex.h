@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vector>
+
+#include "BtAddress.h"
+#include "types.h"
+
+using namespace std;
+
+// Long enough for the names the module reports in inquiry results; longer
+// names are truncated.
+#define DETECTED_DEVICE_NAME_SIZE 64
+
+struct DetectedDeviceEntry
+{
+    // Packed address; 0 marks an empty slot, which the module never reports.
+    uint64_t address;
+    INT32U lastSeenMS;
+    INT32U generation;
+    CHAR8 name[DETECTED_DEVICE_NAME_SIZE];
+};
+
+// Detected devices keyed by packed Bluetooth address. Open addressing with
+// linear probing over a power-of-two table keeps every entry in one flat
+// allocation, so repeated inquiry results dedupe in place instead of growing
+// a list, and lookups never compare strings.
+class CDetectedDeviceIndex
+{
+  public:
+    CDetectedDeviceIndex(INT32U initialCapacity = 64);
+
+    // Inserts the device or refreshes its name, last-seen time and
+    // generation. pIsNew is set when the address wasn't in the index or was
+    // last seen in a different generation.
+    ERROR_CODE_T Upsert(uint64_t address, const CHAR8 *pName, INT32U nowMS, INT32U generation, bool *pIsNew = NULL);
+
+    // Returns NULL if the address isn't indexed. The pointer is invalidated
+    // by the next Upsert, Remove, AgeOut or Clear.
+    const DetectedDeviceEntry *Find(uint64_t address) const;
+
+    bool Remove(uint64_t address);
+
+    // Drops every entry not seen within maxAgeMS of nowMS and returns how
+    // many were removed.
+    INT32U AgeOut(INT32U nowMS, INT32U maxAgeMS);
+
+    INT32U GetSize(void) const;
+    void Clear(void);
+
+    // Walks occupied slots; start with *pCursor = 0. Returns NULL when done.
+    const DetectedDeviceEntry *GetNext(INT32U *pCursor) const;
+
+  private:
+    INT32U GetHomeSlot(uint64_t address) const;
+    INT32U FindSlot(uint64_t address) const;
+    void RemoveSlot(INT32U slot);
+    void Grow(void);
+
+    vector<DetectedDeviceEntry> m_entries;
+    INT32U m_mask;
+    INT32U m_size;
+};
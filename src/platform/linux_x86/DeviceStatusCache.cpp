@@ -0,0 +1,87 @@
+#include "DeviceStatusCache.h"
+
+#include "ClockSource.h"
+
+CDeviceStatusCache::CDeviceStatusCache(DeviceStatusFetch fetch, INT32U ttlMS)
+    : m_fetch(fetch), m_ttlUs((uint64_t)ttlMS * 1000), m_fetchCount(0), m_hitCount(0)
+{
+    for (INT32U i = 0; i < DEVICE_STATUS_FIELD_COUNT; i++)
+    {
+        m_fields[i].valid = false;
+        m_fields[i].value = false;
+        m_fields[i].fetchedAtUs = 0;
+    }
+}
+
+void CDeviceStatusCache::SetTtlMS(INT32U ttlMS)
+{
+    m_ttlUs = (uint64_t)ttlMS * 1000;
+}
+
+ERROR_CODE_T CDeviceStatusCache::GetField(DeviceStatusField_t field, bool &valueOut)
+{
+    RETURN_EC_IF_TRUE(ERROR_INVALID_PARAMETER, field >= DEVICE_STATUS_FIELD_COUNT);
+
+    CachedField &cached = m_fields[field];
+    uint64_t nowUs = GetClockSource().GetNowUs();
+    if (cached.valid && nowUs - cached.fetchedAtUs < m_ttlUs)
+    {
+        m_hitCount++;
+        valueOut = cached.value;
+        return STATUS_SUCCESS;
+    }
+
+    RETURN_EC_IF_FALSE(ERROR_NOT_INITIALIZED, m_fetch);
+
+    m_fetchCount++;
+    bool value = false;
+    ERROR_CODE_T result = m_fetch(field, value);
+    if (FAILED(result))
+    {
+        // Don't serve the old value as if it were still current.
+        cached.valid = false;
+        return result;
+    }
+
+    cached.value = value;
+    cached.fetchedAtUs = nowUs;
+    cached.valid = true;
+    valueOut = value;
+    return STATUS_SUCCESS;
+}
+
+bool CDeviceStatusCache::IsReady(void)
+{
+    bool ready;
+    return SUCCEEDED(GetField(DEVICE_STATUS_READY, ready)) && ready;
+}
+
+bool CDeviceStatusCache::IsConnected(void)
+{
+    bool connected;
+    return SUCCEEDED(GetField(DEVICE_STATUS_CONNECTED, connected)) && connected;
+}
+
+bool CDeviceStatusCache::IsPaired(void)
+{
+    bool paired;
+    return SUCCEEDED(GetField(DEVICE_STATUS_PAIRED, paired)) && paired;
+}
+
+void CDeviceStatusCache::Invalidate(void)
+{
+    for (INT32U i = 0; i < DEVICE_STATUS_FIELD_COUNT; i++)
+    {
+        m_fields[i].valid = false;
+    }
+}
+
+uint64_t CDeviceStatusCache::GetFetchCount(void) const
+{
+    return m_fetchCount;
+}
+
+uint64_t CDeviceStatusCache::GetHitCount(void) const
+{
+    return m_hitCount;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <functional>
+
+#include "types.h"
+
+using namespace std;
+
+#define DEVICE_STATUS_DEFAULT_TTL_MS 500
+
+typedef enum
+{
+    DEVICE_STATUS_READY = 0,
+    DEVICE_STATUS_CONNECTED = 1,
+    DEVICE_STATUS_PAIRED = 2,
+    DEVICE_STATUS_FIELD_COUNT = 3,
+} DeviceStatusField_t;
+
+// Reads one piece of link state; the driver has a separate query for each.
+typedef function<ERROR_CODE_T(DeviceStatusField_t field, bool &valueOut)> DeviceStatusFetch;
+
+// Caches the module's link state so per-tick checks don't each cost a
+// serial round-trip. Each field is cached on its own, so a check only ever
+// pays for the query it needs: with a TTL of 0 that is one query per check,
+// as without the cache. A value is reused until it is older than the TTL or
+// something that changes the link invalidates it. Not thread-safe; owned by
+// whatever serializes access to the device.
+class CDeviceStatusCache
+{
+  public:
+    CDeviceStatusCache(DeviceStatusFetch fetch, INT32U ttlMS = DEVICE_STATUS_DEFAULT_TTL_MS);
+
+    void SetTtlMS(INT32U ttlMS);
+
+    // Queries the field first if its cached value is stale or invalidated.
+    ERROR_CODE_T GetField(DeviceStatusField_t field, bool &valueOut);
+    // False whenever the status can't be read.
+    bool IsReady(void);
+    bool IsConnected(void);
+    bool IsPaired(void);
+
+    // Call on connect/disconnect and after commands that change the link.
+    void Invalidate(void);
+
+    // Queries sent to the module, and checks answered from the cache.
+    uint64_t GetFetchCount(void) const;
+    uint64_t GetHitCount(void) const;
+
+  private:
+    struct CachedField
+    {
+        bool valid;
+        bool value;
+        uint64_t fetchedAtUs;
+    };
+
+    DeviceStatusFetch m_fetch;
+    uint64_t m_ttlUs;
+    CachedField m_fields[DEVICE_STATUS_FIELD_COUNT];
+    uint64_t m_fetchCount;
+    uint64_t m_hitCount;
+};
@@ -0,0 +1,509 @@
+#include "EventSocketServer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define EVENT_POLL_MS 100
+
+static void PutU8(vector<INT8U> &buffer, INT8U value)
+{
+    buffer.push_back(value);
+}
+
+static void PutU32(vector<INT8U> &buffer, INT32U value)
+{
+    for (INT32U i = 0; i < 4; i++)
+    {
+        buffer.push_back((INT8U)(value >> (8 * i)));
+    }
+}
+
+static void PutU64(vector<INT8U> &buffer, uint64_t value)
+{
+    for (INT32U i = 0; i < 8; i++)
+    {
+        buffer.push_back((INT8U)(value >> (8 * i)));
+    }
+}
+
+static INT32U GetU32(const INT8U *pData)
+{
+    return (INT32U)pData[0] | ((INT32U)pData[1] << 8) | ((INT32U)pData[2] << 16) | ((INT32U)pData[3] << 24);
+}
+
+// Starts a frame and returns where its length goes.
+static size_t BeginFrame(vector<INT8U> &buffer, INT8U type)
+{
+    size_t start = buffer.size();
+    PutU32(buffer, 0);
+    PutU8(buffer, type);
+    return start;
+}
+
+static void EndFrame(vector<INT8U> &buffer, size_t start)
+{
+    INT32U length = (INT32U)(buffer.size() - start - EVENT_FRAME_HEADER_SIZE);
+    for (INT32U i = 0; i < 4; i++)
+    {
+        buffer[start + i] = (INT8U)(length >> (8 * i));
+    }
+}
+
+CEventSocketServer::CEventSocketServer()
+    : m_listenFd(-1), m_running(false), m_wakePending(false), m_nextClientId(1), m_clientCount(0),
+      m_droppedCount(0)
+{
+    m_wakePipe[0] = -1;
+    m_wakePipe[1] = -1;
+}
+
+CEventSocketServer::~CEventSocketServer()
+{
+    Stop();
+}
+
+ERROR_CODE_T CEventSocketServer::Start(const string &socketPath)
+{
+    RETURN_EC_IF_TRUE(ERROR_FAILED, m_running);
+
+    struct sockaddr_un address;
+    RETURN_EC_IF_TRUE(ERROR_INVALID_PARAMETER, socketPath.size() >= sizeof(address.sun_path));
+    RETURN_EC_IF_TRUE(ERROR_FAILED, pipe(m_wakePipe) != 0);
+    fcntl(m_wakePipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(m_wakePipe[1], F_SETFL, O_NONBLOCK);
+
+    m_listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (m_listenFd < 0)
+    {
+        Stop();
+        return ERROR_FAILED;
+    }
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+
+    unlink(socketPath.c_str());
+    if (bind(m_listenFd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(m_listenFd, 8) != 0)
+    {
+        LogPrintf(DEBUG_NORMAL_ERROR, "events", "Failed to listen on %s: %s\n", socketPath.c_str(), strerror(errno));
+        Stop();
+        return ERROR_FAILED;
+    }
+
+    m_socketPath = socketPath;
+    m_running = true;
+    m_thread = thread(&CEventSocketServer::ThreadMain, this);
+    return STATUS_SUCCESS;
+}
+
+void CEventSocketServer::Stop(void)
+{
+    if (m_running.exchange(false))
+    {
+        Wake();
+        if (m_thread.joinable())
+        {
+            m_thread.join();
+        }
+        unlink(m_socketPath.c_str());
+    }
+
+    map<INT32U, Client>::iterator iter;
+    for (iter = m_clients.begin(); iter != m_clients.end(); ++iter)
+    {
+        CloseClient(iter->second);
+    }
+    m_clients.clear();
+    m_clientCount = 0;
+    for (size_t i = 0; i < m_pendingClients.size(); i++)
+    {
+        close(m_pendingClients[i]);
+    }
+    m_pendingClients.clear();
+
+    if (m_listenFd >= 0)
+    {
+        close(m_listenFd);
+        m_listenFd = -1;
+    }
+    for (INT32U i = 0; i < 2; i++)
+    {
+        if (m_wakePipe[i] >= 0)
+        {
+            close(m_wakePipe[i]);
+            m_wakePipe[i] = -1;
+        }
+    }
+}
+
+ERROR_CODE_T CEventSocketServer::AttachClient(int fd)
+{
+    RETURN_EC_IF_TRUE(ERROR_INVALID_PARAMETER, fd < 0);
+    if (!m_running)
+    {
+        close(fd);
+        return ERROR_NOT_INITIALIZED;
+    }
+
+    {
+        lock_guard<mutex> guard(m_lock);
+        m_pendingClients.push_back(fd);
+    }
+    Wake();
+    return STATUS_SUCCESS;
+}
+
+void CEventSocketServer::SetCommandHandler(SocketCommandHandler handler)
+{
+    lock_guard<mutex> guard(m_lock);
+    m_commandHandler = handler;
+}
+
+void CEventSocketServer::Publish(const SocketEvent &event)
+{
+    if (!m_running || m_clientCount == 0)
+        return;
+
+    bool wake;
+    {
+        lock_guard<mutex> guard(m_lock);
+        m_pendingEvents.push_back(event);
+        wake = !m_wakePending;
+        m_wakePending = true;
+    }
+
+    // One wakeup covers everything published until the server thread runs,
+    // which is what batches delivery.
+    if (wake)
+    {
+        Wake();
+    }
+}
+
+INT32U CEventSocketServer::GetClientCount(void) const
+{
+    return m_clientCount;
+}
+
+INT32U CEventSocketServer::GetDroppedCount(void) const
+{
+    return m_droppedCount;
+}
+
+void CEventSocketServer::Wake(void)
+{
+    if (m_wakePipe[1] >= 0)
+    {
+        INT8U byte = 0;
+        ssize_t ignored = write(m_wakePipe[1], &byte, 1);
+        (void)ignored;
+    }
+}
+
+void CEventSocketServer::CloseClient(Client &client)
+{
+    if (client.fd >= 0)
+    {
+        close(client.fd);
+        client.fd = -1;
+    }
+}
+
+void CEventSocketServer::AcceptClient(void)
+{
+    int fd = accept(m_listenFd, NULL, NULL);
+    if (fd >= 0)
+    {
+        AddClient(fd);
+    }
+}
+
+void CEventSocketServer::AddPendingClients(void)
+{
+    vector<int> fds;
+    {
+        lock_guard<mutex> guard(m_lock);
+        fds.swap(m_pendingClients);
+    }
+
+    for (size_t i = 0; i < fds.size(); i++)
+    {
+        AddClient(fds[i]);
+    }
+}
+
+void CEventSocketServer::AddClient(int fd)
+{
+    if (m_clients.size() >= EVENT_MAX_CLIENTS)
+    {
+        close(fd);
+        return;
+    }
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    Client &client = m_clients[m_nextClientId++];
+    client.fd = fd;
+    m_clientCount = (INT32U)m_clients.size();
+}
+
+bool CEventSocketServer::HandleFrame(INT32U clientId, Client &client, INT8U type, const INT8U *pPayload,
+                                     INT32U length)
+{
+    if (type == EVENT_MSG_SUBSCRIBE)
+    {
+        if (length != 4 && length != 36)
+            return false;
+
+        client.eventMask = GetU32(pPayload);
+        for (INT32U card = 0; card < 256; card++)
+        {
+            client.cards[card] = (length == 4) || ((pPayload[4 + card / 8] >> (card % 8)) & 1);
+        }
+        return true;
+    }
+
+    if (type == EVENT_MSG_COMMAND)
+    {
+        if (length != 10)
+            return false;
+
+        INT32U requestId = GetU32(pPayload);
+        INT8U cardNumber = pPayload[4];
+        INT8U command = pPayload[5];
+        INT32U arg = GetU32(pPayload + 6);
+
+        SocketCommandHandler handler;
+        {
+            lock_guard<mutex> guard(m_lock);
+            handler = m_commandHandler;
+        }
+
+        SocketCommandDone done = [this, clientId, requestId](ERROR_CODE_T result) {
+            CommandResult commandResult;
+            commandResult.clientId = clientId;
+            commandResult.requestId = requestId;
+            commandResult.result = result;
+            {
+                lock_guard<mutex> guard(m_lock);
+                m_pendingResults.push_back(commandResult);
+                m_wakePending = true;
+            }
+            Wake();
+        };
+
+        if (handler)
+            handler(cardNumber, command, arg, done);
+        else
+            done(ERROR_CODE_NOT_SUPPORTED);
+        return true;
+    }
+
+    // Unknown messages mean the peer speaks something else; drop it.
+    return false;
+}
+
+bool CEventSocketServer::ReadClient(INT32U clientId, Client &client)
+{
+    INT8U buffer[4096];
+    ssize_t received = recv(client.fd, buffer, sizeof(buffer), 0);
+    if (received == 0 || (received < 0 && errno != EAGAIN && errno != EINTR))
+        return false;
+    if (received < 0)
+        return true;
+
+    client.inbound.insert(client.inbound.end(), buffer, buffer + received);
+
+    size_t offset = 0;
+    while (client.inbound.size() - offset >= EVENT_FRAME_HEADER_SIZE)
+    {
+        INT32U length = GetU32(&client.inbound[offset]);
+        if (length > EVENT_MAX_PAYLOAD_SIZE)
+            return false;
+        if (client.inbound.size() - offset < EVENT_FRAME_HEADER_SIZE + length)
+            break;
+
+        INT8U type = client.inbound[offset + 4];
+        if (!HandleFrame(clientId, client, type, &client.inbound[offset + EVENT_FRAME_HEADER_SIZE], length))
+            return false;
+        offset += EVENT_FRAME_HEADER_SIZE + length;
+    }
+
+    client.inbound.erase(client.inbound.begin(), client.inbound.begin() + offset);
+    return true;
+}
+
+bool CEventSocketServer::WriteClient(Client &client)
+{
+    while (client.outboundOffset < client.outbound.size())
+    {
+        ssize_t sent = send(client.fd, &client.outbound[client.outboundOffset],
+                            client.outbound.size() - client.outboundOffset, MSG_NOSIGNAL);
+        if (sent < 0 && (errno == EAGAIN || errno == EINTR))
+            break;
+        if (sent <= 0)
+            return false;
+        client.outboundOffset += (size_t)sent;
+    }
+
+    if (client.outboundOffset == client.outbound.size())
+    {
+        client.outbound.clear();
+        client.outboundOffset = 0;
+    }
+    else if (client.outboundOffset > EVENT_CLIENT_BUFFER_LIMIT / 2)
+    {
+        client.outbound.erase(client.outbound.begin(), client.outbound.begin() + client.outboundOffset);
+        client.outboundOffset = 0;
+    }
+
+    // Tell a client that fell behind how much it missed once it has room.
+    if (client.dropped != 0 && client.outbound.size() - client.outboundOffset < EVENT_CLIENT_BUFFER_LIMIT / 2)
+    {
+        size_t start = BeginFrame(client.outbound, EVENT_MSG_DROPPED);
+        PutU32(client.outbound, client.dropped);
+        EndFrame(client.outbound, start);
+        client.dropped = 0;
+    }
+    return true;
+}
+
+void CEventSocketServer::DeliverPending(void)
+{
+    vector<SocketEvent> events;
+    vector<CommandResult> results;
+    {
+        lock_guard<mutex> guard(m_lock);
+        events.swap(m_pendingEvents);
+        results.swap(m_pendingResults);
+        m_wakePending = false;
+    }
+
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        map<INT32U, Client>::iterator iter = m_clients.find(results[i].clientId);
+        if (iter == m_clients.end())
+            continue;
+
+        vector<INT8U> &outbound = iter->second.outbound;
+        size_t start = BeginFrame(outbound, EVENT_MSG_COMMAND_RESULT);
+        PutU32(outbound, results[i].requestId);
+        PutU32(outbound, (INT32U)results[i].result);
+        EndFrame(outbound, start);
+    }
+
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        const SocketEvent &event = events[i];
+        map<INT32U, Client>::iterator iter;
+        for (iter = m_clients.begin(); iter != m_clients.end(); ++iter)
+        {
+            Client &client = iter->second;
+            if (event.type >= 32 || !((client.eventMask >> event.type) & 1) || !client.cards[event.cardNumber])
+                continue;
+
+            if (client.IsBacklogged())
+            {
+                client.dropped++;
+                m_droppedCount++;
+                continue;
+            }
+
+            size_t nameLength = event.name.size() > EVENT_MAX_NAME_SIZE ? EVENT_MAX_NAME_SIZE : event.name.size();
+            size_t start = BeginFrame(client.outbound, EVENT_MSG_EVENT);
+            PutU8(client.outbound, event.type);
+            PutU8(client.outbound, event.cardNumber);
+            PutU64(client.outbound, event.address);
+            PutU8(client.outbound, (INT8U)nameLength);
+            client.outbound.insert(client.outbound.end(), event.name.begin(), event.name.begin() + nameLength);
+            EndFrame(client.outbound, start);
+        }
+    }
+}
+
+void CEventSocketServer::ThreadMain(void)
+{
+    vector<struct pollfd> pollFds;
+    vector<INT32U> pollClients;
+    while (m_running)
+    {
+        pollFds.clear();
+        pollClients.clear();
+
+        struct pollfd pfd;
+        pfd.fd = m_listenFd;
+        pfd.events = POLLIN;
+        pollFds.push_back(pfd);
+        pfd.fd = m_wakePipe[0];
+        pollFds.push_back(pfd);
+
+        map<INT32U, Client>::iterator iter;
+        for (iter = m_clients.begin(); iter != m_clients.end(); ++iter)
+        {
+            pfd.fd = iter->second.fd;
+            // Command results can't be dropped like events, so a client
+            // that isn't reading them gets no more commands read either.
+            pfd.events = iter->second.IsBacklogged() ? 0 : POLLIN;
+            if (iter->second.outboundOffset < iter->second.outbound.size())
+            {
+                pfd.events |= POLLOUT;
+            }
+            pollFds.push_back(pfd);
+            pollClients.push_back(iter->first);
+        }
+
+        if (poll(&pollFds[0], pollFds.size(), EVENT_POLL_MS) < 0 && errno != EINTR)
+            break;
+
+        if (pollFds[1].revents & POLLIN)
+        {
+            INT8U drain[64];
+            while (read(m_wakePipe[0], drain, sizeof(drain)) > 0)
+            {
+            }
+        }
+
+        for (size_t i = 0; i < pollClients.size(); i++)
+        {
+            map<INT32U, Client>::iterator client = m_clients.find(pollClients[i]);
+            short revents = pollFds[i + 2].revents;
+            bool keep = true;
+            if (revents & (POLLIN | POLLHUP | POLLERR))
+            {
+                keep = ReadClient(client->first, client->second);
+            }
+            if (!keep)
+            {
+                CloseClient(client->second);
+                m_clients.erase(client);
+            }
+        }
+
+        DeliverPending();
+
+        for (iter = m_clients.begin(); iter != m_clients.end();)
+        {
+            if (!WriteClient(iter->second))
+            {
+                CloseClient(iter->second);
+                m_clients.erase(iter++);
+            }
+            else
+            {
+                ++iter;
+            }
+        }
+
+        if (pollFds[0].revents & POLLIN)
+        {
+            AcceptClient();
+        }
+        AddPendingClients();
+        m_clientCount = (INT32U)m_clients.size();
+    }
+}
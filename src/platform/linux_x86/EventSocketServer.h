@@ -0,0 +1,141 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "types.h"
+
+using namespace std;
+
+// Every frame is a little-endian u32 payload length, a u8 message type and
+// the payload.
+#define EVENT_FRAME_HEADER_SIZE 5
+#define EVENT_MAX_PAYLOAD_SIZE 1024
+#define EVENT_MAX_NAME_SIZE 248
+#define EVENT_MAX_CLIENTS 32
+// Bytes a client may have queued before events to it are dropped and its
+// commands are no longer read.
+#define EVENT_CLIENT_BUFFER_LIMIT (256 * 1024)
+
+typedef enum
+{
+    // Client to server. Payload: u32 event type mask, then optionally a
+    // 32-byte bitmap of card numbers; without it every card is included.
+    EVENT_MSG_SUBSCRIBE = 0x01,
+    // Client to server. Payload: u32 request id, u8 card, u8 command,
+    // u32 argument. Answered by EVENT_MSG_COMMAND_RESULT.
+    EVENT_MSG_COMMAND = 0x02,
+
+    // Server to client. Payload: u8 event type, u8 card, u64 packed address,
+    // u8 name length, name.
+    EVENT_MSG_EVENT = 0x81,
+    // Server to client. Payload: u32 request id, i32 result.
+    EVENT_MSG_COMMAND_RESULT = 0x82,
+    // Server to client. Payload: u32 number of events this client missed
+    // because it didn't keep up.
+    EVENT_MSG_DROPPED = 0x83,
+} EventMessageType_t;
+
+struct SocketEvent
+{
+    // Up to 32 application-defined types, matched against the subscription
+    // mask.
+    INT8U type;
+    INT8U cardNumber;
+    uint64_t address;
+    string name;
+};
+
+typedef function<void(ERROR_CODE_T result)> SocketCommandDone;
+typedef function<void(INT8U cardNumber, INT8U command, INT32U arg, SocketCommandDone done)> SocketCommandHandler;
+
+// Unix-domain socket server for supervisors. Events published from any
+// thread are queued, then serialized once per wakeup into each subscribed
+// client's buffer and sent with as few writes as the socket allows. A
+// client that stops reading loses events rather than stalling the cards, and
+// is told how many it missed once it catches up.
+class CEventSocketServer
+{
+  public:
+    CEventSocketServer();
+    ~CEventSocketServer();
+
+    ERROR_CODE_T Start(const string &socketPath);
+    void Stop(void);
+
+    // Adopts an already connected stream socket as a client, e.g. one end
+    // of a socketpair held by an in-process supervisor. The server owns the
+    // descriptor from then on, even if this fails.
+    ERROR_CODE_T AttachClient(int fd);
+
+    // The handler may finish the command on any thread by calling done.
+    void SetCommandHandler(SocketCommandHandler handler);
+    void Publish(const SocketEvent &event);
+
+    INT32U GetClientCount(void) const;
+    INT32U GetDroppedCount(void) const;
+
+  private:
+    struct Client
+    {
+        Client() : fd(-1), eventMask(0), outboundOffset(0), dropped(0)
+        {
+            cards.assign(256, false);
+        }
+
+        bool IsBacklogged(void) const
+        {
+            return outbound.size() - outboundOffset >= EVENT_CLIENT_BUFFER_LIMIT;
+        }
+
+        int fd;
+        INT32U eventMask;
+        vector<bool> cards;
+        vector<INT8U> inbound;
+        vector<INT8U> outbound;
+        size_t outboundOffset;
+        INT32U dropped;
+    };
+
+    struct CommandResult
+    {
+        INT32U clientId;
+        INT32U requestId;
+        ERROR_CODE_T result;
+    };
+
+    void ThreadMain(void);
+    void Wake(void);
+    void AcceptClient(void);
+    void AddClient(int fd);
+    void AddPendingClients(void);
+    bool ReadClient(INT32U clientId, Client &client);
+    bool HandleFrame(INT32U clientId, Client &client, INT8U type, const INT8U *pPayload, INT32U length);
+    bool WriteClient(Client &client);
+    void DeliverPending(void);
+    void CloseClient(Client &client);
+
+    int m_listenFd;
+    int m_wakePipe[2];
+    string m_socketPath;
+    thread m_thread;
+    atomic<bool> m_running;
+
+    mutex m_lock;
+    vector<SocketEvent> m_pendingEvents;
+    vector<CommandResult> m_pendingResults;
+    vector<int> m_pendingClients;
+    bool m_wakePending;
+    SocketCommandHandler m_commandHandler;
+
+    // Owned by the server thread.
+    map<INT32U, Client> m_clients;
+    INT32U m_nextClientId;
+    atomic<INT32U> m_clientCount;
+    atomic<INT32U> m_droppedCount;
+};
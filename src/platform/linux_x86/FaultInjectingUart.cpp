@@ -0,0 +1,245 @@
+#include "FaultInjectingUart.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "ClockSource.h"
+
+#define UART_FAULT_PER_MILLION 1000000
+
+static bool ParseFaultNumber(const string &text, INT32U &valueOut)
+{
+    if (text.empty())
+        return false;
+
+    CHAR8 *pEnd = NULL;
+    unsigned long value = strtoul(text.c_str(), &pEnd, 10);
+    if (*pEnd != '\0' || value > 0xFFFFFFFFUL)
+        return false;
+
+    valueOut = (INT32U)value;
+    return true;
+}
+
+UartFaultConfig::UartFaultConfig()
+    : latencyUs(0), jitterUs(0), dropPerMillion(0), corruptPerMillion(0), maxReadChunk(0), stallPerMillion(0),
+      stallUs(0), seed(1)
+{
+}
+
+ERROR_CODE_T UartFaultConfig::Parse(const string &spec)
+{
+    size_t start = 0;
+    while (start < spec.size())
+    {
+        size_t comma = spec.find(',', start);
+        if (comma == string::npos)
+            comma = spec.size();
+
+        string item = spec.substr(start, comma - start);
+        start = comma + 1;
+        if (item.empty())
+            continue;
+
+        size_t equals = item.find('=');
+        RETURN_EC_IF_TRUE(ERROR_INVALID_PARAMETER, equals == string::npos);
+        string key = item.substr(0, equals);
+        string value = item.substr(equals + 1);
+
+        bool valid;
+        if (key == "latency")
+            valid = ParseFaultNumber(value, latencyUs);
+        else if (key == "jitter")
+            valid = ParseFaultNumber(value, jitterUs);
+        else if (key == "drop")
+            valid = ParseFaultNumber(value, dropPerMillion);
+        else if (key == "corrupt")
+            valid = ParseFaultNumber(value, corruptPerMillion);
+        else if (key == "chunk")
+            valid = ParseFaultNumber(value, maxReadChunk);
+        else if (key == "seed")
+            valid = ParseFaultNumber(value, seed);
+        else if (key == "stall")
+        {
+            // <rate>:<duration us>
+            size_t colon = value.find(':');
+            valid = colon != string::npos && ParseFaultNumber(value.substr(0, colon), stallPerMillion) &&
+                    ParseFaultNumber(value.substr(colon + 1), stallUs);
+        }
+        else
+            valid = false;
+
+        if (!valid)
+        {
+            LogPrintf(DEBUG_NORMAL_ERROR, "uartfault", "Bad fault setting '%s'\r\n", item.c_str());
+            return ERROR_INVALID_PARAMETER;
+        }
+    }
+
+    RETURN_EC_IF_TRUE(ERROR_INVALID_PARAMETER, dropPerMillion > UART_FAULT_PER_MILLION);
+    RETURN_EC_IF_TRUE(ERROR_INVALID_PARAMETER, corruptPerMillion > UART_FAULT_PER_MILLION);
+    RETURN_EC_IF_TRUE(ERROR_INVALID_PARAMETER, stallPerMillion > UART_FAULT_PER_MILLION);
+    return STATUS_SUCCESS;
+}
+
+CFaultInjectingUart::CFaultInjectingUart(shared_ptr<IUart> pUart, const UartFaultConfig &config)
+    : CUartDecorator(pUart), m_linkDown(false)
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+    SetConfig(config);
+}
+
+void CFaultInjectingUart::SetConfig(const UartFaultConfig &config)
+{
+    lock_guard<mutex> guard(m_lock);
+    m_config = config;
+    // xorshift must not start from zero.
+    m_rngState = ((uint64_t)config.seed << 32) ^ 0x9E3779B97F4A7C15ULL;
+}
+
+void CFaultInjectingUart::SetLinkDown(bool linkDown)
+{
+    lock_guard<mutex> guard(m_lock);
+    m_linkDown = linkDown;
+}
+
+UartFaultStats CFaultInjectingUart::GetStats(void)
+{
+    lock_guard<mutex> guard(m_lock);
+    return m_stats;
+}
+
+INT32U CFaultInjectingUart::NextRandom(void)
+{
+    // xorshift64*: cheap, and the sequence depends only on the seed.
+    m_rngState ^= m_rngState >> 12;
+    m_rngState ^= m_rngState << 25;
+    m_rngState ^= m_rngState >> 27;
+    return (INT32U)((m_rngState * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+bool CFaultInjectingUart::Chance(INT32U perMillion)
+{
+    if (perMillion == 0)
+        return false;
+    return (NextRandom() % UART_FAULT_PER_MILLION) < perMillion;
+}
+
+INT32U CFaultInjectingUart::PickDelayUs(bool isWrite)
+{
+    INT32U delayUs = m_config.latencyUs;
+    if (m_config.jitterUs > 0)
+        delayUs += NextRandom() % (m_config.jitterUs + 1);
+
+    if (isWrite && Chance(m_config.stallPerMillion))
+    {
+        delayUs += m_config.stallUs;
+        m_stats.stalls++;
+    }
+
+    m_stats.injectedDelayUs += delayUs;
+    return delayUs;
+}
+
+INT32U CFaultInjectingUart::ApplyByteFaults(INT8U *pBuf, INT32U length)
+{
+    if (m_config.dropPerMillion == 0 && m_config.corruptPerMillion == 0)
+        return length;
+
+    INT32U kept = 0;
+    for (INT32U i = 0; i < length; i++)
+    {
+        if (Chance(m_config.dropPerMillion))
+        {
+            m_stats.bytesDropped++;
+            continue;
+        }
+
+        INT8U byte = pBuf[i];
+        if (Chance(m_config.corruptPerMillion))
+        {
+            byte ^= (INT8U)(1 << (NextRandom() % 8));
+            m_stats.bytesCorrupted++;
+        }
+        pBuf[kept++] = byte;
+    }
+    return kept;
+}
+
+INT32U CFaultInjectingUart::RxBytesAvailable()
+{
+    {
+        lock_guard<mutex> guard(m_lock);
+        if (m_linkDown)
+            return 0;
+    }
+    return m_pUart->RxBytesAvailable();
+}
+
+void CFaultInjectingUart::WritePort(const INT8U *pBuf, INT32U bytesToWrite, INT32U *pBytesWritten)
+{
+    vector<INT8U> surviving(pBuf, pBuf + bytesToWrite);
+    INT32U delayUs;
+    INT32U length;
+    {
+        lock_guard<mutex> guard(m_lock);
+        if (m_linkDown)
+        {
+            if (pBytesWritten != NULL)
+                *pBytesWritten = bytesToWrite;
+            return;
+        }
+        delayUs = PickDelayUs(true);
+        length = ApplyByteFaults(surviving.data(), bytesToWrite);
+    }
+
+    if (delayUs > 0)
+        GetClockSource().SleepUs(delayUs);
+
+    INT32U written = 0;
+    if (length > 0)
+        m_pUart->WritePort(surviving.data(), length, &written);
+
+    // Bytes lost on the line still left the sender as far as it can tell.
+    if (pBytesWritten != NULL)
+        *pBytesWritten = (written == length) ? bytesToWrite : written;
+}
+
+void CFaultInjectingUart::ReadPort(INT8U *pBuf, INT32U maxBytes, INT32U *pBytesRead)
+{
+    INT32U delayUs;
+    INT32U request = maxBytes;
+    {
+        lock_guard<mutex> guard(m_lock);
+        if (m_linkDown)
+        {
+            if (pBytesRead != NULL)
+                *pBytesRead = 0;
+            return;
+        }
+        delayUs = PickDelayUs(false);
+        if (m_config.maxReadChunk > 0 && maxBytes > 1)
+        {
+            request = 1 + NextRandom() % m_config.maxReadChunk;
+            if (request < maxBytes)
+                m_stats.fragmentedReads++;
+            else
+                request = maxBytes;
+        }
+    }
+
+    if (delayUs > 0)
+        GetClockSource().SleepUs(delayUs);
+
+    INT32U bytesRead = 0;
+    m_pUart->ReadPort(pBuf, request, &bytesRead);
+    {
+        lock_guard<mutex> guard(m_lock);
+        bytesRead = ApplyByteFaults(pBuf, bytesRead);
+    }
+
+    if (pBytesRead != NULL)
+        *pBytesRead = bytesRead;
+}
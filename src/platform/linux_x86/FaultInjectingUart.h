@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "UartDecorator.h"
+#include "types.h"
+
+using namespace std;
+
+// Rates are per million, so 1000 is 0.1%. All zero is a pass-through.
+struct UartFaultConfig
+{
+    UartFaultConfig();
+
+    // Parses "latency=2000,jitter=500,drop=100,corrupt=50,chunk=4,
+    // stall=1000:50000,seed=7"; keys left out keep their defaults.
+    ERROR_CODE_T Parse(const string &spec);
+
+    INT32U latencyUs;         // added to every port read and write
+    INT32U jitterUs;          // extra uniform 0..jitterUs delay
+    INT32U dropPerMillion;    // per byte, in either direction
+    INT32U corruptPerMillion; // per byte: one bit is flipped
+    INT32U maxReadChunk;      // reads return 1..maxReadChunk bytes, 0 = off
+    INT32U stallPerMillion;   // per write
+    INT32U stallUs;
+    INT32U seed;
+};
+
+struct UartFaultStats
+{
+    uint64_t bytesDropped;
+    uint64_t bytesCorrupted;
+    uint64_t fragmentedReads;
+    uint64_t stalls;
+    uint64_t injectedDelayUs;
+};
+
+// IUart decorator that makes a healthy link behave like a noisy USB-serial
+// adapter. The same seed and call sequence reproduce the same faults.
+// Delays go through the timer clock source, so a virtual clock skips them.
+class CFaultInjectingUart : public CUartDecorator
+{
+  public:
+    CFaultInjectingUart(shared_ptr<IUart> pUart, const UartFaultConfig &config);
+
+    void SetConfig(const UartFaultConfig &config);
+    // Reads return nothing and writes vanish until the link comes back.
+    void SetLinkDown(bool linkDown);
+    UartFaultStats GetStats(void);
+
+    INT32U RxBytesAvailable() override;
+    void WritePort(const INT8U *pBuf, INT32U bytesToWrite, INT32U *pBytesWritten) override;
+    void ReadPort(INT8U *pBuf, INT32U maxBytes, INT32U *pBytesRead) override;
+
+  private:
+    INT32U NextRandom(void);
+    bool Chance(INT32U perMillion);
+    INT32U PickDelayUs(bool isWrite);
+    // Drops and corrupts bytes in place, returns the new length.
+    INT32U ApplyByteFaults(INT8U *pBuf, INT32U length);
+
+    mutex m_lock;
+    UartFaultConfig m_config;
+    UartFaultStats m_stats;
+    uint64_t m_rngState;
+    bool m_linkDown;
+};
@@ -1,3 +1,21 @@
 #include "IO.h"
 
 shared_ptr<IAVDSNode> CIO::g_pNode = nullptr;
+
+ERROR_CODE_T IAVDSNode::GetBTAdapterConfigTable(shared_ptr<IBTAdapterConfigTable> &pBTAdapterConfigTable)
+{
+    pBTAdapterConfigTable.reset();
+    return ERROR_CODE_NOT_SUPPORTED;
+}
+
+CLinuxAVDSNode::CLinuxAVDSNode(shared_ptr<IBTAdapterConfigTable> pBTAdapterConfigTable)
+    : m_pBTAdapterConfigTable(pBTAdapterConfigTable)
+{
+}
+
+ERROR_CODE_T CLinuxAVDSNode::GetBTAdapterConfigTable(shared_ptr<IBTAdapterConfigTable> &pBTAdapterConfigTable)
+{
+    RETURN_EC_IF_NULL(ERROR_NOT_INITIALIZED, m_pBTAdapterConfigTable);
+    pBTAdapterConfigTable = m_pBTAdapterConfigTable;
+    return STATUS_SUCCESS;
+}
@@ -10,9 +10,23 @@ using namespace std;
 class IAVDSNode
 {
   public:
+    virtual ~IAVDSNode()
+    {
+    }
     virtual ERROR_CODE_T GetBTAdapterConfigTable(shared_ptr<IBTAdapterConfigTable> &pBTAdapterConfigTable);
 };
 
+// Node for hosts without an AVDS backplane: serves an in-process table.
+class CLinuxAVDSNode : public IAVDSNode
+{
+  public:
+    CLinuxAVDSNode(shared_ptr<IBTAdapterConfigTable> pBTAdapterConfigTable);
+    virtual ERROR_CODE_T GetBTAdapterConfigTable(shared_ptr<IBTAdapterConfigTable> &pBTAdapterConfigTable);
+
+  private:
+    shared_ptr<IBTAdapterConfigTable> m_pBTAdapterConfigTable;
+};
+
 class CIO
 {
   public:
@@ -0,0 +1,36 @@
+#include "LinkLivenessTracker.h"
+
+CLinkLivenessTracker::CLinkLivenessTracker(INT16U watchdogWindowMS, INT8U petPercent)
+    : m_petThresholdMS(0)
+{
+    SetWatchdogWindow(watchdogWindowMS, petPercent);
+    Invalidate();
+}
+
+void CLinkLivenessTracker::SetWatchdogWindow(INT16U watchdogWindowMS, INT8U petPercent)
+{
+    if (petPercent == 0 || petPercent > 100)
+        petPercent = LIVENESS_DEFAULT_PET_PERCENT;
+
+    m_petThresholdMS = (INT16U)(((INT32U)watchdogWindowMS * petPercent) / 100);
+}
+
+INT16U CLinkLivenessTracker::GetPetThresholdMS(void)
+{
+    return m_petThresholdMS;
+}
+
+void CLinkLivenessTracker::MarkActivity(void)
+{
+    m_idleTimer.ResetTime(m_petThresholdMS);
+}
+
+void CLinkLivenessTracker::Invalidate(void)
+{
+    m_idleTimer.ResetTime(0);
+}
+
+BOOLEAN CLinkLivenessTracker::IsPetDue(void)
+{
+    return m_idleTimer.IsTimeExpired();
+}
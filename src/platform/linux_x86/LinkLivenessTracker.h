@@ -0,0 +1,31 @@
+#pragma once
+
+#include "TimeDelta.h"
+#include "types.h"
+
+#define LIVENESS_DEFAULT_WINDOW_MS 1000
+#define LIVENESS_DEFAULT_PET_PERCENT 50
+
+// Tracks the last successful exchange with a module. Any response counts as
+// proof of life, so an explicit watchdog pet is only needed once the link has
+// been idle for petPercent of the watchdog window.
+class CLinkLivenessTracker
+{
+  public:
+    CLinkLivenessTracker(INT16U watchdogWindowMS = LIVENESS_DEFAULT_WINDOW_MS, INT8U petPercent = LIVENESS_DEFAULT_PET_PERCENT);
+
+    void SetWatchdogWindow(INT16U watchdogWindowMS, INT8U petPercent);
+    INT16U GetPetThresholdMS(void);
+
+    // Call after any exchange the module answered.
+    void MarkActivity(void);
+
+    // Forces the next IsPetDue() to return true, e.g. after a reconnect.
+    void Invalidate(void);
+
+    BOOLEAN IsPetDue(void);
+
+  private:
+    INT16U m_petThresholdMS;
+    CTimeDelta m_idleTimer;
+};
@@ -0,0 +1,419 @@
+#include "Metrics.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "Profiler.h"
+#include "TimeDelta.h"
+
+#define METRICS_POLL_MS 200
+
+// Bucket boundaries reported to Prometheus, in microseconds.
+static const uint64_t g_exportBoundsUs[] = {
+    100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000,
+    250000, 500000, 1000000, 2500000, 5000000, 10000000, 30000000};
+
+static const CHAR8 *g_counterNames[METRIC_COUNTER_COUNT] = {
+    "bta_timeouts_total",
+    "bta_bytes_tx_total",
+    "bta_bytes_rx_total"};
+
+uint64_t MetricsGetNowUs(void)
+{
+    INT32U seconds = 0;
+    INT32U uSeconds = 0;
+    CTimeDeltaUs::GetTickCountUs(&seconds, &uSeconds);
+    return (uint64_t)seconds * 1000000 + uSeconds;
+}
+
+//
+// CLatencyHistogram
+//
+
+CLatencyHistogram::CLatencyHistogram()
+    : m_count(0), m_sumUs(0), m_maxUs(0)
+{
+    for (INT32U i = 0; i < LATENCY_BUCKET_COUNT; i++)
+    {
+        m_buckets[i] = 0;
+    }
+}
+
+INT32U CLatencyHistogram::GetBucketIndex(uint64_t valueUs)
+{
+    const uint64_t maxValue = (1ULL << (LATENCY_MAX_MAGNITUDE + 1)) - 1;
+    if (valueUs > maxValue)
+        valueUs = maxValue;
+
+    if (valueUs < LATENCY_SUB_BUCKETS)
+        return (INT32U)valueUs;
+
+    INT32U msb = 63 - __builtin_clzll(valueUs);
+    INT32U group = msb - LATENCY_SUB_BUCKET_BITS + 1;
+    INT32U subBucket = (INT32U)(valueUs >> (msb - LATENCY_SUB_BUCKET_BITS)) & (LATENCY_SUB_BUCKETS - 1);
+    return group * LATENCY_SUB_BUCKETS + subBucket;
+}
+
+uint64_t CLatencyHistogram::GetBucketUpperBound(INT32U index)
+{
+    INT32U group = index / LATENCY_SUB_BUCKETS;
+    INT32U subBucket = index % LATENCY_SUB_BUCKETS;
+    if (group == 0)
+        return subBucket;
+
+    INT32U shift = group - 1;
+    uint64_t lower = (uint64_t)(LATENCY_SUB_BUCKETS + subBucket) << shift;
+    return lower + (1ULL << shift) - 1;
+}
+
+void CLatencyHistogram::Record(uint64_t valueUs)
+{
+    m_buckets[GetBucketIndex(valueUs)].fetch_add(1, memory_order_relaxed);
+    m_count.fetch_add(1, memory_order_relaxed);
+    m_sumUs.fetch_add(valueUs, memory_order_relaxed);
+
+    uint64_t currentMax = m_maxUs.load(memory_order_relaxed);
+    while (valueUs > currentMax && !m_maxUs.compare_exchange_weak(currentMax, valueUs, memory_order_relaxed))
+    {
+    }
+}
+
+uint64_t CLatencyHistogram::GetCount(void)
+{
+    return m_count.load(memory_order_relaxed);
+}
+
+uint64_t CLatencyHistogram::GetSumUs(void)
+{
+    return m_sumUs.load(memory_order_relaxed);
+}
+
+uint64_t CLatencyHistogram::GetMaxUs(void)
+{
+    return m_maxUs.load(memory_order_relaxed);
+}
+
+uint64_t CLatencyHistogram::GetPercentileUs(double percentile)
+{
+    uint64_t count = GetCount();
+    if (count == 0)
+        return 0;
+
+    uint64_t target = (uint64_t)((percentile / 100.0) * count + 0.5);
+    if (target == 0)
+        target = 1;
+
+    uint64_t seen = 0;
+    for (INT32U i = 0; i < LATENCY_BUCKET_COUNT; i++)
+    {
+        seen += m_buckets[i].load(memory_order_relaxed);
+        if (seen >= target)
+        {
+            uint64_t upper = GetBucketUpperBound(i);
+            uint64_t maxUs = GetMaxUs();
+            return (upper < maxUs) ? upper : maxUs;
+        }
+    }
+
+    return GetMaxUs();
+}
+
+uint64_t CLatencyHistogram::GetCountAtOrBelow(uint64_t upperBoundUs)
+{
+    uint64_t total = 0;
+    INT32U lastIndex = GetBucketIndex(upperBoundUs);
+    for (INT32U i = 0; i <= lastIndex; i++)
+    {
+        total += m_buckets[i].load(memory_order_relaxed);
+    }
+    return total;
+}
+
+//
+// CMetricsRegistry
+//
+
+CMetricsRegistry &CMetricsRegistry::GetInstance(void)
+{
+    static CMetricsRegistry instance;
+    return instance;
+}
+
+CLatencyHistogram *CMetricsRegistry::GetHistogram(INT8U cardNumber, const string &command)
+{
+    lock_guard<mutex> guard(m_lock);
+    shared_ptr<CLatencyHistogram> &pHistogram = m_histograms[make_pair(cardNumber, command)];
+    if (!pHistogram)
+    {
+        pHistogram = make_shared<CLatencyHistogram>();
+    }
+    return pHistogram.get();
+}
+
+CMetricsRegistry::CardCounters *CMetricsRegistry::GetCounters(INT8U cardNumber)
+{
+    lock_guard<mutex> guard(m_lock);
+    shared_ptr<CardCounters> &pCounters = m_counters[cardNumber];
+    if (!pCounters)
+    {
+        pCounters = make_shared<CardCounters>();
+    }
+    return pCounters.get();
+}
+
+void CMetricsRegistry::AddToCounter(INT8U cardNumber, MetricCounter_t counter, uint64_t amount)
+{
+    if (counter >= METRIC_COUNTER_COUNT)
+        return;
+
+    GetCounters(cardNumber)->values[counter].fetch_add(amount, memory_order_relaxed);
+}
+
+uint64_t CMetricsRegistry::GetCounter(INT8U cardNumber, MetricCounter_t counter)
+{
+    if (counter >= METRIC_COUNTER_COUNT)
+        return 0;
+
+    return GetCounters(cardNumber)->values[counter].load(memory_order_relaxed);
+}
+
+void CMetricsRegistry::RecordResult(INT8U cardNumber, const string &command, uint64_t elapsedUs, ERROR_CODE_T result)
+{
+    GetHistogram(cardNumber, command)->Record(elapsedUs);
+
+    if (result == ERROR_OPERATION_TIMED_OUT || result == ERROR_CODE_TIMEOUT || result == OS_ERR_TIMEOUT)
+    {
+        AddToCounter(cardNumber, METRIC_COUNTER_TIMEOUTS, 1);
+    }
+}
+
+static void AppendLine(string &out, const CHAR8 *pFormat, ...) __attribute__((format(printf, 2, 3)));
+static void AppendLine(string &out, const CHAR8 *pFormat, ...)
+{
+    CHAR8 line[256];
+    va_list args;
+    va_start(args, pFormat);
+    vsnprintf(line, sizeof(line), pFormat, args);
+    va_end(args);
+    out += line;
+}
+
+void CMetricsRegistry::WritePrometheusText(string &out)
+{
+    map<pair<INT8U, string>, shared_ptr<CLatencyHistogram> > histograms;
+    map<INT8U, shared_ptr<CardCounters> > counters;
+    {
+        lock_guard<mutex> guard(m_lock);
+        histograms = m_histograms;
+        counters = m_counters;
+    }
+
+    out.clear();
+    out += "# HELP bta_command_latency_seconds Time taken by each BTA command.\n";
+    out += "# TYPE bta_command_latency_seconds histogram\n";
+    for (map<pair<INT8U, string>, shared_ptr<CLatencyHistogram> >::iterator iter = histograms.begin(); iter != histograms.end(); ++iter)
+    {
+        INT8U card = iter->first.first;
+        const CHAR8 *pCommand = iter->first.second.c_str();
+        CLatencyHistogram *pHistogram = iter->second.get();
+
+        for (INT32U i = 0; i < ARRAY_SIZE(g_exportBoundsUs); i++)
+        {
+            AppendLine(out, "bta_command_latency_seconds_bucket{card=\"%u\",command=\"%s\",le=\"%g\"} %llu\n",
+                       card, pCommand, g_exportBoundsUs[i] / 1e6, (unsigned long long)pHistogram->GetCountAtOrBelow(g_exportBoundsUs[i]));
+        }
+        AppendLine(out, "bta_command_latency_seconds_bucket{card=\"%u\",command=\"%s\",le=\"+Inf\"} %llu\n",
+                   card, pCommand, (unsigned long long)pHistogram->GetCount());
+        AppendLine(out, "bta_command_latency_seconds_sum{card=\"%u\",command=\"%s\"} %.6f\n",
+                   card, pCommand, pHistogram->GetSumUs() / 1e6);
+        AppendLine(out, "bta_command_latency_seconds_count{card=\"%u\",command=\"%s\"} %llu\n",
+                   card, pCommand, (unsigned long long)pHistogram->GetCount());
+    }
+
+    for (INT32U counter = 0; counter < METRIC_COUNTER_COUNT; counter++)
+    {
+        AppendLine(out, "# TYPE %s counter\n", g_counterNames[counter]);
+        for (map<INT8U, shared_ptr<CardCounters> >::iterator iter = counters.begin(); iter != counters.end(); ++iter)
+        {
+            AppendLine(out, "%s{card=\"%u\"} %llu\n", g_counterNames[counter], iter->first,
+                       (unsigned long long)iter->second->values[counter].load(memory_order_relaxed));
+        }
+    }
+}
+
+ERROR_CODE_T CMetricsRegistry::ExportToFile(const string &path)
+{
+    string text;
+    WritePrometheusText(text);
+
+    // node_exporter's textfile collector expects files to appear atomically.
+    string tmpPath = path + ".tmp";
+    FILE *pFile = fopen(tmpPath.c_str(), "w");
+    RETURN_EC_IF_NULL(ERROR_FAILED, pFile);
+
+    size_t written = fwrite(text.data(), 1, text.size(), pFile);
+    fclose(pFile);
+    RETURN_EC_IF_TRUE(ERROR_FAILED, written != text.size());
+    RETURN_EC_IF_TRUE(ERROR_FAILED, rename(tmpPath.c_str(), path.c_str()) != 0);
+
+    return STATUS_SUCCESS;
+}
+
+//
+// CCommandTimer
+//
+
+CCommandTimer::CCommandTimer(INT8U cardNumber, const CHAR8 *pCommand)
+    : m_cardNumber(cardNumber), m_pCommand(pCommand), m_startUs(MetricsGetNowUs()), m_profileBeginNs(0),
+      m_finished(false)
+{
+#ifdef BTA_PROFILING
+    m_profileBeginNs = CProfiler::ZoneBegin();
+#endif
+}
+
+CCommandTimer::~CCommandTimer()
+{
+    if (!m_finished)
+    {
+        Finish(STATUS_SUCCESS);
+    }
+}
+
+ERROR_CODE_T CCommandTimer::Finish(ERROR_CODE_T result)
+{
+    m_finished = true;
+    CMetricsRegistry::GetInstance().RecordResult(m_cardNumber, m_pCommand, MetricsGetNowUs() - m_startUs, result);
+#ifdef BTA_PROFILING
+    // Every driver command goes through a timer, so it doubles as the zone.
+    CProfiler::ZoneEnd(m_pCommand, m_profileBeginNs);
+#endif
+    return result;
+}
+
+//
+// CInstrumentedUart
+//
+
+CInstrumentedUart::CInstrumentedUart(shared_ptr<IUart> pUart, INT8U cardNumber)
+    : CUartDecorator(pUart), m_cardNumber(cardNumber)
+{
+    m_pWriteHistogram = CMetricsRegistry::GetInstance().GetHistogram(cardNumber, "uart_write");
+    m_pReadHistogram = CMetricsRegistry::GetInstance().GetHistogram(cardNumber, "uart_read");
+}
+
+void CInstrumentedUart::WritePort(const INT8U *pBuf, INT32U bytesToWrite, INT32U *pBytesWritten)
+{
+    INT32U written = 0;
+    uint64_t startUs = MetricsGetNowUs();
+    m_pUart->WritePort(pBuf, bytesToWrite, &written);
+    m_pWriteHistogram->Record(MetricsGetNowUs() - startUs);
+    CMetricsRegistry::GetInstance().AddToCounter(m_cardNumber, METRIC_COUNTER_BYTES_TX, written);
+
+    if (pBytesWritten != NULL)
+        *pBytesWritten = written;
+}
+
+void CInstrumentedUart::ReadPort(INT8U *pBuf, INT32U maxBytes, INT32U *pBytesRead)
+{
+    INT32U bytesRead = 0;
+    uint64_t startUs = MetricsGetNowUs();
+    m_pUart->ReadPort(pBuf, maxBytes, &bytesRead);
+    m_pReadHistogram->Record(MetricsGetNowUs() - startUs);
+    CMetricsRegistry::GetInstance().AddToCounter(m_cardNumber, METRIC_COUNTER_BYTES_RX, bytesRead);
+
+    if (pBytesRead != NULL)
+        *pBytesRead = bytesRead;
+}
+
+//
+// CMetricsSocketServer
+//
+
+CMetricsSocketServer::CMetricsSocketServer()
+    : m_listenFd(-1), m_running(false)
+{
+}
+
+CMetricsSocketServer::~CMetricsSocketServer()
+{
+    Stop();
+}
+
+ERROR_CODE_T CMetricsSocketServer::Start(const string &socketPath)
+{
+    RETURN_EC_IF_TRUE(ERROR_FAILED, m_running);
+
+    struct sockaddr_un address;
+    RETURN_EC_IF_TRUE(ERROR_INVALID_PARAMETER, socketPath.size() >= sizeof(address.sun_path));
+
+    m_listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    RETURN_EC_IF_TRUE(ERROR_FAILED, m_listenFd < 0);
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+
+    unlink(socketPath.c_str());
+    if (bind(m_listenFd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(m_listenFd, 4) != 0)
+    {
+        LogPrintf(DEBUG_NORMAL_ERROR, "metrics", "Failed to listen on %s: %s\n", socketPath.c_str(), strerror(errno));
+        close(m_listenFd);
+        m_listenFd = -1;
+        return ERROR_FAILED;
+    }
+
+    m_socketPath = socketPath;
+    m_running = true;
+    m_thread = thread(&CMetricsSocketServer::ThreadMain, this);
+    return STATUS_SUCCESS;
+}
+
+void CMetricsSocketServer::Stop(void)
+{
+    if (!m_running)
+        return;
+
+    m_running = false;
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+
+    close(m_listenFd);
+    m_listenFd = -1;
+    unlink(m_socketPath.c_str());
+}
+
+void CMetricsSocketServer::ThreadMain(void)
+{
+    string text;
+    while (m_running)
+    {
+        struct pollfd pfd;
+        pfd.fd = m_listenFd;
+        pfd.events = POLLIN;
+        if (poll(&pfd, 1, METRICS_POLL_MS) <= 0)
+            continue;
+
+        int clientFd = accept(m_listenFd, NULL, NULL);
+        if (clientFd < 0)
+            continue;
+
+        CMetricsRegistry::GetInstance().WritePrometheusText(text);
+        size_t sent = 0;
+        while (sent < text.size())
+        {
+            ssize_t result = send(clientFd, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+            if (result <= 0)
+                break;
+            sent += (size_t)result;
+        }
+        close(clientFd);
+    }
+}
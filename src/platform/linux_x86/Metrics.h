@@ -0,0 +1,147 @@
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "UartDecorator.h"
+#include "types.h"
+
+// Log-linear (HDR style) bucketing: 16 linear sub-buckets per power of two,
+// which bounds the relative error of any reported value to about 6%.
+#define LATENCY_SUB_BUCKET_BITS 4
+#define LATENCY_SUB_BUCKETS (1 << LATENCY_SUB_BUCKET_BITS)
+#define LATENCY_MAX_MAGNITUDE 40
+#define LATENCY_BUCKET_COUNT ((LATENCY_MAX_MAGNITUDE - LATENCY_SUB_BUCKET_BITS + 2) * LATENCY_SUB_BUCKETS)
+
+// Lock-free latency histogram in microseconds. Recording is a couple of
+// relaxed atomic increments so it can sit on the serial hot path.
+class CLatencyHistogram
+{
+  public:
+    CLatencyHistogram();
+
+    void Record(uint64_t valueUs);
+    uint64_t GetCount(void);
+    uint64_t GetSumUs(void);
+    uint64_t GetMaxUs(void);
+    // percentile in the range 0-100, e.g. 99.9
+    uint64_t GetPercentileUs(double percentile);
+
+    // Number of recorded values <= upperBoundUs. The bucket holding the
+    // bound is counted whole, so values up to one bucket width (about 6%)
+    // above it are included rather than dropped.
+    uint64_t GetCountAtOrBelow(uint64_t upperBoundUs);
+
+    static INT32U GetBucketIndex(uint64_t valueUs);
+    static uint64_t GetBucketUpperBound(INT32U index);
+
+  private:
+    atomic<uint64_t> m_buckets[LATENCY_BUCKET_COUNT];
+    atomic<uint64_t> m_count;
+    atomic<uint64_t> m_sumUs;
+    atomic<uint64_t> m_maxUs;
+};
+
+typedef enum
+{
+    METRIC_COUNTER_TIMEOUTS,
+    METRIC_COUNTER_BYTES_TX,
+    METRIC_COUNTER_BYTES_RX,
+    METRIC_COUNTER_COUNT,
+} MetricCounter_t;
+
+// Per-card, per-command latency histograms plus per-card counters. Callers
+// look a histogram up once and keep the pointer; entries are never removed.
+class CMetricsRegistry
+{
+  public:
+    static CMetricsRegistry &GetInstance(void);
+
+    CLatencyHistogram *GetHistogram(INT8U cardNumber, const string &command);
+    void AddToCounter(INT8U cardNumber, MetricCounter_t counter, uint64_t amount);
+    uint64_t GetCounter(INT8U cardNumber, MetricCounter_t counter);
+    void RecordResult(INT8U cardNumber, const string &command, uint64_t elapsedUs, ERROR_CODE_T result);
+
+    // Renders everything in the Prometheus text exposition format.
+    void WritePrometheusText(string &out);
+    ERROR_CODE_T ExportToFile(const string &path);
+
+  private:
+    CMetricsRegistry()
+    {
+    }
+
+    struct CardCounters
+    {
+        CardCounters()
+        {
+            for (INT32U i = 0; i < METRIC_COUNTER_COUNT; i++)
+                values[i] = 0;
+        }
+
+        atomic<uint64_t> values[METRIC_COUNTER_COUNT];
+    };
+
+    CardCounters *GetCounters(INT8U cardNumber);
+
+    mutex m_lock;
+    map<pair<INT8U, string>, shared_ptr<CLatencyHistogram> > m_histograms;
+    map<INT8U, shared_ptr<CardCounters> > m_counters;
+};
+
+// Times one command and records it (and a timeout, if that's how it ended).
+class CCommandTimer
+{
+  public:
+    CCommandTimer(INT8U cardNumber, const CHAR8 *pCommand);
+    ~CCommandTimer();
+
+    ERROR_CODE_T Finish(ERROR_CODE_T result);
+
+  private:
+    INT8U m_cardNumber;
+    const CHAR8 *m_pCommand;
+    uint64_t m_startUs;
+    uint64_t m_profileBeginNs;
+    bool m_finished;
+};
+
+// IUart decorator that counts bytes moved and times every port read/write.
+class CInstrumentedUart : public CUartDecorator
+{
+  public:
+    CInstrumentedUart(shared_ptr<IUart> pUart, INT8U cardNumber);
+
+    void WritePort(const INT8U *pBuf, INT32U bytesToWrite, INT32U *pBytesWritten) override;
+    void ReadPort(INT8U *pBuf, INT32U maxBytes, INT32U *pBytesRead) override;
+
+  private:
+    INT8U m_cardNumber;
+    CLatencyHistogram *m_pWriteHistogram;
+    CLatencyHistogram *m_pReadHistogram;
+};
+
+// Serves a metrics snapshot to every client that connects to a Unix-domain
+// socket, then closes the connection (one scrape per connect).
+class CMetricsSocketServer
+{
+  public:
+    CMetricsSocketServer();
+    ~CMetricsSocketServer();
+
+    ERROR_CODE_T Start(const string &socketPath);
+    void Stop(void);
+
+  private:
+    void ThreadMain(void);
+
+    int m_listenFd;
+    string m_socketPath;
+    thread m_thread;
+    atomic<bool> m_running;
+};
+
+uint64_t MetricsGetNowUs(void);
@@ -0,0 +1,191 @@
+#include "Profiler.h"
+
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#define PROFILER_THREAD_NAME_BYTES 16
+
+// Each slot is a small seqlock so a dump running on another thread can skip
+// a zone that is being overwritten instead of reporting a torn one.
+struct ProfileZoneRecord
+{
+    atomic<INT32U> sequence;
+    const CHAR8 *pName;
+    uint64_t beginNs;
+    uint64_t endNs;
+};
+
+struct ProfileRing
+{
+    ProfileRing() : head(0), tid(0)
+    {
+        threadName[0] = '\0';
+        for (INT32U i = 0; i < PROFILER_RING_RECORDS; i++)
+        {
+            records[i].sequence.store(0, memory_order_relaxed);
+        }
+    }
+
+    ProfileZoneRecord records[PROFILER_RING_RECORDS];
+    atomic<INT32U> head;
+    pid_t tid;
+    CHAR8 threadName[PROFILER_THREAD_NAME_BYTES];
+};
+
+#ifdef BTA_PROFILING
+atomic<bool> CProfiler::m_enabled(true);
+#else
+atomic<bool> CProfiler::m_enabled(false);
+#endif
+
+static mutex g_registryLock;
+// Rings outlive their threads so a dump still shows zones from workers that
+// have already exited.
+static vector<shared_ptr<ProfileRing> > g_rings;
+static thread_local ProfileRing *t_pRing = NULL;
+
+static ProfileRing *GetThreadRing(void)
+{
+    if (t_pRing == NULL)
+    {
+        shared_ptr<ProfileRing> pRing = make_shared<ProfileRing>();
+        pRing->tid = (pid_t)syscall(SYS_gettid);
+        pthread_getname_np(pthread_self(), pRing->threadName, sizeof(pRing->threadName));
+
+        lock_guard<mutex> guard(g_registryLock);
+        g_rings.push_back(pRing);
+        t_pRing = pRing.get();
+    }
+    return t_pRing;
+}
+
+void CProfiler::SetEnabled(bool enabled)
+{
+    m_enabled = enabled;
+}
+
+uint64_t CProfiler::GetNowNs(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+void CProfiler::ZoneEnd(const CHAR8 *pName, uint64_t beginNs)
+{
+    // Zero means profiling was off when the zone opened.
+    if (beginNs == 0)
+        return;
+
+    uint64_t endNs = GetNowNs();
+    ProfileRing *pRing = GetThreadRing();
+    INT32U head = pRing->head.load(memory_order_relaxed);
+    ProfileZoneRecord &record = pRing->records[head % PROFILER_RING_RECORDS];
+
+    record.sequence.store(head * 2 + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    record.pName = pName;
+    record.beginNs = beginNs;
+    record.endNs = endNs;
+    record.sequence.store(head * 2 + 2, memory_order_release);
+    pRing->head.store(head + 1, memory_order_release);
+}
+
+static void WriteJsonString(FILE *pOut, const CHAR8 *pText)
+{
+    fputc('"', pOut);
+    for (const CHAR8 *p = pText; *p != '\0'; p++)
+    {
+        if (*p == '"' || *p == '\\')
+            fputc('\\', pOut);
+        if ((unsigned char)*p >= 0x20)
+            fputc(*p, pOut);
+    }
+    fputc('"', pOut);
+}
+
+ERROR_CODE_T CProfiler::DumpChromeTrace(FILE *pOut)
+{
+    RETURN_EC_IF_NULL(ERROR_INVALID_PARAMETER, pOut);
+
+    vector<shared_ptr<ProfileRing> > rings;
+    {
+        lock_guard<mutex> guard(g_registryLock);
+        rings = g_rings;
+    }
+
+    pid_t pid = getpid();
+    bool first = true;
+    fprintf(pOut, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    for (size_t i = 0; i < rings.size(); i++)
+    {
+        ProfileRing *pRing = rings[i].get();
+        if (pRing->threadName[0] != '\0')
+        {
+            fprintf(pOut, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":",
+                    first ? "" : ",\n", (int)pid, (int)pRing->tid);
+            WriteJsonString(pOut, pRing->threadName);
+            fprintf(pOut, "}}");
+            first = false;
+        }
+
+        INT32U head = pRing->head.load(memory_order_acquire);
+        INT32U start = (head > PROFILER_RING_RECORDS) ? head - PROFILER_RING_RECORDS : 0;
+        for (INT32U index = start; index != head; index++)
+        {
+            ProfileZoneRecord &record = pRing->records[index % PROFILER_RING_RECORDS];
+            INT32U sequence = record.sequence.load(memory_order_acquire);
+            const CHAR8 *pName = record.pName;
+            uint64_t beginNs = record.beginNs;
+            uint64_t endNs = record.endNs;
+            atomic_thread_fence(memory_order_acquire);
+            if (sequence != index * 2 + 2 || record.sequence.load(memory_order_relaxed) != sequence)
+                continue;
+
+            fprintf(pOut, "%s{\"name\":", first ? "" : ",\n");
+            WriteJsonString(pOut, pName);
+            fprintf(pOut, ",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%llu.%03u,\"dur\":%llu.%03u}", (int)pid,
+                    (int)pRing->tid, (unsigned long long)(beginNs / 1000), (unsigned)(beginNs % 1000),
+                    (unsigned long long)((endNs - beginNs) / 1000), (unsigned)((endNs - beginNs) % 1000));
+            first = false;
+        }
+    }
+    fprintf(pOut, "\n]}\n");
+    return STATUS_SUCCESS;
+}
+
+ERROR_CODE_T CProfiler::DumpChromeTrace(const string &path)
+{
+    // Written aside and renamed so a viewer never opens half a file.
+    string tmpPath = path + ".tmp";
+    FILE *pFile = fopen(tmpPath.c_str(), "w");
+    RETURN_EC_IF_NULL(ERROR_FAILED, pFile);
+
+    ERROR_CODE_T result = DumpChromeTrace(pFile);
+    if (fclose(pFile) != 0 || FAILED(result) || rename(tmpPath.c_str(), path.c_str()) != 0)
+    {
+        unlink(tmpPath.c_str());
+        return ERROR_FAILED;
+    }
+    return STATUS_SUCCESS;
+}
+
+void CProfiler::Clear(void)
+{
+    lock_guard<mutex> guard(g_registryLock);
+    for (size_t i = 0; i < g_rings.size(); i++)
+    {
+        // Only the owning thread may move head; invalidating the slots is
+        // enough to keep the dump from reporting them.
+        for (INT32U j = 0; j < PROFILER_RING_RECORDS; j++)
+        {
+            g_rings[i]->records[j].sequence.store(0, memory_order_relaxed);
+        }
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <string>
+#include <utility>
+
+#include "ScopeExit.h"
+#include "types.h"
+
+using namespace std;
+
+#define PROFILER_RING_RECORDS 4096
+
+// Records named zones into a ring owned by the calling thread. The rings
+// are flight recorders: the oldest zones are overwritten, and a dump is a
+// snapshot of what every thread did most recently.
+class CProfiler
+{
+  public:
+    static void SetEnabled(bool enabled);
+    static bool IsEnabled(void)
+    {
+        return m_enabled.load(memory_order_relaxed);
+    }
+
+    // Monotonic, unaffected by the timer clock source.
+    static uint64_t GetNowNs(void);
+
+    static uint64_t ZoneBegin(void)
+    {
+        return IsEnabled() ? GetNowNs() : 0;
+    }
+    // pName must be a string literal; only the pointer is stored.
+    static void ZoneEnd(const CHAR8 *pName, uint64_t beginNs);
+
+    // Writes every thread's zones as Chrome trace-event JSON, viewable in
+    // chrome://tracing or Perfetto.
+    static ERROR_CODE_T DumpChromeTrace(FILE *pOut);
+    static ERROR_CODE_T DumpChromeTrace(const string &path);
+    static void Clear(void);
+
+  private:
+    static atomic<bool> m_enabled;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+// Marks the rest of the enclosing scope as a zone. Builds without
+// BTA_PROFILING compile it out entirely.
+#ifdef BTA_PROFILING
+#define PROFILE_ZONE(name)                                                                          \
+    const uint64_t PROFILE_CONCAT(profileZoneBegin, __LINE__) = CProfiler::ZoneBegin();            \
+    auto PROFILE_CONCAT(profileZoneEnd, __LINE__) = MakeScopeExit(                                 \
+        [&] { CProfiler::ZoneEnd((name), PROFILE_CONCAT(profileZoneBegin, __LINE__)); })
+#else
+#define PROFILE_ZONE(name) \
+    do                     \
+    {                      \
+    } while (0)
+#endif
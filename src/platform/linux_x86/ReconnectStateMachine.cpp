@@ -0,0 +1,109 @@
+#include "ReconnectStateMachine.h"
+
+CReconnectStateMachine::CReconnectStateMachine(IReconnectActions *pActions, INT16U minBackoffMS, INT16U maxBackoffMS)
+    : m_pActions(pActions), m_minBackoffMS(minBackoffMS),
+      m_maxBackoffMS(maxBackoffMS < minBackoffMS ? minBackoffMS : maxBackoffMS), m_backoffMS(minBackoffMS),
+      m_started(false), m_state(RECONNECT_STATE_INQUIRY)
+{
+}
+
+ReconnectState_t CReconnectStateMachine::GetState(void) const
+{
+    return m_state;
+}
+
+const string &CReconnectStateMachine::GetPeer(void) const
+{
+    return m_peer;
+}
+
+void CReconnectStateMachine::OnInquiryResult(const string &btAddress)
+{
+    if (m_state == RECONNECT_STATE_INQUIRY && m_candidate.empty())
+    {
+        m_candidate = btAddress;
+    }
+}
+
+void CReconnectStateMachine::EnterInquiry(void)
+{
+    LogPrintf(DEBUG_TRACE_INFO, "reconnect", "Starting inquiry\r\n");
+    m_state = RECONNECT_STATE_INQUIRY;
+    m_candidate.clear();
+}
+
+void CReconnectStateMachine::EnterBackoff(void)
+{
+    LogPrintf(DEBUG_TRACE_INFO, "reconnect", "No connection, retrying in %u ms\r\n", m_backoffMS);
+    m_state = RECONNECT_STATE_BACKOFF;
+    m_stateTimer.ResetTime(m_backoffMS);
+
+    INT32U next = (INT32U)m_backoffMS * 2;
+    m_backoffMS = (INT16U)((next > m_maxBackoffMS) ? m_maxBackoffMS : next);
+}
+
+// The module may still connect while the round backs off, so the candidate
+// from the last inquiry stands until the next one starts.
+void CReconnectStateMachine::EnterConnected(void)
+{
+    m_state = RECONNECT_STATE_CONNECTED;
+    m_backoffMS = m_minBackoffMS;
+    m_peer = m_candidate;
+}
+
+ERROR_CODE_T CReconnectStateMachine::Poll(void)
+{
+    RETURN_EC_IF_NULL(ERROR_NOT_INITIALIZED, m_pActions);
+
+    bool isConnected = m_pActions->IsConnected();
+    if (!m_started)
+    {
+        m_started = true;
+        if (isConnected)
+        {
+            EnterConnected();
+            return STATUS_SUCCESS;
+        }
+        EnterInquiry();
+    }
+
+    if (m_state == RECONNECT_STATE_CONNECTED)
+    {
+        if (!isConnected)
+        {
+            LogPrintf(DEBUG_TRACE_INFO, "reconnect", "Link to %s dropped\r\n",
+                      m_peer.empty() ? "unknown peer" : m_peer.c_str());
+            m_peer.clear();
+            EnterInquiry();
+        }
+        return STATUS_SUCCESS;
+    }
+
+    if (isConnected)
+    {
+        EnterConnected();
+        return STATUS_SUCCESS;
+    }
+
+    switch (m_state)
+    {
+        case RECONNECT_STATE_INQUIRY:
+            if (m_pActions->RunInquiry() != STATUS_OPERATION_INCOMPLETE)
+            {
+                EnterBackoff();
+            }
+            break;
+
+        case RECONNECT_STATE_BACKOFF:
+            if (m_stateTimer.IsTimeExpired())
+            {
+                EnterInquiry();
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    return STATUS_SUCCESS;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <string>
+
+#include "TimeDelta.h"
+#include "types.h"
+
+using namespace std;
+
+#define RECONNECT_DEFAULT_MIN_BACKOFF_MS 1000
+#define RECONNECT_DEFAULT_MAX_BACKOFF_MS 30000
+
+typedef enum
+{
+    RECONNECT_STATE_CONNECTED,
+    RECONNECT_STATE_INQUIRY,
+    RECONNECT_STATE_BACKOFF,
+} ReconnectState_t;
+
+// What the state machine needs from a card.
+class IReconnectActions
+{
+  public:
+    virtual ~IReconnectActions()
+    {
+    }
+
+    // Starts or continues an inquiry. STATUS_OPERATION_INCOMPLETE until the
+    // inquiry window closes. Results come back through OnInquiryResult.
+    virtual ERROR_CODE_T RunInquiry(void) = 0;
+
+    virtual bool IsConnected(void) = 0;
+};
+
+// Gets a card back onto a peer without scanning continuously. The module
+// connects by itself to a peer an inquiry turns up, so a round is one
+// inquiry, and rounds that end without a link back off exponentially. The
+// driver can neither page a given address nor say which peer the link is
+// up to, so there is no direct page of the last peer.
+class CReconnectStateMachine
+{
+  public:
+    CReconnectStateMachine(IReconnectActions *pActions, INT16U minBackoffMS = RECONNECT_DEFAULT_MIN_BACKOFF_MS,
+                           INT16U maxBackoffMS = RECONNECT_DEFAULT_MAX_BACKOFF_MS);
+
+    // Advances the state machine by at most one action call.
+    ERROR_CODE_T Poll(void);
+
+    // Remembers the first device the current round's inquiry reports.
+    void OnInquiryResult(const string &btAddress);
+
+    ReconnectState_t GetState(void) const;
+    // The first device found by the inquiry the link came up after, which
+    // is the one the module connects to. Empty if the link came up without
+    // an inquiry, e.g. to a bonded peer on startup.
+    const string &GetPeer(void) const;
+
+  private:
+    void EnterInquiry(void);
+    void EnterBackoff(void);
+    void EnterConnected(void);
+
+    IReconnectActions *m_pActions;
+    INT16U m_minBackoffMS;
+    INT16U m_maxBackoffMS;
+    INT16U m_backoffMS;
+
+    bool m_started;
+    ReconnectState_t m_state;
+    string m_candidate;
+    string m_peer;
+    CTimeDelta m_stateTimer;
+};
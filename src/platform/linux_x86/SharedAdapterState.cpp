@@ -0,0 +1,203 @@
+#include "SharedAdapterState.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <thread>
+
+#define SHARED_STATE_READ_RETRIES 1000
+
+static size_t GetSlotsOffset(void)
+{
+    // Keep the slots cache-line aligned behind the header.
+    return (sizeof(SharedAdapterStateHeader) + SHARED_ADAPTER_CACHE_LINE - 1) & ~(size_t)(SHARED_ADAPTER_CACHE_LINE - 1);
+}
+
+static size_t GetMappingSize(INT32U numCards)
+{
+    return GetSlotsOffset() + (size_t)numCards * sizeof(SharedCardSlot);
+}
+
+CSharedAdapterStateWriter::CSharedAdapterStateWriter()
+    : m_pMapping(NULL), m_mappingSize(0), m_pSlots(NULL), m_numCards(0)
+{
+}
+
+CSharedAdapterStateWriter::~CSharedAdapterStateWriter()
+{
+    Close();
+}
+
+ERROR_CODE_T CSharedAdapterStateWriter::Create(const string &name, INT16U numCards)
+{
+    RETURN_EC_IF_TRUE(ERROR_INVALID_PARAMETER, name.empty() || numCards == 0);
+    Close();
+
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+    RETURN_EC_IF_TRUE(ERROR_FAILED, fd < 0);
+
+    size_t mappingSize = GetMappingSize(numCards);
+    if (ftruncate(fd, (off_t)mappingSize) != 0)
+    {
+        close(fd);
+        shm_unlink(name.c_str());
+        return ERROR_FAILED;
+    }
+
+    void *pMapping = mmap(NULL, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (pMapping == MAP_FAILED)
+    {
+        shm_unlink(name.c_str());
+        return ERROR_FAILED;
+    }
+
+    // Readers check the magic last, so publish it only after the slots are
+    // zeroed.
+    memset(pMapping, 0, mappingSize);
+    SharedAdapterStateHeader *pHeader = (SharedAdapterStateHeader *)pMapping;
+    pHeader->version = SHARED_ADAPTER_STATE_VERSION;
+    pHeader->numCards = numCards;
+    pHeader->slotSize = sizeof(SharedCardSlot);
+    atomic_thread_fence(memory_order_release);
+    pHeader->magic = SHARED_ADAPTER_STATE_MAGIC;
+
+    m_name = name;
+    m_pMapping = pMapping;
+    m_mappingSize = mappingSize;
+    m_pSlots = (SharedCardSlot *)((CHAR8 *)pMapping + GetSlotsOffset());
+    m_numCards = numCards;
+    return STATUS_SUCCESS;
+}
+
+void CSharedAdapterStateWriter::Close(void)
+{
+    if (m_pMapping == NULL)
+        return;
+
+    munmap(m_pMapping, m_mappingSize);
+    shm_unlink(m_name.c_str());
+    m_pMapping = NULL;
+    m_pSlots = NULL;
+    m_numCards = 0;
+}
+
+bool CSharedAdapterStateWriter::IsOpen(void) const
+{
+    return m_pMapping != NULL;
+}
+
+INT16U CSharedAdapterStateWriter::GetNumCards(void) const
+{
+    return m_numCards;
+}
+
+SharedCardState *CSharedAdapterStateWriter::BeginUpdate(INT16U cardNumber)
+{
+    if (cardNumber >= m_numCards)
+        return NULL;
+
+    SharedCardSlot &slot = m_pSlots[cardNumber];
+    slot.sequence.store(slot.sequence.load(memory_order_relaxed) + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    return &slot.state;
+}
+
+void CSharedAdapterStateWriter::EndUpdate(INT16U cardNumber)
+{
+    if (cardNumber >= m_numCards)
+        return;
+
+    SharedCardSlot &slot = m_pSlots[cardNumber];
+    slot.sequence.store(slot.sequence.load(memory_order_relaxed) + 1, memory_order_release);
+}
+
+CSharedAdapterStateReader::CSharedAdapterStateReader()
+    : m_pMapping(NULL), m_mappingSize(0), m_pSlots(NULL), m_numCards(0)
+{
+}
+
+CSharedAdapterStateReader::~CSharedAdapterStateReader()
+{
+    Close();
+}
+
+ERROR_CODE_T CSharedAdapterStateReader::Open(const string &name)
+{
+    Close();
+
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    RETURN_EC_IF_TRUE(ERROR_NOT_INITIALIZED, fd < 0);
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < GetSlotsOffset())
+    {
+        close(fd);
+        return ERROR_NOT_INITIALIZED;
+    }
+
+    size_t mappingSize = (size_t)info.st_size;
+    void *pMapping = mmap(NULL, mappingSize, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    RETURN_EC_IF_TRUE(ERROR_FAILED, pMapping == MAP_FAILED);
+
+    const SharedAdapterStateHeader *pHeader = (const SharedAdapterStateHeader *)pMapping;
+    bool valid = pHeader->magic == SHARED_ADAPTER_STATE_MAGIC;
+    atomic_thread_fence(memory_order_acquire);
+    valid = valid && pHeader->version == SHARED_ADAPTER_STATE_VERSION &&
+            pHeader->slotSize == sizeof(SharedCardSlot) && GetMappingSize(pHeader->numCards) <= mappingSize;
+    if (!valid)
+    {
+        munmap(pMapping, mappingSize);
+        return ERROR_INVALID_CONFIGURATION;
+    }
+
+    m_pMapping = pMapping;
+    m_mappingSize = mappingSize;
+    m_pSlots = (const SharedCardSlot *)((const CHAR8 *)pMapping + GetSlotsOffset());
+    m_numCards = (INT16U)pHeader->numCards;
+    return STATUS_SUCCESS;
+}
+
+void CSharedAdapterStateReader::Close(void)
+{
+    if (m_pMapping == NULL)
+        return;
+
+    munmap(m_pMapping, m_mappingSize);
+    m_pMapping = NULL;
+    m_pSlots = NULL;
+    m_numCards = 0;
+}
+
+INT16U CSharedAdapterStateReader::GetNumCards(void) const
+{
+    return m_numCards;
+}
+
+ERROR_CODE_T CSharedAdapterStateReader::ReadCard(INT16U cardNumber, SharedCardState &stateOut) const
+{
+    RETURN_EC_IF_TRUE(ERROR_INVALID_PARAMETER, cardNumber >= m_numCards);
+
+    const SharedCardSlot &slot = m_pSlots[cardNumber];
+    for (INT32U attempt = 0; attempt < SHARED_STATE_READ_RETRIES; attempt++)
+    {
+        INT32U before = slot.sequence.load(memory_order_acquire);
+        if ((before & 1) == 0)
+        {
+            memcpy(&stateOut, &slot.state, sizeof(SharedCardState));
+            atomic_thread_fence(memory_order_acquire);
+            if (slot.sequence.load(memory_order_relaxed) == before)
+                return STATUS_SUCCESS;
+        }
+
+        // The writer holds a slot for a few hundred stores at most, so
+        // yielding is enough; it never blocks in between.
+        this_thread::yield();
+    }
+
+    return ERROR_OPERATION_TIMED_OUT;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+
+#include "types.h"
+
+using namespace std;
+
+#define SHARED_ADAPTER_STATE_MAGIC 0x53415442 // "BTAS"
+#define SHARED_ADAPTER_STATE_VERSION 2
+#define SHARED_ADAPTER_STATE_DEFAULT_NAME "/btaudiocard-state"
+#define SHARED_ADAPTER_MAX_DETECTED 32
+#define SHARED_ADAPTER_NAME_SIZE 64
+#define SHARED_ADAPTER_CACHE_LINE 64
+
+struct SharedDetectedDevice
+{
+    uint64_t address;
+    CHAR8 name[SHARED_ADAPTER_NAME_SIZE];
+};
+
+// Everything a reader sees for one card. Addresses are packed as by
+// PackBtAddress; 0 means none.
+struct SharedCardState
+{
+    INT8U isOnline;
+    INT8U isConnected;
+    INT16U numDetected;
+    INT32U reserved;
+    uint64_t peerAddress;
+    CHAR8 peerName[SHARED_ADAPTER_NAME_SIZE];
+    SharedDetectedDevice detected[SHARED_ADAPTER_MAX_DETECTED];
+};
+
+// Card slot in the mapping. The sequence is odd while the writer is
+// updating the slot, so readers retry until they see the same even value
+// before and after copying it. Slots start and end on a cache line so a
+// write to one card never invalidates a line a reader of another is using.
+struct alignas(SHARED_ADAPTER_CACHE_LINE) SharedCardSlot
+{
+    atomic<INT32U> sequence;
+    INT32U reserved;
+    SharedCardState state;
+};
+
+static_assert(sizeof(SharedCardSlot) % SHARED_ADAPTER_CACHE_LINE == 0, "card slots must not share cache lines");
+
+struct SharedAdapterStateHeader
+{
+    INT32U magic;
+    INT32U version;
+    INT32U numCards;
+    INT32U slotSize;
+};
+
+// Single writer side of the shared table. Publishing a card touches only the
+// mapping, so updates cost a few stores and no syscalls.
+class CSharedAdapterStateWriter
+{
+  public:
+    CSharedAdapterStateWriter();
+    ~CSharedAdapterStateWriter();
+
+    ERROR_CODE_T Create(const string &name, INT16U numCards);
+    void Close(void);
+    bool IsOpen(void) const;
+    INT16U GetNumCards(void) const;
+
+    // Returns the card's state for in-place update between the two calls,
+    // or NULL if the card is out of range or the table isn't open.
+    SharedCardState *BeginUpdate(INT16U cardNumber);
+    void EndUpdate(INT16U cardNumber);
+
+  private:
+    CSharedAdapterStateWriter(const CSharedAdapterStateWriter &);
+    CSharedAdapterStateWriter &operator=(const CSharedAdapterStateWriter &);
+
+    string m_name;
+    void *m_pMapping;
+    size_t m_mappingSize;
+    SharedCardSlot *m_pSlots;
+    INT16U m_numCards;
+};
+
+// Read-only view for other processes. Reads never block the writer.
+class CSharedAdapterStateReader
+{
+  public:
+    CSharedAdapterStateReader();
+    ~CSharedAdapterStateReader();
+
+    ERROR_CODE_T Open(const string &name);
+    void Close(void);
+    INT16U GetNumCards(void) const;
+
+    // Copies a consistent snapshot of the card. Returns
+    // ERROR_OPERATION_TIMED_OUT if the writer kept the slot busy for all
+    // retries.
+    ERROR_CODE_T ReadCard(INT16U cardNumber, SharedCardState &stateOut) const;
+
+  private:
+    CSharedAdapterStateReader(const CSharedAdapterStateReader &);
+    CSharedAdapterStateReader &operator=(const CSharedAdapterStateReader &);
+
+    void *m_pMapping;
+    size_t m_mappingSize;
+    const SharedCardSlot *m_pSlots;
+    INT16U m_numCards;
+};
@@ -1,9 +1,7 @@
-#include <time.h>
-#include <sys/time.h>
 #include "types.h"
 
+#include "ClockSource.h"
 #include "TimeDelta.h"
-#include <unistd.h>
 
 // Tick = 10ms → 1 tick = 10 milliseconds
 #define TICK_MS 10
@@ -11,16 +9,12 @@
 // Utility functions
 static INT32U GetSystemTick()
 {
-    struct timeval tv;
-    gettimeofday(&tv, nullptr);
-    return (tv.tv_sec * 1000 + tv.tv_usec / 1000) / TICK_MS;
+    return (INT32U)(GetClockSource().GetNowUs() / 1000 / TICK_MS);
 }
 
 static INT32U GetSystemTickUs()
 {
-    struct timeval tv;
-    gettimeofday(&tv, nullptr);
-    return (tv.tv_sec * 1000000 + tv.tv_usec);
+    return (INT32U)GetClockSource().GetNowUs();
 }
 
 //
@@ -125,7 +119,8 @@ void CTimeDelta::WaitTimeElapsed()
 {
     while (!IsTimeExpired())
     {
-        // optionally sleep here for efficiency
+        // Sleeping lets a virtual clock advance instead of spinning forever.
+        OSTimeDly(1);
     }
 }
 
@@ -164,10 +159,9 @@ CTimeDeltaUs::CTimeDeltaUs(INT16U deltaTimeUs)
 
 void CTimeDeltaUs::GetTickCountUs(INT32U* pSeconds, INT32U* pUSeconds)
 {
-    struct timeval tv;
-    gettimeofday(&tv, nullptr);
-    if (pSeconds) *pSeconds = tv.tv_sec;
-    if (pUSeconds) *pUSeconds = tv.tv_usec;
+    uint64_t nowUs = GetClockSource().GetNowUs();
+    if (pSeconds) *pSeconds = (INT32U)(nowUs / 1000000);
+    if (pUSeconds) *pUSeconds = (INT32U)(nowUs % 1000000);
 }
 
 void CTimeDeltaUs::GetTickCountUsAdjusted(INT32U* pSeconds, INT32U* pUSeconds)
@@ -226,7 +220,5 @@ BOOLEAN CTimeDeltaUs::IsTimeExpired()
 void OSTimeDly(uint32_t ticks)
 {
     // Sleep for the specified number of ticks (10ms each)
-    // This is a placeholder implementation; replace with actual sleep function
-    // For example, use usleep or nanosleep in a real implementation
-    usleep((ticks) * 10000);
+    GetClockSource().SleepUs((uint64_t)ticks * TICK_MS * 1000);
 }
\ No newline at end of file
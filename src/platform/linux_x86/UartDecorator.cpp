@@ -0,0 +1,95 @@
+#include "UartDecorator.h"
+
+#include <string.h>
+
+CUartDecorator::CUartDecorator(shared_ptr<IUart> pUart) : IUart(0), m_pUart(pUart)
+{
+}
+
+ERROR_CODE_T CUartDecorator::Open(BAUDRATE baud, BYTE_SIZE byteSize, PARITY parity, STOP_BITS stopBits)
+{
+    return m_pUart->Open(baud, byteSize, parity, stopBits);
+}
+
+ERROR_CODE_T CUartDecorator::Close()
+{
+    return m_pUart->Close();
+}
+
+INT32U CUartDecorator::RxBytesAvailable()
+{
+    return m_pUart->RxBytesAvailable();
+}
+
+void CUartDecorator::WriteString(const CHAR8 *pString)
+{
+    INT32U written;
+    WritePort(reinterpret_cast<const INT8U *>(pString), strlen(pString), &written);
+}
+
+void CUartDecorator::WriteByte(INT8U byte)
+{
+    INT32U written;
+    WritePort(&byte, 1, &written);
+}
+
+void CUartDecorator::WriteWord(INT16U word)
+{
+    INT8U buf[2] = {static_cast<INT8U>(word & 0xFF), static_cast<INT8U>((word >> 8) & 0xFF)};
+    INT32U written;
+    WritePort(buf, 2, &written);
+}
+
+void CUartDecorator::WriteDWord(INT32U dword)
+{
+    INT8U buf[4] = {
+        static_cast<INT8U>(dword & 0xFF),
+        static_cast<INT8U>((dword >> 8) & 0xFF),
+        static_cast<INT8U>((dword >> 16) & 0xFF),
+        static_cast<INT8U>((dword >> 24) & 0xFF)};
+    INT32U written;
+    WritePort(buf, 4, &written);
+}
+
+BOOLEAN CUartDecorator::ReadByte(INT8U *pByte)
+{
+    INT32U read = 0;
+    ReadPort(pByte, 1, &read);
+    return read == 1;
+}
+
+BOOLEAN CUartDecorator::ReadWord(INT16U *pWord)
+{
+    INT8U buf[2];
+    INT32U read = 0;
+    ReadPort(buf, 2, &read);
+    if (read == 2)
+    {
+        *pWord = buf[0] | (buf[1] << 8);
+        return true;
+    }
+    return false;
+}
+
+BOOLEAN CUartDecorator::ReadDWord(INT32U *pDWord)
+{
+    INT8U buf[4];
+    INT32U read = 0;
+    ReadPort(buf, 4, &read);
+    if (read == 4)
+    {
+        *pDWord = buf[0] | (buf[1] << 8) | (buf[2] << 16) | (buf[3] << 24);
+        return true;
+    }
+    return false;
+}
+
+void CUartDecorator::WritePort(const INT8U *pBuf, INT32U bytesToWrite, INT32U *pBytesWritten)
+{
+    m_pUart->WritePort(pBuf, bytesToWrite, pBytesWritten);
+}
+
+void CUartDecorator::ReadPort(INT8U *pBuf, INT32U maxBytes, INT32U *pBytesRead)
+{
+    m_pUart->ReadPort(pBuf, maxBytes, pBytesRead);
+}
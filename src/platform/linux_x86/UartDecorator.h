@@ -0,0 +1,34 @@
+#pragma once
+
+#include <memory>
+
+#include "interfaces/iuart.h"
+#include "types.h"
+
+using namespace std;
+
+// Base for IUart decorators. Open, Close, RxBytesAvailable and the two port
+// calls forward to the wrapped UART; the string, byte, word and dword calls
+// go through this object's WritePort and ReadPort, so a decorator only
+// overrides those to see every byte in either direction.
+class CUartDecorator : public IUart
+{
+  public:
+    CUartDecorator(shared_ptr<IUart> pUart);
+
+    ERROR_CODE_T Open(BAUDRATE baud, BYTE_SIZE byteSize, PARITY parity, STOP_BITS stopBits) override;
+    ERROR_CODE_T Close() override;
+    INT32U RxBytesAvailable() override;
+    void WriteString(const CHAR8 *pString) override;
+    void WriteByte(INT8U byte) override;
+    void WriteWord(INT16U word) override;
+    void WriteDWord(INT32U dword) override;
+    BOOLEAN ReadByte(INT8U *pByte) override;
+    BOOLEAN ReadWord(INT16U *pWord) override;
+    BOOLEAN ReadDWord(INT32U *pDWord) override;
+    void WritePort(const INT8U *pBuf, INT32U bytesToWrite, INT32U *pBytesWritten) override;
+    void ReadPort(INT8U *pBuf, INT32U maxBytes, INT32U *pBytesRead) override;
+
+  protected:
+    shared_ptr<IUart> m_pUart;
+};
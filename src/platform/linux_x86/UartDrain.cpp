@@ -0,0 +1,98 @@
+#include "UartDrain.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "ClockSource.h"
+
+#define UART_BITS_PER_CHAR 10
+#define UART_DRAIN_CHUNK 256
+// FIONREAD on USB-serial adapters only updates once the adapter flushes its
+// own buffer, which happens at least every few milliseconds.
+#define UART_DRAIN_MIN_QUIET_US 2000
+
+INT32U UartBaudRateToBps(BAUDRATE baud)
+{
+    switch (baud)
+    {
+        case BAUDRATE_9600:
+            return 9600;
+        case BAUDRATE_19200:
+            return 19200;
+        case BAUDRATE_38400:
+            return 38400;
+        case BAUDRATE_57600:
+            return 57600;
+        case BAUDRATE_115200:
+            return 115200;
+        case BAUDRATE_230400:
+            return 230400;
+        case BAUDRATE_460800:
+            return 460800;
+        case BAUDRATE_921600:
+            return 921600;
+        default:
+            return 0;
+    }
+}
+
+INT32U UartCharTimeUs(BAUDRATE baud)
+{
+    INT32U bps = UartBaudRateToBps(baud);
+    if (bps == 0)
+    {
+        // Assume the slowest rate we support so the drain errs on the safe side.
+        bps = 9600;
+    }
+
+    return (UART_BITS_PER_CHAR * 1000000 + bps - 1) / bps;
+}
+
+ERROR_CODE_T UartDrainUntilQuiet(IUart *pUart, BAUDRATE baud, INT32U maxTimeoutMS, INT32U quietCharTimes, INT32U *pBytesDrained)
+{
+    RETURN_EC_IF_NULL(ERROR_INVALID_PARAMETER, pUart);
+
+    INT32U quietUs = UartCharTimeUs(baud) * (quietCharTimes == 0 ? 1 : quietCharTimes);
+    if (quietUs < UART_DRAIN_MIN_QUIET_US)
+        quietUs = UART_DRAIN_MIN_QUIET_US;
+
+    // Poll a few times per quiet window so we notice the gap promptly.
+    INT32U pollUs = quietUs / 4;
+
+    // Timed in microseconds: CTimeDelta counts 10 ms ticks, which would
+    // turn any timeout below one tick into no drain at all.
+    IClockSource &clock = GetClockSource();
+    uint64_t nowUs = clock.GetNowUs();
+    uint64_t deadlineUs = nowUs + (uint64_t)maxTimeoutMS * 1000;
+    uint64_t quietSinceUs = nowUs;
+
+    INT32U drained = 0;
+    INT8U buf[UART_DRAIN_CHUNK];
+    while (nowUs < deadlineUs)
+    {
+        INT32U available = pUart->RxBytesAvailable();
+        if (available > 0)
+        {
+            INT32U bytesRead = 0;
+            pUart->ReadPort(buf, (available < sizeof(buf)) ? available : sizeof(buf), &bytesRead);
+            drained += bytesRead;
+            nowUs = clock.GetNowUs();
+            quietSinceUs = nowUs;
+            continue;
+        }
+
+        if (nowUs - quietSinceUs >= quietUs)
+            break;
+
+        // Never sleep past the caller's bound.
+        clock.SleepUs(min((uint64_t)pollUs, deadlineUs - nowUs));
+        nowUs = clock.GetNowUs();
+    }
+
+    if (pBytesDrained != NULL)
+        *pBytesDrained = drained;
+
+    return STATUS_SUCCESS;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "interfaces/iuart.h"
+#include "types.h"
+
+// Default number of character times the line must stay quiet before a drain
+// is considered complete.
+#define UART_DRAIN_DEFAULT_QUIET_CHARS 16
+
+// Returns the line rate in bits per second for a BAUDRATE, 0 if unknown.
+INT32U UartBaudRateToBps(BAUDRATE baud);
+
+// Returns the time one 10-bit character (start + 8 data + stop) takes on the
+// wire, in microseconds.
+INT32U UartCharTimeUs(BAUDRATE baud);
+
+// Discards received bytes until the line has been quiet for quietCharTimes
+// character times, or until maxTimeoutMS has passed, whichever comes first.
+// Uses RxBytesAvailable (FIONREAD) so it never blocks in a read while idle.
+ERROR_CODE_T UartDrainUntilQuiet(IUart *pUart, BAUDRATE baud, INT32U maxTimeoutMS, INT32U quietCharTimes = UART_DRAIN_DEFAULT_QUIET_CHARS, INT32U *pBytesDrained = NULL);
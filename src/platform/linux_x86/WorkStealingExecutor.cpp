@@ -0,0 +1,423 @@
+#include "WorkStealingExecutor.h"
+
+#include <chrono>
+
+#include "ClockSource.h"
+
+// Tasks a strand runs before yielding its worker to other strands.
+#define STRAND_BATCH_SIZE 16
+
+// Upper bound on how long an idle worker sleeps before looking for work to
+// steal again.
+#define EXECUTOR_IDLE_WAIT_MS 50
+
+static thread_local CWorkStealingExecutor *t_pCurrentExecutor = NULL;
+static thread_local INT32U t_currentWorker = 0;
+
+static uint64_t GetNowUs(void)
+{
+    return GetClockSource().GetNowUs();
+}
+
+CWorkStealingExecutor::CWorkStealingExecutor(INT32U numThreads)
+    : m_numThreads(numThreads), m_running(false), m_runCount(0), m_nextWorker(0), m_queuedCount(0), m_stealCount(0),
+      m_timerSequence(0)
+{
+    if (m_numThreads == 0)
+    {
+        m_numThreads = thread::hardware_concurrency();
+    }
+    if (m_numThreads == 0)
+    {
+        m_numThreads = 2;
+    }
+
+    for (INT32U i = 0; i < m_numThreads; i++)
+    {
+        m_workers.push_back(unique_ptr<Worker>(new Worker()));
+    }
+}
+
+CWorkStealingExecutor::~CWorkStealingExecutor()
+{
+    Stop();
+}
+
+ERROR_CODE_T CWorkStealingExecutor::Start(void)
+{
+    RETURN_EC_IF_TRUE(ERROR_FAILED, m_running.exchange(true));
+    m_runCount++;
+
+    for (INT32U i = 0; i < m_numThreads; i++)
+    {
+        m_workers[i]->worker = thread(&CWorkStealingExecutor::WorkerLoop, this, i);
+    }
+    m_timerThread = thread(&CWorkStealingExecutor::TimerLoop, this);
+    return STATUS_SUCCESS;
+}
+
+void CWorkStealingExecutor::Stop(void)
+{
+    if (!m_running.exchange(false))
+        return;
+
+    {
+        lock_guard<mutex> idleGuard(m_idleLock);
+        m_idleWake.notify_all();
+    }
+    {
+        lock_guard<mutex> timerGuard(m_timerLock);
+        m_timerWake.notify_all();
+    }
+
+    for (INT32U i = 0; i < m_numThreads; i++)
+    {
+        if (m_workers[i]->worker.joinable())
+        {
+            m_workers[i]->worker.join();
+        }
+    }
+    if (m_timerThread.joinable())
+    {
+        m_timerThread.join();
+    }
+
+    // SubmitBlocking checks m_running under this lock, so nothing is added
+    // once the list has been taken.
+    vector<BlockingThread> blockingThreads;
+    {
+        lock_guard<mutex> guard(m_blockingLock);
+        blockingThreads.swap(m_blockingThreads);
+    }
+    for (size_t i = 0; i < blockingThreads.size(); i++)
+    {
+        blockingThreads[i].worker.join();
+    }
+
+    for (INT32U i = 0; i < m_numThreads; i++)
+    {
+        lock_guard<mutex> guard(m_workers[i]->lock);
+        m_workers[i]->tasks.clear();
+    }
+    m_queuedCount = 0;
+
+    lock_guard<mutex> timerGuard(m_timerLock);
+    m_timers = priority_queue<TimerEntry>();
+}
+
+bool CWorkStealingExecutor::IsRunning(void) const
+{
+    return m_running;
+}
+
+INT32U CWorkStealingExecutor::GetRunCount(void) const
+{
+    return m_runCount;
+}
+
+ERROR_CODE_T CWorkStealingExecutor::Submit(ExecutorTask task)
+{
+    RETURN_EC_IF_TRUE(ERROR_INVALID_PARAMETER, !task);
+    RETURN_EC_IF_FALSE(ERROR_NOT_INITIALIZED, m_running);
+
+    // Work spawned by a task stays on its worker's deque, where it is
+    // cache-warm and cheapest to reach; anything else is dealt round-robin.
+    if (t_pCurrentExecutor == this)
+    {
+        Enqueue(t_currentWorker, task);
+    }
+    else
+    {
+        Enqueue(m_nextWorker.fetch_add(1) % m_numThreads, task);
+    }
+    return STATUS_SUCCESS;
+}
+
+ERROR_CODE_T CWorkStealingExecutor::SubmitAfter(INT32U delayMS, ExecutorTask task)
+{
+    RETURN_EC_IF_TRUE(ERROR_INVALID_PARAMETER, !task);
+    RETURN_EC_IF_FALSE(ERROR_NOT_INITIALIZED, m_running);
+
+    if (delayMS == 0)
+        return Submit(task);
+
+    TimerEntry entry;
+    entry.dueUs = GetNowUs() + (uint64_t)delayMS * 1000;
+    entry.task = task;
+
+    lock_guard<mutex> guard(m_timerLock);
+    entry.sequence = m_timerSequence++;
+    bool isEarliest = m_timers.empty() || entry.dueUs < m_timers.top().dueUs;
+    m_timers.push(entry);
+    if (isEarliest)
+    {
+        m_timerWake.notify_one();
+    }
+    return STATUS_SUCCESS;
+}
+
+ERROR_CODE_T CWorkStealingExecutor::SubmitBlocking(ExecutorTask task)
+{
+    RETURN_EC_IF_TRUE(ERROR_INVALID_PARAMETER, !task);
+
+    lock_guard<mutex> guard(m_blockingLock);
+    RETURN_EC_IF_FALSE(ERROR_NOT_INITIALIZED, m_running);
+
+    // Reap the ones that have finished so the list only holds live threads.
+    vector<BlockingThread>::iterator iter = m_blockingThreads.begin();
+    while (iter != m_blockingThreads.end())
+    {
+        if (*iter->pDone)
+        {
+            iter->worker.join();
+            iter = m_blockingThreads.erase(iter);
+        }
+        else
+        {
+            ++iter;
+        }
+    }
+
+    BlockingThread blocking;
+    blocking.pDone = make_shared<atomic<bool> >(false);
+    shared_ptr<atomic<bool> > pDone = blocking.pDone;
+    blocking.worker = thread([task, pDone]() {
+        task();
+        *pDone = true;
+    });
+    m_blockingThreads.push_back(move(blocking));
+    return STATUS_SUCCESS;
+}
+
+INT32U CWorkStealingExecutor::GetThreadCount(void) const
+{
+    return m_numThreads;
+}
+
+INT32U CWorkStealingExecutor::GetStealCount(void) const
+{
+    return m_stealCount;
+}
+
+void CWorkStealingExecutor::Enqueue(INT32U workerIndex, const ExecutorTask &task)
+{
+    {
+        Worker &worker = *m_workers[workerIndex];
+        lock_guard<mutex> guard(worker.lock);
+        worker.tasks.push_back(task);
+    }
+
+    m_queuedCount++;
+    // Taking the idle lock orders this wake after a worker's last check of
+    // m_queuedCount, so the wake can't be lost.
+    lock_guard<mutex> idleGuard(m_idleLock);
+    m_idleWake.notify_one();
+}
+
+bool CWorkStealingExecutor::TryTake(INT32U workerIndex, ExecutorTask &taskOut)
+{
+    {
+        Worker &own = *m_workers[workerIndex];
+        lock_guard<mutex> guard(own.lock);
+        if (!own.tasks.empty())
+        {
+            taskOut = own.tasks.back();
+            own.tasks.pop_back();
+            m_queuedCount--;
+            return true;
+        }
+    }
+
+    // Steal the oldest task from the next worker that has one.
+    for (INT32U offset = 1; offset < m_numThreads; offset++)
+    {
+        Worker &victim = *m_workers[(workerIndex + offset) % m_numThreads];
+        lock_guard<mutex> guard(victim.lock);
+        if (!victim.tasks.empty())
+        {
+            taskOut = victim.tasks.front();
+            victim.tasks.pop_front();
+            m_queuedCount--;
+            m_stealCount++;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void CWorkStealingExecutor::WorkerLoop(INT32U workerIndex)
+{
+    t_pCurrentExecutor = this;
+    t_currentWorker = workerIndex;
+
+    while (m_running)
+    {
+        ExecutorTask task;
+        if (TryTake(workerIndex, task))
+        {
+            task();
+            continue;
+        }
+
+        unique_lock<mutex> idleGuard(m_idleLock);
+        m_idleWake.wait_for(idleGuard, chrono::milliseconds(EXECUTOR_IDLE_WAIT_MS),
+                            [this] { return !m_running || m_queuedCount != 0; });
+    }
+
+    t_pCurrentExecutor = NULL;
+}
+
+void CWorkStealingExecutor::TimerLoop(void)
+{
+    unique_lock<mutex> guard(m_timerLock);
+    while (m_running)
+    {
+        if (m_timers.empty())
+        {
+            m_timerWake.wait(guard);
+            continue;
+        }
+
+        uint64_t nowUs = GetNowUs();
+        if (m_timers.top().dueUs > nowUs)
+        {
+            // Capped, since an installed test clock can be advanced without
+            // anything waking this thread.
+            uint64_t waitUs = m_timers.top().dueUs - nowUs;
+            if (waitUs > EXECUTOR_IDLE_WAIT_MS * 1000)
+            {
+                waitUs = EXECUTOR_IDLE_WAIT_MS * 1000;
+            }
+            m_timerWake.wait_for(guard, chrono::microseconds(waitUs));
+            continue;
+        }
+
+        ExecutorTask task = m_timers.top().task;
+        m_timers.pop();
+
+        guard.unlock();
+        Enqueue(m_nextWorker.fetch_add(1) % m_numThreads, task);
+        guard.lock();
+    }
+}
+
+CExecutorStrand::CExecutorStrand(CWorkStealingExecutor *pExecutor)
+    : m_pExecutor(pExecutor), m_scheduled(false), m_run(0)
+{
+}
+
+ERROR_CODE_T CExecutorStrand::Post(ExecutorTask task)
+{
+    return Enqueue(task, false);
+}
+
+ERROR_CODE_T CExecutorStrand::PostAfter(INT32U delayMS, ExecutorTask task)
+{
+    RETURN_EC_IF_TRUE(ERROR_INVALID_PARAMETER, !task);
+    RETURN_EC_IF_NULL(ERROR_NOT_INITIALIZED, m_pExecutor);
+
+    weak_ptr<CExecutorStrand> pWeakSelf = shared_from_this();
+    return m_pExecutor->SubmitAfter(delayMS, [pWeakSelf, task]() {
+        shared_ptr<CExecutorStrand> pSelf = pWeakSelf.lock();
+        if (pSelf)
+        {
+            pSelf->Post(task);
+        }
+    });
+}
+
+ERROR_CODE_T CExecutorStrand::PostBlocking(ExecutorTask task)
+{
+    return Enqueue(task, true);
+}
+
+ERROR_CODE_T CExecutorStrand::Enqueue(ExecutorTask task, bool blocking)
+{
+    RETURN_EC_IF_TRUE(ERROR_INVALID_PARAMETER, !task);
+    RETURN_EC_IF_NULL(ERROR_NOT_INITIALIZED, m_pExecutor);
+
+    lock_guard<mutex> guard(m_lock);
+    INT32U run = m_pExecutor->GetRunCount();
+    if (run != m_run)
+    {
+        // The executor has been stopped since these were queued, and the
+        // drain that would have run them went with it.
+        m_tasks.clear();
+        m_scheduled = false;
+        m_run = run;
+    }
+
+    StrandTask entry;
+    entry.task = task;
+    entry.blocking = blocking;
+    m_tasks.push_back(entry);
+    if (m_scheduled)
+        return STATUS_SUCCESS;
+
+    ERROR_CODE_T result = ScheduleDrain();
+    if (FAILED(result))
+    {
+        m_tasks.pop_back();
+    }
+    return result;
+}
+
+ERROR_CODE_T CExecutorStrand::ScheduleDrain(void)
+{
+    shared_ptr<CExecutorStrand> pSelf = shared_from_this();
+    ERROR_CODE_T result = m_pExecutor->Submit([pSelf]() { pSelf->Drain(); });
+    m_scheduled = SUCCEEDED(result);
+    return result;
+}
+
+void CExecutorStrand::Drain(void)
+{
+    for (INT32U i = 0; i < STRAND_BATCH_SIZE; i++)
+    {
+        StrandTask entry;
+        {
+            lock_guard<mutex> guard(m_lock);
+            if (m_tasks.empty())
+            {
+                m_scheduled = false;
+                return;
+            }
+            entry = m_tasks.front();
+            m_tasks.pop_front();
+        }
+
+        if (entry.blocking)
+        {
+            // The strand stays scheduled, so later tasks queue up behind this
+            // one until it returns and reschedules them.
+            shared_ptr<CExecutorStrand> pSelf = shared_from_this();
+            ExecutorTask task = entry.task;
+            if (FAILED(m_pExecutor->SubmitBlocking([pSelf, task]() {
+                    task();
+                    pSelf->Reschedule();
+                })))
+            {
+                lock_guard<mutex> guard(m_lock);
+                m_scheduled = false;
+            }
+            return;
+        }
+
+        entry.task();
+    }
+
+    // Still busy: requeue behind other strands instead of hogging the worker.
+    Reschedule();
+}
+
+void CExecutorStrand::Reschedule(void)
+{
+    lock_guard<mutex> guard(m_lock);
+    if (m_tasks.empty())
+    {
+        m_scheduled = false;
+        return;
+    }
+    ScheduleDrain();
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "types.h"
+
+using namespace std;
+
+typedef function<void(void)> ExecutorTask;
+
+// Fixed pool of workers, one deque each. A worker pushes and pops its own
+// work at the back and, when it runs dry, steals from the front of the
+// others, so bursts on one card spread across the pool without a shared
+// queue becoming the bottleneck. Tasks submitted from outside the pool are
+// dealt round-robin. Delayed tasks are held by a single timer thread until
+// they are due.
+class CWorkStealingExecutor
+{
+  public:
+    // numThreads of 0 sizes the pool to the machine.
+    CWorkStealingExecutor(INT32U numThreads = 0);
+    ~CWorkStealingExecutor();
+
+    ERROR_CODE_T Start(void);
+
+    // Stops the workers once their current tasks return and waits for
+    // blocking tasks to finish; queued tasks are dropped.
+    void Stop(void);
+    bool IsRunning(void) const;
+    // Changes on every Start, so work queued before a Stop can tell it was
+    // dropped.
+    INT32U GetRunCount(void) const;
+
+    ERROR_CODE_T Submit(ExecutorTask task);
+    ERROR_CODE_T SubmitAfter(INT32U delayMS, ExecutorTask task);
+    // Runs a task that may block for a long time, such as serial setup, on
+    // a thread of its own so it doesn't keep a worker from other cards.
+    ERROR_CODE_T SubmitBlocking(ExecutorTask task);
+
+    INT32U GetThreadCount(void) const;
+    INT32U GetStealCount(void) const;
+
+  private:
+    CWorkStealingExecutor(const CWorkStealingExecutor &);
+    CWorkStealingExecutor &operator=(const CWorkStealingExecutor &);
+
+    struct Worker
+    {
+        mutex lock;
+        deque<ExecutorTask> tasks;
+        thread worker;
+    };
+
+    struct TimerEntry
+    {
+        uint64_t dueUs;
+        INT32U sequence;
+        ExecutorTask task;
+
+        bool operator<(const TimerEntry &other) const
+        {
+            // priority_queue keeps the largest on top; invert for earliest.
+            if (dueUs != other.dueUs)
+                return dueUs > other.dueUs;
+            return sequence > other.sequence;
+        }
+    };
+
+    void Enqueue(INT32U workerIndex, const ExecutorTask &task);
+    bool TryTake(INT32U workerIndex, ExecutorTask &taskOut);
+    void WorkerLoop(INT32U workerIndex);
+    void TimerLoop(void);
+
+    INT32U m_numThreads;
+    vector<unique_ptr<Worker> > m_workers;
+    atomic<bool> m_running;
+    atomic<INT32U> m_runCount;
+    atomic<INT32U> m_nextWorker;
+    atomic<INT32U> m_queuedCount;
+    atomic<INT32U> m_stealCount;
+
+    mutex m_idleLock;
+    condition_variable m_idleWake;
+
+    mutex m_timerLock;
+    condition_variable m_timerWake;
+    priority_queue<TimerEntry> m_timers;
+    INT32U m_timerSequence;
+    thread m_timerThread;
+
+    struct BlockingThread
+    {
+        thread worker;
+        shared_ptr<atomic<bool> > pDone;
+    };
+
+    mutex m_blockingLock;
+    vector<BlockingThread> m_blockingThreads;
+};
+
+// Runs posted tasks one at a time and in order on an executor, without
+// tying them to a thread. Use one per card so its state machine never runs
+// concurrently with itself.
+class CExecutorStrand : public enable_shared_from_this<CExecutorStrand>
+{
+  public:
+    CExecutorStrand(CWorkStealingExecutor *pExecutor);
+
+    ERROR_CODE_T Post(ExecutorTask task);
+    ERROR_CODE_T PostAfter(INT32U delayMS, ExecutorTask task);
+    // In order with the strand's other tasks, but run through
+    // SubmitBlocking; later tasks wait until it returns.
+    ERROR_CODE_T PostBlocking(ExecutorTask task);
+
+  private:
+    struct StrandTask
+    {
+        ExecutorTask task;
+        bool blocking;
+    };
+
+    ERROR_CODE_T Enqueue(ExecutorTask task, bool blocking);
+    // Called with m_lock held.
+    ERROR_CODE_T ScheduleDrain(void);
+    void Drain(void);
+    // Hands the worker back after a batch or a blocking task.
+    void Reschedule(void);
+
+    CWorkStealingExecutor *m_pExecutor;
+    mutex m_lock;
+    deque<StrandTask> m_tasks;
+    bool m_scheduled;
+    // Executor run the queued tasks belong to; Stop drops them.
+    INT32U m_run;
+};
@@ -9,6 +9,7 @@
 #endif
 
 #include "CriticalSection.h"
+#include "Profiler.h"
 #include "types.h"
 #include <list>
 
@@ -136,6 +137,7 @@ public:
   }
 
   void notifyObservers(T eventInfo) {
+    PROFILE_ZONE("notify_observers");
     concurrent_dispatcher_count++;
     typename list<weak_ptr<IObserverHandle<T>>>::iterator iter;
     for (iter = observers.begin(); iter != observers.end(); iter++) {
@@ -215,6 +217,7 @@ public:
   }
 
   void notifyObservers(void) {
+    PROFILE_ZONE("notify_observers");
     concurrent_dispatcher_count++;
     list<weak_ptr<IObserverHandle<void>>>::iterator iter;
     for (iter = observers.begin(); iter != observers.end(); iter++) {
@@ -52,6 +52,7 @@ using namespace std;
 #define ERROR_INVALID_CONFIGURATION -14
 #define ERROR_INVALID_HANDLE -15
 #define OS_ERR_TIMEOUT -16
+#define ERROR_OPERATION_CANCELLED -17
 
 #define __FILENAME__                                                           \
   (strrchr(__FILE__, '/') ? strrchr(__FILE__, '/') + 1 : __FILE__)
@@ -63,8 +64,9 @@ using namespace std;
   do {                                                                         \
     ERROR_CODE_T _e = (ec);                                                    \
     if (_e != STATUS_SUCCESS) {                                                \
-      printf("RETURN_IF_FAILED: %s:%d -> error code: %d\n", __FILENAME__,      \
-             __LINE__, _e);                                                    \
+      LogPrintf(DEBUG_NORMAL_ERROR, "RETURN",                                  \
+                "RETURN_IF_FAILED: %s:%d -> error code: %d\n", __FILENAME__,   \
+                __LINE__, _e);                                                 \
       return _e;                                                               \
     }                                                                          \
   } while (0)
@@ -72,8 +74,9 @@ using namespace std;
 #define RETURN_EC_IF_TRUE(ec, condition)                                       \
   do {                                                                         \
     if (condition) {                                                           \
-      printf("RETURN_EC_IF_TRUE: %s:%d -> condition true, returning %d\n",     \
-             __FILENAME__, __LINE__, (ec));                                    \
+      LogPrintf(DEBUG_NORMAL_ERROR, "RETURN",                                  \
+                "RETURN_EC_IF_TRUE: %s:%d -> condition true, returning %d\n",  \
+                __FILENAME__, __LINE__, (ec));                                 \
       return (ec);                                                             \
     }                                                                          \
   } while (0)
@@ -81,8 +84,9 @@ using namespace std;
 #define RETURN_EC_IF_FALSE(ec, condition)                                      \
   do {                                                                         \
     if (!(condition)) {                                                        \
-      printf("RETURN_EC_IF_FALSE: %s:%d -> condition false, returning %d\n",   \
-             __FILENAME__, __LINE__, (ec));                                    \
+      LogPrintf(DEBUG_NORMAL_ERROR, "RETURN",                                  \
+                "RETURN_EC_IF_FALSE: %s:%d -> condition false, returning %d\n", \
+                __FILENAME__, __LINE__, (ec));                                 \
       return (ec);                                                             \
     }                                                                          \
   } while (0)
@@ -90,8 +94,9 @@ using namespace std;
 #define RETURN_EC_IF_NULL(ec, ptr)                                             \
   do {                                                                         \
     if ((ptr) == NULL) {                                                       \
-      printf("RETURN_EC_IF_NULL: %s:%d -> null pointer, returning %d\n",       \
-             __FILENAME__, __LINE__, (ec));                                    \
+      LogPrintf(DEBUG_NORMAL_ERROR, "RETURN",                                  \
+                "RETURN_EC_IF_NULL: %s:%d -> null pointer, returning %d\n",    \
+                __FILENAME__, __LINE__, (ec));                                 \
       return (ec);                                                             \
     }                                                                          \
   } while (0)
@@ -99,8 +104,9 @@ using namespace std;
 #define RETURN_EC_IF_FAILED(ec)                                                \
   do {                                                                         \
     if ((ec) != STATUS_SUCCESS) {                                              \
-      printf("RETURN_EC_IF_FAILED: %s:%d -> failed with %d\n", __FILENAME__,   \
-             __LINE__, (ec));                                                  \
+      LogPrintf(DEBUG_NORMAL_ERROR, "RETURN",                                  \
+                "RETURN_EC_IF_FAILED: %s:%d -> failed with %d\n", __FILENAME__, \
+                __LINE__, (ec));                                               \
       return (ec);                                                             \
     }                                                                          \
   } while (0)
@@ -108,8 +114,9 @@ using namespace std;
 #define RETURN_NULL_IF_FAILED(ec)                                              \
   do {                                                                         \
     if ((ec) != STATUS_SUCCESS) {                                              \
-      printf("RETURN_EC_IF_FAILED: %s:%d -> failed with %d\n", __FILENAME__,   \
-             __LINE__, (ec));                                                  \
+      LogPrintf(DEBUG_NORMAL_ERROR, "RETURN",                                  \
+                "RETURN_EC_IF_FAILED: %s:%d -> failed with %d\n", __FILENAME__, \
+                __LINE__, (ec));                                               \
       return NULL;                                                             \
     }                                                                          \
   } while (0)
@@ -117,8 +124,9 @@ using namespace std;
 #define RETURN_NULL_IF_TRUE(check)                                             \
   do {                                                                         \
     if (check) {                                                               \
-      printf("RETURN_EC_IF_FAILED: %s:%d -> is not true when expected\n",      \
-             __FILENAME__, __LINE__);                                          \
+      LogPrintf(DEBUG_NORMAL_ERROR, "RETURN",                                  \
+                "RETURN_EC_IF_FAILED: %s:%d -> is not true when expected\n",   \
+                __FILENAME__, __LINE__);                                       \
       return NULL;                                                             \
     }                                                                          \
   } while (0)
@@ -126,8 +134,9 @@ using namespace std;
 #define RETURN_NULL_IF_NULL(check)                                             \
   do {                                                                         \
     if (check == NULL) {                                                       \
-      printf("RETURN_NULL_IF_NULL: %s:%d -> failed\n", __FILENAME__,           \
-             __LINE__);                                                        \
+      LogPrintf(DEBUG_NORMAL_ERROR, "RETURN",                                  \
+                "RETURN_NULL_IF_NULL: %s:%d -> failed\n", __FILENAME__,        \
+                __LINE__);                                                     \
       return NULL;                                                             \
     }                                                                          \
   } while (0)
@@ -135,8 +144,9 @@ using namespace std;
 #define RETURN_BOOL_IF_FALSE(ret, check)                                       \
   do {                                                                         \
     if (!(check)) {                                                            \
-      printf("RETURN_BOOL_IF_FALSE: %s:%d -> failed\n", __FILENAME__,          \
-             __LINE__);                                                        \
+      LogPrintf(DEBUG_NORMAL_ERROR, "RETURN",                                  \
+                "RETURN_BOOL_IF_FALSE: %s:%d -> failed\n", __FILENAME__,       \
+                __LINE__);                                                     \
       return ret;                                                              \
     }                                                                          \
   } while (0)
@@ -153,11 +163,16 @@ using namespace std;
 #define DEBUG_TRACE 6
 
 // Printing
+// verbosity is the caller's own level (e.g. the packet verbosity), so a
+// message is only captured when logLevel is within it.
 #define DebugPrintf(verbosity, logLevel, debugID, format, ...)                 \
   do {                                                                         \
-    if ((verbosity) >= (0)) {                                                  \
-      printf(format, ##__VA_ARGS__);                                           \
+    if ((logLevel) != DEBUG_NO_LOGGING && (logLevel) <= (verbosity)) {         \
+      CBinaryLog::Write((logLevel), (debugID), format, ##__VA_ARGS__);         \
     }                                                                          \
   } while (0)
 
 typedef enum { TS_FALSE, TS_TRUE, TS_AUTO } TRI_STATE_T;
+
+// Logging backend used by the macros above.
+#include "BinaryLog.h"
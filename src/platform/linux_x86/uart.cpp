@@ -8,6 +8,7 @@
 #include <termios.h>
 #include <unistd.h>
 
+#include "Profiler.h"
 #include "uart.h"
 
 CuArt::CuArt(INT32U PortNumber)
@@ -34,7 +35,7 @@ ERROR_CODE_T CuArt::Open(BAUDRATE Baud, BYTE_SIZE ByteSize, PARITY Parity, STOP_
     m_Fd = open(devPath.str().c_str(), O_RDWR | O_NOCTTY | O_NDELAY);
     if (m_Fd < 0)
     {
-        printf("Failed to open UART port %s: %s\n", devPath.str().c_str(), strerror(errno));
+        LogPrintf(DEBUG_NORMAL_ERROR, "uart", "Failed to open UART port %s: %s\n", devPath.str().c_str(), strerror(errno));
         return ERROR_FAILED;
     }
 
@@ -198,6 +199,7 @@ BOOLEAN CuArt::ReadDWord(INT32U *pDWord)
 
 void CuArt::WritePort(const INT8U *pBuf, INT32U BytesToWrite, INT32U *pBytesWritten)
 {
+    PROFILE_ZONE("uart_write");
     ssize_t result = write(m_Fd, pBuf, BytesToWrite);
     if (pBytesWritten != NULL)
     {
@@ -207,6 +209,7 @@ void CuArt::WritePort(const INT8U *pBuf, INT32U BytesToWrite, INT32U *pBytesWrit
 
 void CuArt::ReadPort(INT8U *pBuf, INT32U MaxBytes, INT32U *pBytesRead)
 {
+    PROFILE_ZONE("uart_read");
     ssize_t result = read(m_Fd, pBuf, MaxBytes);
     if (pBytesRead != NULL)
     {
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <string>
+
+// Serial device the current test process talks to, from --device.
+const std::string &GetDeviceUnderTest(void);
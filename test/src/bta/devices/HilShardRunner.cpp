@@ -0,0 +1,343 @@
+#include "HilShardRunner.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <thread>
+
+extern char **environ;
+
+static uint64_t HilGetNowMS(void)
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (uint64_t)now.tv_sec * 1000 + now.tv_usec / 1000;
+}
+
+// "/dev/ttyUSB0" -> "ttyUSB0", used to tag suites and name files.
+static string HilDeviceName(const string &device)
+{
+    size_t slash = device.find_last_of('/');
+    return (slash == string::npos) ? device : device.substr(slash + 1);
+}
+
+static INT32U HilReadAttribute(const string &tag, const CHAR8 *pName)
+{
+    string key = string(" ") + pName + "=\"";
+    size_t pos = tag.find(key);
+    if (pos == string::npos)
+        return 0;
+    return (INT32U)strtoul(tag.c_str() + pos + key.size(), NULL, 10);
+}
+
+static string HilEscape(const string &text)
+{
+    string escaped;
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        switch (text[i])
+        {
+            case '"':
+                escaped += "&quot;";
+                break;
+            case '&':
+                escaped += "&amp;";
+                break;
+            case '<':
+                escaped += "&lt;";
+                break;
+            case '>':
+                escaped += "&gt;";
+                break;
+            default:
+                escaped += text[i];
+        }
+    }
+    return escaped;
+}
+
+CHilShardRunner::CHilShardRunner(const string &selfPath, const vector<string> &passThroughArgs)
+    : m_selfPath(selfPath), m_passThroughArgs(passThroughArgs), m_wallMS(0)
+{
+}
+
+CHilShardRunner::~CHilShardRunner()
+{
+    for (size_t i = 0; i < m_results.size(); i++)
+    {
+        unlink(m_results[i].junitPath.c_str());
+        unlink(m_results[i].logPath.c_str());
+    }
+    if (!m_workDir.empty())
+    {
+        rmdir(m_workDir.c_str());
+    }
+}
+
+string CHilShardRunner::ReadFile(const string &path)
+{
+    string contents;
+    FILE *pFile = fopen(path.c_str(), "r");
+    if (pFile == NULL)
+        return contents;
+
+    CHAR8 buffer[4096];
+    size_t bytesRead;
+    while ((bytesRead = fread(buffer, 1, sizeof(buffer), pFile)) > 0)
+    {
+        contents.append(buffer, bytesRead);
+    }
+    fclose(pFile);
+    return contents;
+}
+
+void CHilShardRunner::ParseJUnitTotals(const string &report, HilShardResult &result)
+{
+    size_t start = report.find("<testsuites");
+    if (start == string::npos)
+        return;
+    size_t end = report.find('>', start);
+    if (end == string::npos)
+        return;
+
+    string tag = report.substr(start, end - start);
+    result.hasReport = true;
+    result.tests = HilReadAttribute(tag, "tests");
+    result.failures = HilReadAttribute(tag, "failures");
+    result.errors = HilReadAttribute(tag, "errors");
+}
+
+void CHilShardRunner::RunShard(HilShardResult &result, INT32U totalShards)
+{
+    // Everything the child needs is built here; between fork and exec
+    // only async-signal-safe calls are allowed.
+    vector<string> args;
+    args.push_back(m_selfPath);
+    args.push_back("--device=" + result.device);
+    args.push_back("--gtest_output=xml:" + result.junitPath);
+    args.insert(args.end(), m_passThroughArgs.begin(), m_passThroughArgs.end());
+
+    vector<string> env;
+    for (CHAR8 **ppVar = environ; *ppVar != NULL; ppVar++)
+    {
+        if (strncmp(*ppVar, "GTEST_SHARD_INDEX=", 18) != 0 && strncmp(*ppVar, "GTEST_TOTAL_SHARDS=", 19) != 0)
+        {
+            env.push_back(*ppVar);
+        }
+    }
+    env.push_back("GTEST_TOTAL_SHARDS=" + to_string(totalShards));
+    env.push_back("GTEST_SHARD_INDEX=" + to_string(result.shardIndex));
+
+    vector<CHAR8 *> argv;
+    for (size_t i = 0; i < args.size(); i++)
+        argv.push_back(&args[i][0]);
+    argv.push_back(NULL);
+
+    vector<CHAR8 *> envp;
+    for (size_t i = 0; i < env.size(); i++)
+        envp.push_back(&env[i][0]);
+    envp.push_back(NULL);
+
+    int logFd = open(result.logPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    uint64_t startMS = HilGetNowMS();
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        if (logFd >= 0)
+        {
+            dup2(logFd, STDOUT_FILENO);
+            dup2(logFd, STDERR_FILENO);
+        }
+        execve(argv[0], argv.data(), envp.data());
+        _exit(127);
+    }
+
+    if (logFd >= 0)
+    {
+        close(logFd);
+    }
+
+    if (pid < 0)
+    {
+        result.exitCode = -1;
+        return;
+    }
+
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+    {
+    }
+    result.wallMS = HilGetNowMS() - startMS;
+
+    if (WIFEXITED(status))
+        result.exitCode = WEXITSTATUS(status);
+    else
+        result.exitCode = 128 + WTERMSIG(status);
+
+    ParseJUnitTotals(ReadFile(result.junitPath), result);
+}
+
+ERROR_CODE_T CHilShardRunner::Run(const vector<string> &devices)
+{
+    RETURN_EC_IF_TRUE(ERROR_INVALID_PARAMETER, devices.empty());
+
+    CHAR8 workDir[] = "/tmp/bta_hil_XXXXXX";
+    RETURN_EC_IF_NULL(ERROR_FAILED, mkdtemp(workDir));
+    m_workDir = workDir;
+
+    m_results.assign(devices.size(), HilShardResult());
+    for (size_t i = 0; i < devices.size(); i++)
+    {
+        HilShardResult &result = m_results[i];
+        result.device = devices[i];
+        result.shardIndex = (INT32U)i;
+        result.exitCode = -1;
+        result.hasReport = false;
+        result.tests = 0;
+        result.failures = 0;
+        result.errors = 0;
+        result.wallMS = 0;
+        result.junitPath = m_workDir + "/" + HilDeviceName(devices[i]) + ".xml";
+        result.logPath = m_workDir + "/" + HilDeviceName(devices[i]) + ".log";
+    }
+
+    uint64_t startMS = HilGetNowMS();
+    vector<thread> workers;
+    for (size_t i = 0; i < m_results.size(); i++)
+    {
+        workers.push_back(thread(&CHilShardRunner::RunShard, this, ref(m_results[i]), (INT32U)m_results.size()));
+    }
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        workers[i].join();
+    }
+    m_wallMS = HilGetNowMS() - startMS;
+
+    return (GetFailedShardCount() == 0) ? STATUS_SUCCESS : ERROR_FAILED;
+}
+
+ERROR_CODE_T CHilShardRunner::WriteJUnit(const string &path) const
+{
+    FILE *pFile = fopen(path.c_str(), "w");
+    RETURN_EC_IF_NULL(ERROR_FAILED, pFile);
+
+    INT32U tests = 0, failures = 0, errors = 0;
+    for (size_t i = 0; i < m_results.size(); i++)
+    {
+        tests += m_results[i].tests;
+        failures += m_results[i].failures;
+        errors += m_results[i].errors;
+        // A shard that died before writing its report still counts.
+        if (!m_results[i].hasReport)
+        {
+            errors++;
+        }
+    }
+
+    fprintf(pFile, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+    fprintf(pFile, "<testsuites name=\"bta_device_tests\" tests=\"%u\" failures=\"%u\" errors=\"%u\" time=\"%.3f\">\n",
+            tests, failures, errors, m_wallMS / 1000.0);
+
+    for (size_t i = 0; i < m_results.size(); i++)
+    {
+        const HilShardResult &result = m_results[i];
+        string deviceName = HilDeviceName(result.device);
+        string report = ReadFile(result.junitPath);
+
+        size_t start = report.find("<testsuites");
+        size_t end = report.rfind("</testsuites>");
+        if (start != string::npos)
+            start = report.find('>', start);
+
+        if (!result.hasReport || start == string::npos || end == string::npos || end < start)
+        {
+            fprintf(pFile,
+                    "  <testsuite name=\"%s\" tests=\"1\" failures=\"0\" errors=\"1\" time=\"%.3f\">\n"
+                    "    <testcase name=\"shard%u\" classname=\"%s\">\n"
+                    "      <error message=\"exited with %d before writing a report\"/>\n"
+                    "    </testcase>\n"
+                    "  </testsuite>\n",
+                    HilEscape(deviceName).c_str(), result.wallMS / 1000.0, result.shardIndex,
+                    HilEscape(deviceName).c_str(), result.exitCode);
+            continue;
+        }
+
+        // Prefix each suite with the device so identical suites from
+        // different shards stay distinguishable in the merged report.
+        string body = report.substr(start + 1, end - start - 1);
+        const string suiteTag = "<testsuite name=\"";
+        string prefixed = suiteTag + HilEscape(deviceName) + "/";
+        size_t pos = 0;
+        while ((pos = body.find(suiteTag, pos)) != string::npos)
+        {
+            body.replace(pos, suiteTag.size(), prefixed);
+            pos += prefixed.size();
+        }
+        fputs(body.c_str(), pFile);
+    }
+
+    fprintf(pFile, "</testsuites>\n");
+    fclose(pFile);
+    return STATUS_SUCCESS;
+}
+
+ERROR_CODE_T CHilShardRunner::WriteJson(const string &path) const
+{
+    FILE *pFile = fopen(path.c_str(), "w");
+    RETURN_EC_IF_NULL(ERROR_FAILED, pFile);
+
+    fprintf(pFile, "{\n  \"wall_ms\": %llu,\n  \"failed_shards\": %u,\n  \"devices\": [\n",
+            (unsigned long long)m_wallMS, GetFailedShardCount());
+    for (size_t i = 0; i < m_results.size(); i++)
+    {
+        const HilShardResult &result = m_results[i];
+        // Device paths are plain /dev names, nothing that needs escaping.
+        fprintf(pFile,
+                "    {\"device\": \"%s\", \"shard\": %u, \"exit_code\": %d, \"tests\": %u, \"failures\": %u, "
+                "\"errors\": %u, \"wall_ms\": %llu}%s\n",
+                result.device.c_str(), result.shardIndex, result.exitCode, result.tests, result.failures,
+                result.errors, (unsigned long long)result.wallMS, (i + 1 < m_results.size()) ? "," : "");
+    }
+    fprintf(pFile, "  ]\n}\n");
+    fclose(pFile);
+    return STATUS_SUCCESS;
+}
+
+void CHilShardRunner::PrintLogs(FILE *pOut) const
+{
+    for (size_t i = 0; i < m_results.size(); i++)
+    {
+        const HilShardResult &result = m_results[i];
+        fprintf(pOut, "===== %s (shard %u, exit %d, %llu ms) =====\n", result.device.c_str(), result.shardIndex,
+                result.exitCode, (unsigned long long)result.wallMS);
+        fputs(ReadFile(result.logPath).c_str(), pOut);
+    }
+}
+
+INT32U CHilShardRunner::GetFailedShardCount(void) const
+{
+    INT32U failed = 0;
+    for (size_t i = 0; i < m_results.size(); i++)
+    {
+        if (m_results[i].exitCode != 0)
+            failed++;
+    }
+    return failed;
+}
+
+uint64_t CHilShardRunner::GetWallMS(void) const
+{
+    return m_wallMS;
+}
+
+const vector<HilShardResult> &CHilShardRunner::GetResults(void) const
+{
+    return m_results;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "types.h"
+
+using namespace std;
+
+// Outcome of one device's shard of the test binary.
+struct HilShardResult
+{
+    string device;
+    INT32U shardIndex;
+    int exitCode;
+    bool hasReport;
+    INT32U tests;
+    INT32U failures;
+    INT32U errors;
+    uint64_t wallMS;
+    string junitPath;
+    string logPath;
+};
+
+// Runs the test binary once per device, each child taking its own gtest
+// shard of the test cases, and merges the per-device JUnit reports. Each
+// child is supervised from its own thread so a rack run takes as long as
+// the slowest device rather than the sum of all of them.
+class CHilShardRunner
+{
+  public:
+    // passThroughArgs are forwarded to every child, e.g. --gtest_filter.
+    CHilShardRunner(const string &selfPath, const vector<string> &passThroughArgs);
+    ~CHilShardRunner();
+
+    ERROR_CODE_T Run(const vector<string> &devices);
+
+    ERROR_CODE_T WriteJUnit(const string &path) const;
+    ERROR_CODE_T WriteJson(const string &path) const;
+
+    // Prints each child's captured output under a per-device header.
+    void PrintLogs(FILE *pOut) const;
+
+    INT32U GetFailedShardCount(void) const;
+    uint64_t GetWallMS(void) const;
+    const vector<HilShardResult> &GetResults(void) const;
+
+  private:
+    void RunShard(HilShardResult &result, INT32U totalShards);
+    static void ParseJUnitTotals(const string &report, HilShardResult &result);
+    static string ReadFile(const string &path);
+
+    string m_selfPath;
+    vector<string> m_passThroughArgs;
+    string m_workDir;
+    vector<HilShardResult> m_results;
+    uint64_t m_wallMS;
+};
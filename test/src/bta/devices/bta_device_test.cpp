@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <list>
+#include <memory>
+
+#include "BTADeviceDriver.h"
+#include "BTADeviceFactory.h"
+#include "DeviceUnderTest.h"
+#include "TimeDelta.h"
+#include "uart.h"
+
+#define DEVICE_PATH_PREFIX "/dev/ttyUSB"
+#define DEVICE_READY_TIMEOUT_MS 10000
+#define DEVICE_SCAN_TIMEOUT_MS 15000
+
+// CuArt takes the port number, not the path --device names.
+static bool ParsePortNumber(const string &device, INT32U &portOut)
+{
+    if (device.compare(0, strlen(DEVICE_PATH_PREFIX), DEVICE_PATH_PREFIX) != 0)
+        return false;
+
+    const CHAR8 *pNumber = device.c_str() + strlen(DEVICE_PATH_PREFIX);
+    CHAR8 *pEnd = NULL;
+    unsigned long port = strtoul(pNumber, &pEnd, 10);
+    if (pEnd == pNumber || *pEnd != '\0')
+        return false;
+
+    portOut = (INT32U)port;
+    return true;
+}
+
+class BTADeviceTest : public ::testing::Test
+{
+  protected:
+    void SetUp() override
+    {
+        const string &device = GetDeviceUnderTest();
+        if (device.empty())
+        {
+            GTEST_SKIP() << "No --device given";
+        }
+
+        INT32U port;
+        ASSERT_TRUE(ParsePortNumber(device, port)) << "Expected " DEVICE_PATH_PREFIX "<n>, got " << device;
+        m_pUart = make_shared<CuArt>(port);
+        ASSERT_EQ(STATUS_SUCCESS, CBTADeviceFactory::CreateBTADeviceDriver(m_pUart, m_pDriver));
+        ASSERT_TRUE(m_pDriver != NULL);
+    }
+
+    void TearDown() override
+    {
+        m_pDriver.reset();
+        if (m_pUart)
+        {
+            m_pUart->Close();
+        }
+    }
+
+    bool WaitUntilReady(void)
+    {
+        CTimeDelta deadline(DEVICE_READY_TIMEOUT_MS);
+        while (!m_pDriver->IsDeviceReadyForUse())
+        {
+            if (deadline.IsTimeExpired())
+                return false;
+            OSTimeDly(10);
+        }
+        return true;
+    }
+
+    shared_ptr<IUart> m_pUart;
+    shared_ptr<IBTADeviceDriver> m_pDriver;
+};
+
+TEST_F(BTADeviceTest, BecomesReadyForUse)
+{
+    EXPECT_TRUE(WaitUntilReady());
+}
+
+TEST_F(BTADeviceTest, InquiryCompletes)
+{
+    ASSERT_TRUE(WaitUntilReady());
+    ASSERT_EQ(STATUS_SUCCESS, m_pDriver->SendInquiry(10));
+
+    list<shared_ptr<CBTEADetectedDevice> > detectedDevices;
+    CTimeDelta deadline(DEVICE_SCAN_TIMEOUT_MS);
+    ERROR_CODE_T result;
+    while ((result = m_pDriver->ScanForBtDevices(detectedDevices, 5)) == STATUS_OPERATION_INCOMPLETE)
+    {
+        ASSERT_FALSE(deadline.IsTimeExpired()) << "Inquiry still running after " << DEVICE_SCAN_TIMEOUT_MS << " ms";
+        OSTimeDly(1);
+    }
+    EXPECT_EQ(STATUS_SUCCESS, result);
+}
+
+TEST_F(BTADeviceTest, WatchdogPetIsAnswered)
+{
+    ASSERT_TRUE(WaitUntilReady());
+    EXPECT_EQ(STATUS_SUCCESS, m_pDriver->WatchdogPet(true));
+    // A pet without the flush must work too; that is what the idle pet sends.
+    EXPECT_EQ(STATUS_SUCCESS, m_pDriver->WatchdogPet(false));
+}
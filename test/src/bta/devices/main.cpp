@@ -0,0 +1,92 @@
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "DeviceUnderTest.h"
+#include "HilShardRunner.h"
+
+static string g_deviceUnderTest;
+
+const std::string &GetDeviceUnderTest(void)
+{
+    return g_deviceUnderTest;
+}
+
+static void SplitDevices(const string &list, vector<string> &devices)
+{
+    size_t start = 0;
+    while (start <= list.size())
+    {
+        size_t comma = list.find(',', start);
+        if (comma == string::npos)
+            comma = list.size();
+        if (comma > start)
+            devices.push_back(list.substr(start, comma - start));
+        start = comma + 1;
+    }
+}
+
+// Usage:
+//   bta_device_tests --device=/dev/ttyUSB0
+//   bta_device_tests --devices=/dev/ttyUSB0,/dev/ttyUSB1 [--junit=report.xml] [--json=report.json]
+// With more than one device the test cases are sharded across them and
+// every device runs its shard concurrently in a child process.
+int main(int argc, char **argv)
+{
+    // gtest strips its own flags, so remember the ones the shards need.
+    vector<string> passThroughArgs;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "--gtest_", 8) == 0 && strncmp(argv[i], "--gtest_output", 14) != 0)
+        {
+            passThroughArgs.push_back(argv[i]);
+        }
+    }
+
+    testing::InitGoogleTest(&argc, argv);
+
+    vector<string> devices;
+    string junitPath;
+    string jsonPath;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "--device=", 9) == 0)
+            devices.push_back(argv[i] + 9);
+        else if (strncmp(argv[i], "--devices=", 10) == 0)
+            SplitDevices(argv[i] + 10, devices);
+        else if (strncmp(argv[i], "--junit=", 8) == 0)
+            junitPath = argv[i] + 8;
+        else if (strncmp(argv[i], "--json=", 7) == 0)
+            jsonPath = argv[i] + 7;
+    }
+
+    if (devices.size() <= 1)
+    {
+        if (!devices.empty())
+            g_deviceUnderTest = devices[0];
+        if (!junitPath.empty())
+            testing::GTEST_FLAG(output) = "xml:" + junitPath;
+        return RUN_ALL_TESTS();
+    }
+
+    CHilShardRunner runner("/proc/self/exe", passThroughArgs);
+    runner.Run(devices);
+    runner.PrintLogs(stdout);
+
+    for (size_t i = 0; i < runner.GetResults().size(); i++)
+    {
+        const HilShardResult &result = runner.GetResults()[i];
+        printf("%-16s shard %u: %u tests, %u failures, %llu ms, exit %d\n", result.device.c_str(), result.shardIndex,
+               result.tests, result.failures, (unsigned long long)result.wallMS, result.exitCode);
+    }
+    printf("%u devices in %llu ms, %u failed\n", (INT32U)devices.size(), (unsigned long long)runner.GetWallMS(),
+           runner.GetFailedShardCount());
+
+    if (!junitPath.empty())
+        runner.WriteJUnit(junitPath);
+    if (!jsonPath.empty())
+        runner.WriteJson(jsonPath);
+
+    return (runner.GetFailedShardCount() == 0) ? 0 : 1;
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <string>
+
+#include "ClockSource.h"
+#include "interfaces/iuart.h"
+
+using namespace std;
+
+// Scripted module on the far end of a UART. Each "\r"-terminated command
+// written is queued, and the module answers one command at a time as the
+// host reads, the way the real module does. An empty read sleeps on the
+// clock source like the driver's inter-character timeout.
+class CFakeUart : public IUart
+{
+  public:
+    typedef function<string(const string &command)> Responder;
+
+    CFakeUart(Responder responder = Responder())
+        : IUart(0), m_responder(responder), m_open(true), m_maxPending(0), m_readCount(0)
+    {
+    }
+
+    void QueueRx(const string &text)
+    {
+        m_rx.insert(m_rx.end(), text.begin(), text.end());
+    }
+
+    ERROR_CODE_T Open(BAUDRATE, BYTE_SIZE, PARITY, STOP_BITS) override
+    {
+        m_open = true;
+        return STATUS_SUCCESS;
+    }
+    ERROR_CODE_T Close(void) override
+    {
+        m_open = false;
+        return STATUS_SUCCESS;
+    }
+    INT32U RxBytesAvailable(void) override
+    {
+        return m_rx.size();
+    }
+    void WriteString(const CHAR8 *pString) override
+    {
+        INT32U written;
+        WritePort(reinterpret_cast<const INT8U *>(pString), string(pString).size(), &written);
+    }
+    void WriteByte(INT8U byte) override
+    {
+        INT32U written;
+        WritePort(&byte, 1, &written);
+    }
+    void WriteWord(INT16U) override
+    {
+    }
+    void WriteDWord(INT32U) override
+    {
+    }
+    BOOLEAN ReadByte(INT8U *pByte) override
+    {
+        INT32U read;
+        ReadPort(pByte, 1, &read);
+        return read == 1;
+    }
+    BOOLEAN ReadWord(INT16U *) override
+    {
+        return false;
+    }
+    BOOLEAN ReadDWord(INT32U *) override
+    {
+        return false;
+    }
+
+    void WritePort(const INT8U *pBuf, INT32U bytesToWrite, INT32U *pBytesWritten) override
+    {
+        m_written.append(reinterpret_cast<const CHAR8 *>(pBuf), bytesToWrite);
+        m_partial.append(reinterpret_cast<const CHAR8 *>(pBuf), bytesToWrite);
+
+        size_t end;
+        while ((end = m_partial.find('\r')) != string::npos)
+        {
+            m_pending.push_back(m_partial.substr(0, end));
+            m_partial.erase(0, end + 1);
+        }
+        m_maxPending = max(m_maxPending, (INT32U)m_pending.size());
+
+        if (pBytesWritten != NULL)
+            *pBytesWritten = bytesToWrite;
+    }
+
+    void ReadPort(INT8U *pBuf, INT32U maxBytes, INT32U *pBytesRead) override
+    {
+        m_readCount++;
+        if (m_rx.empty() && !m_pending.empty())
+        {
+            string command = m_pending.front();
+            m_pending.pop_front();
+            if (m_responder)
+                QueueRx(m_responder(command));
+        }
+
+        INT32U count = 0;
+        while (count < maxBytes && !m_rx.empty())
+        {
+            pBuf[count++] = (INT8U)m_rx.front();
+            m_rx.pop_front();
+        }
+
+        if (count == 0)
+            GetClockSource().SleepUs(FAKE_UART_IDLE_US);
+
+        if (pBytesRead != NULL)
+            *pBytesRead = count;
+    }
+
+    static const INT32U FAKE_UART_IDLE_US = 1000;
+
+    Responder m_responder;
+    bool m_open;
+    string m_written;
+    string m_partial;
+    deque<string> m_pending;
+    deque<CHAR8> m_rx;
+    INT32U m_maxPending;
+    INT32U m_readCount;
+};
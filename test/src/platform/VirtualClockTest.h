@@ -0,0 +1,28 @@
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include "ClockSource.h"
+
+// Installs a virtual clock as the clock source for the length of each test.
+// With auto-advance, code that sleeps on the clock runs without waiting in
+// real time; without it, time only moves when the test calls Advance.
+class VirtualClockTest : public ::testing::Test
+{
+  protected:
+    explicit VirtualClockTest(bool autoAdvance) : m_clock(0, autoAdvance)
+    {
+    }
+
+    void SetUp() override
+    {
+        SetClockSource(&m_clock);
+    }
+
+    void TearDown() override
+    {
+        SetClockSource(NULL);
+    }
+
+    CVirtualClockSource m_clock;
+};
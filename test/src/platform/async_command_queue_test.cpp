@@ -0,0 +1,192 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+
+#include "AsyncCommandQueue.h"
+#include "VirtualClockTest.h"
+
+class AsyncCommandQueueTest : public VirtualClockTest
+{
+  protected:
+    AsyncCommandQueueTest() : VirtualClockTest(false)
+    {
+    }
+
+    static bool IsReady(future<ERROR_CODE_T> &result)
+    {
+        return result.wait_for(chrono::seconds(0)) == future_status::ready;
+    }
+
+    CAsyncCommandQueue m_queue;
+};
+
+static ERROR_CODE_T StepForever(void)
+{
+    return STATUS_OPERATION_INCOMPLETE;
+}
+
+TEST_F(AsyncCommandQueueTest, MultiStepCommandCompletesOnItsLastStep)
+{
+    int steps = 0;
+    future<ERROR_CODE_T> result = m_queue.Submit("scan", [&steps]() {
+        return (++steps < 3) ? STATUS_OPERATION_INCOMPLETE : STATUS_SUCCESS;
+    }, 0);
+
+    EXPECT_FALSE(m_queue.RunOnce());
+    EXPECT_FALSE(m_queue.RunOnce());
+    EXPECT_TRUE(m_queue.RunOnce());
+    ASSERT_TRUE(IsReady(result));
+    EXPECT_EQ(STATUS_SUCCESS, result.get());
+    EXPECT_EQ(0u, m_queue.GetPendingCount());
+}
+
+TEST_F(AsyncCommandQueueTest, CancelAllCancelsTheCurrentCommand)
+{
+    future<ERROR_CODE_T> current = m_queue.Submit("scan", StepForever, 0);
+    future<ERROR_CODE_T> waiting = m_queue.Submit("pet", StepForever, 0);
+
+    EXPECT_FALSE(m_queue.RunOnce());
+    m_queue.CancelAll();
+
+    ASSERT_TRUE(IsReady(current));
+    EXPECT_EQ(ERROR_OPERATION_CANCELLED, current.get());
+    ASSERT_TRUE(IsReady(waiting));
+    EXPECT_EQ(ERROR_OPERATION_CANCELLED, waiting.get());
+    EXPECT_EQ(0u, m_queue.GetPendingCount());
+    EXPECT_FALSE(m_queue.RunOnce());
+}
+
+TEST_F(AsyncCommandQueueTest, CancelAllDuringAStepTakesEffectWhenItReturns)
+{
+    // Stands in for another thread cancelling while the step is on the wire.
+    future<ERROR_CODE_T> result = m_queue.Submit("scan", [this]() {
+        m_queue.CancelAll();
+        return STATUS_OPERATION_INCOMPLETE;
+    }, 0);
+
+    EXPECT_TRUE(m_queue.RunOnce());
+    ASSERT_TRUE(IsReady(result));
+    EXPECT_EQ(ERROR_OPERATION_CANCELLED, result.get());
+    EXPECT_EQ(0u, m_queue.GetPendingCount());
+}
+
+TEST_F(AsyncCommandQueueTest, CancelledTokenSkipsTheCommand)
+{
+    shared_ptr<CCancellationToken> pToken = make_shared<CCancellationToken>();
+    bool ran = false;
+    future<ERROR_CODE_T> result = m_queue.Submit("inquiry", [&ran]() {
+        ran = true;
+        return STATUS_SUCCESS;
+    }, 0, pToken);
+
+    pToken->Cancel();
+    EXPECT_TRUE(m_queue.RunOnce());
+    EXPECT_FALSE(ran);
+    EXPECT_EQ(ERROR_OPERATION_CANCELLED, result.get());
+}
+
+TEST_F(AsyncCommandQueueTest, TimesOutOnTheClockSource)
+{
+    future<ERROR_CODE_T> result = m_queue.Submit("scan", StepForever, 100);
+
+    EXPECT_FALSE(m_queue.RunOnce());
+    m_clock.Advance(50 * 1000);
+    EXPECT_FALSE(m_queue.RunOnce());
+    m_clock.Advance(60 * 1000);
+    EXPECT_TRUE(m_queue.RunOnce());
+    EXPECT_EQ(ERROR_OPERATION_TIMED_OUT, result.get());
+}
+
+TEST_F(AsyncCommandQueueTest, CallbackCanSubmitFollowUpWork)
+{
+    bool followUpRan = false;
+    m_queue.Submit("inquiry", []() { return STATUS_SUCCESS; }, 0, shared_ptr<CCancellationToken>(),
+                   [this, &followUpRan](ERROR_CODE_T) {
+                       m_queue.Submit("scan", [&followUpRan]() {
+                           followUpRan = true;
+                           return STATUS_SUCCESS;
+                       }, 0);
+                   });
+
+    EXPECT_TRUE(m_queue.RunOnce());
+    EXPECT_TRUE(m_queue.RunOnce());
+    EXPECT_TRUE(followUpRan);
+}
+
+// Submits a single-step command that appends its name to the run log.
+static AsyncCommandStep Record(vector<string> &log, const string &name)
+{
+    return [&log, name]() {
+        log.push_back(name);
+        return STATUS_SUCCESS;
+    };
+}
+
+TEST_F(AsyncCommandQueueTest, RunsByPriorityThenDeadlineThenSubmission)
+{
+    vector<string> log;
+    AsyncCommandOptions bulk(COMMAND_PRIORITY_BULK);
+    AsyncCommandOptions normal(COMMAND_PRIORITY_NORMAL);
+    AsyncCommandOptions soon(COMMAND_PRIORITY_NORMAL);
+    soon.deadlineMS = 10;
+    AsyncCommandOptions later(COMMAND_PRIORITY_NORMAL);
+    later.deadlineMS = 500;
+
+    m_queue.Submit("inquiry", Record(log, "inquiry"), bulk);
+    m_queue.Submit("first", Record(log, "first"), normal);
+    m_queue.Submit("second", Record(log, "second"), normal);
+    m_queue.Submit("later", Record(log, "later"), later);
+    m_queue.Submit("soon", Record(log, "soon"), soon);
+    m_queue.Submit("pet", Record(log, "pet"), AsyncCommandOptions(COMMAND_PRIORITY_CRITICAL));
+
+    while (m_queue.RunOnce())
+    {
+    }
+
+    vector<string> expected = {"pet", "soon", "later", "first", "second", "inquiry"};
+    EXPECT_EQ(expected, log);
+}
+
+TEST_F(AsyncCommandQueueTest, PreemptibleCommandYieldsAndResumes)
+{
+    vector<string> log;
+    int scanSteps = 0;
+    AsyncCommandOptions scanOptions(COMMAND_PRIORITY_BULK);
+    scanOptions.preemptible = true;
+    future<ERROR_CODE_T> scan = m_queue.Submit("scan", [&log, &scanSteps]() {
+        log.push_back("scan");
+        return (++scanSteps < 2) ? STATUS_OPERATION_INCOMPLETE : STATUS_SUCCESS;
+    }, scanOptions);
+
+    EXPECT_FALSE(m_queue.RunOnce());
+    m_queue.Submit("play", Record(log, "play"), AsyncCommandOptions(COMMAND_PRIORITY_REALTIME));
+    EXPECT_TRUE(m_queue.RunOnce());
+    EXPECT_TRUE(m_queue.RunOnce());
+
+    vector<string> expected = {"scan", "play", "scan"};
+    EXPECT_EQ(expected, log);
+    EXPECT_EQ(STATUS_SUCCESS, scan.get());
+}
+
+TEST_F(AsyncCommandQueueTest, NonPreemptibleCommandHoldsOffAllButCriticalWork)
+{
+    vector<string> log;
+    AsyncCommandOptions configOptions(COMMAND_PRIORITY_NORMAL);
+    configOptions.preemptible = false;
+    m_queue.Submit("config", [&log]() {
+        log.push_back("config");
+        return STATUS_OPERATION_INCOMPLETE;
+    }, configOptions);
+
+    EXPECT_FALSE(m_queue.RunOnce());
+    m_queue.Submit("play", Record(log, "play"), AsyncCommandOptions(COMMAND_PRIORITY_REALTIME));
+    EXPECT_FALSE(m_queue.RunOnce());
+    m_queue.Submit("pet", Record(log, "pet"), AsyncCommandOptions(COMMAND_PRIORITY_CRITICAL));
+    EXPECT_TRUE(m_queue.RunOnce());
+    EXPECT_FALSE(m_queue.RunOnce());
+
+    // The play still waits for the configuration to finish.
+    vector<string> expected = {"config", "config", "pet", "config"};
+    EXPECT_EQ(expected, log);
+    EXPECT_EQ(2u, m_queue.GetPendingCount());
+}
@@ -0,0 +1,67 @@
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+
+#include <string>
+
+#include "BinaryLog.h"
+
+// Runs the writer into a temporary file and returns what it wrote.
+static string CaptureLog(void (*logCalls)(void))
+{
+    FILE *pFile = tmpfile();
+    EXPECT_TRUE(pFile != NULL);
+    EXPECT_EQ(STATUS_SUCCESS, CBinaryLog::Start(pFile));
+    logCalls();
+    CBinaryLog::Flush();
+    CBinaryLog::Stop();
+
+    string text;
+    CHAR8 buf[256];
+    rewind(pFile);
+    size_t length;
+    while ((length = fread(buf, 1, sizeof(buf), pFile)) > 0)
+    {
+        text.append(buf, length);
+    }
+    fclose(pFile);
+
+    // Point the logger back at stdout for everything that runs after us.
+    CBinaryLog::Start(stdout);
+    CBinaryLog::Stop();
+    return text;
+}
+
+TEST(BinaryLogTest, FormatsStoredArguments)
+{
+    string text = CaptureLog([]() { CBinaryLog::Write(DEBUG_TRACE_INFO, "test", "%s=%d 0x%04x\n", "value", -5, 0xABu); });
+    EXPECT_EQ("value=-5 0x00ab\n", text);
+}
+
+TEST(BinaryLogTest, StringsPastTheStringAreaPrintEmpty)
+{
+    string text = CaptureLog([]() {
+        string first(80, 'a');
+        string second(80, 'b');
+        string third(80, 'c');
+        CBinaryLog::Write(DEBUG_TRACE_INFO, "test", "[%s][%s][%s] %d\n", first.c_str(), second.c_str(),
+                          third.c_str(), 7);
+    });
+
+    // The first string fits, the second is cut to what is left (minus the
+    // byte kept for the empty marker) and the third is dropped to "".
+    string expected = "[" + string(80, 'a') + "][" + string(BINARY_LOG_STRING_BYTES - 1 - 81 - 1, 'b') + "][] 7\n";
+    EXPECT_EQ(expected, text);
+}
+
+TEST(BinaryLogTest, TwoLongStringsStayInsideTheRecord)
+{
+    string text = CaptureLog([]() {
+        string first(200, 'x');
+        string second(200, 'y');
+        CBinaryLog::Write(DEBUG_TRACE_INFO, "test", "%s|%s|end\n", first.c_str(), second.c_str());
+    });
+
+    string expected = string(BINARY_LOG_STRING_BYTES - 2, 'x') + "||end\n";
+    EXPECT_EQ(expected, text);
+}
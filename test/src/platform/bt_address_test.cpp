@@ -0,0 +1,50 @@
+#include <gtest/gtest.h>
+
+#include "BtAddress.h"
+
+TEST(BtAddressTest, PacksEverySeparatorStyleAndCase)
+{
+    const CHAR8 *forms[] = {"00:11:22:AA:BB:CC", "00-11-22-aa-bb-cc", "001122AaBbCc"};
+    for (INT32U i = 0; i < 3; i++)
+    {
+        uint64_t address = 0;
+        ASSERT_EQ(STATUS_SUCCESS, PackBtAddress(forms[i], address)) << forms[i];
+        EXPECT_EQ(0x001122AABBCCULL, address) << forms[i];
+    }
+}
+
+TEST(BtAddressTest, FormatRoundTrips)
+{
+    CHAR8 text[BT_ADDRESS_STRING_SIZE];
+    FormatBtAddress(0xF01122AABB0DULL, text);
+    EXPECT_STREQ("F0:11:22:AA:BB:0D", text);
+
+    uint64_t address = 0;
+    ASSERT_EQ(STATUS_SUCCESS, PackBtAddress(text, address));
+    EXPECT_EQ(0xF01122AABB0DULL, address);
+}
+
+TEST(BtAddressTest, RejectsMalformedText)
+{
+    const CHAR8 *bad[] = {
+        "",
+        "00:11:22:AA:BB",
+        "00:11:22:AA:BB:CC:",
+        "00:11:22:AA:BB:CC:DD",
+        "00:11:22:AA:BB:CG",
+        "00.11.22.AA.BB.CC",
+        "00:11:22:AA:BB::C",
+        "0011:22AABBCC",
+        "00112233AABBC",
+        "0011 22AABBCC",
+    };
+
+    uint64_t address = 0x1234;
+    for (INT32U i = 0; i < sizeof(bad) / sizeof(bad[0]); i++)
+    {
+        EXPECT_EQ(ERROR_INVALID_PARAMETER, PackBtAddress(bad[i], address)) << "\"" << bad[i] << "\"";
+    }
+    EXPECT_EQ(ERROR_INVALID_PARAMETER, PackBtAddress(NULL, address));
+    // A rejected address leaves the output alone.
+    EXPECT_EQ(0x1234u, address);
+}
@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "TimeDelta.h"
+#include "VirtualClockTest.h"
+#include "WorkStealingExecutor.h"
+
+#define REAL_TIME_BUDGET_MS 500
+
+class ClockSourceTest : public VirtualClockTest
+{
+  protected:
+    ClockSourceTest() : VirtualClockTest(true)
+    {
+    }
+
+    void SetUp() override
+    {
+        VirtualClockTest::SetUp();
+        m_realStart = chrono::steady_clock::now();
+    }
+
+    uint64_t GetRealElapsedMS(void)
+    {
+        return (uint64_t)chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - m_realStart).count();
+    }
+
+    chrono::steady_clock::time_point m_realStart;
+};
+
+TEST_F(ClockSourceTest, LongTimeoutRunsInMilliseconds)
+{
+    // Thirty seconds of timeout polling, the way the drivers wait.
+    CTimeDelta timeout(30000);
+    timeout.WaitTimeElapsed();
+
+    EXPECT_GE(m_clock.GetNowUs(), 30000000u);
+    EXPECT_LT(GetRealElapsedMS(), (uint64_t)REAL_TIME_BUDGET_MS);
+}
+
+TEST_F(ClockSourceTest, TimeOnlyJumpsOnceEveryParticipantSleeps)
+{
+    m_clock.AddParticipant();
+    atomic<uint64_t> wokeAtUs(0);
+    thread sleeper([this, &wokeAtUs]() {
+        m_clock.SleepUs(1000000);
+        wokeAtUs = m_clock.GetNowUs();
+        m_clock.RemoveParticipant();
+    });
+
+    // The test thread is a participant and still awake, so the sleeper
+    // has to wait rather than skip the clock forward.
+    m_clock.WaitForSleepers(1);
+    this_thread::sleep_for(chrono::milliseconds(5));
+    EXPECT_EQ(0u, m_clock.GetNowUs());
+
+    // Once both sleep the earliest deadline comes first.
+    m_clock.SleepUs(5000000);
+    sleeper.join();
+    EXPECT_EQ(1000000u, wokeAtUs);
+    EXPECT_EQ(5000000u, m_clock.GetNowUs());
+    EXPECT_LT(GetRealElapsedMS(), (uint64_t)REAL_TIME_BUDGET_MS);
+}
+
+TEST_F(ClockSourceTest, ExecutorTimersFollowTheInstalledClock)
+{
+    CWorkStealingExecutor executor(1);
+    ASSERT_EQ(STATUS_SUCCESS, executor.Start());
+
+    atomic<INT32U> fired(0);
+    ASSERT_EQ(STATUS_SUCCESS, executor.SubmitAfter(60000, [&fired]() { fired++; }));
+    this_thread::sleep_for(chrono::milliseconds(5));
+    EXPECT_EQ(0u, fired);
+
+    m_clock.Advance(60000000);
+    for (INT32U i = 0; i < REAL_TIME_BUDGET_MS && fired == 0; i++)
+    {
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    executor.Stop();
+    EXPECT_EQ(1u, fired);
+}
@@ -0,0 +1,126 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+
+#include "CommandPipeline.h"
+#include "FakeUart.h"
+#include "VirtualClockTest.h"
+
+class CommandPipelineTest : public VirtualClockTest
+{
+  protected:
+    CommandPipelineTest() : VirtualClockTest(true)
+    {
+    }
+};
+
+// "GET NAME" -> "NAME=<value>", anything starting "BAD" -> ERROR.
+static string ModuleReply(const string &command)
+{
+    if (command.compare(0, 3, "BAD") == 0)
+        return "ERROR\r\n";
+    if (command.compare(0, 4, "GET ") == 0)
+        return command.substr(4) + "=value\r\nOK\r\n";
+    return "OK\r\n";
+}
+
+TEST_F(CommandPipelineTest, KeepsAtMostMaxInFlightOutstanding)
+{
+    shared_ptr<CFakeUart> pUart = make_shared<CFakeUart>(ModuleReply);
+    CCommandPipeline pipeline(pUart, 3);
+
+    vector<PipelinedCommand> commands;
+    for (int i = 0; i < 7; i++)
+    {
+        commands.push_back(PipelinedCommand("PING"));
+    }
+
+    EXPECT_EQ(STATUS_SUCCESS, pipeline.Execute(commands, 1000));
+    EXPECT_EQ(3u, pUart->m_maxPending);
+    for (size_t i = 0; i < commands.size(); i++)
+    {
+        EXPECT_EQ(STATUS_SUCCESS, commands[i].result);
+    }
+}
+
+TEST_F(CommandPipelineTest, RoutesTaggedLinesToTheirCommand)
+{
+    shared_ptr<CFakeUart> pUart = make_shared<CFakeUart>(ModuleReply);
+    CCommandPipeline pipeline(pUart);
+
+    vector<PipelinedCommand> commands;
+    commands.push_back(PipelinedCommand("GET NAME", "NAME="));
+    commands.push_back(PipelinedCommand("GET BAUD", "BAUD="));
+
+    ASSERT_EQ(STATUS_SUCCESS, pipeline.Execute(commands, 1000));
+    ASSERT_EQ(1u, commands[0].response.size());
+    EXPECT_EQ("NAME=value", commands[0].response[0]);
+    ASSERT_EQ(1u, commands[1].response.size());
+    EXPECT_EQ("BAUD=value", commands[1].response[0]);
+}
+
+TEST_F(CommandPipelineTest, UnsolicitedLinesDoNotAttachToTaggedCommands)
+{
+    // The module reports a link event before answering the GET.
+    shared_ptr<CFakeUart> pUart = make_shared<CFakeUart>([](const string &command) {
+        return "OPEN_OK 0 A2DP 001122334455\r\n" + ModuleReply(command);
+    });
+    CCommandPipeline pipeline(pUart);
+
+    vector<string> unsolicited;
+    pipeline.SetUnsolicitedHandler([&unsolicited](const string &line) { unsolicited.push_back(line); });
+
+    vector<PipelinedCommand> commands;
+    commands.push_back(PipelinedCommand("GET NAME", "NAME="));
+
+    ASSERT_EQ(STATUS_SUCCESS, pipeline.Execute(commands, 1000));
+    ASSERT_EQ(1u, commands[0].response.size());
+    EXPECT_EQ("NAME=value", commands[0].response[0]);
+    ASSERT_EQ(1u, unsolicited.size());
+    EXPECT_EQ("OPEN_OK 0 A2DP 001122334455", unsolicited[0]);
+    EXPECT_EQ(1u, pipeline.GetUnsolicitedCount());
+}
+
+TEST_F(CommandPipelineTest, UntaggedCommandCollectsFreeFormLines)
+{
+    shared_ptr<CFakeUart> pUart = make_shared<CFakeUart>(
+        [](const string &) { return string("AVRCP\r\nA2DP\r\nOK\r\n"); });
+    CCommandPipeline pipeline(pUart);
+
+    vector<PipelinedCommand> commands;
+    commands.push_back(PipelinedCommand("PROFILES"));
+
+    ASSERT_EQ(STATUS_SUCCESS, pipeline.Execute(commands, 1000));
+    EXPECT_EQ(2u, commands[0].response.size());
+    EXPECT_EQ(0u, pipeline.GetUnsolicitedCount());
+}
+
+TEST_F(CommandPipelineTest, ErrorFailsOnlyThatCommand)
+{
+    shared_ptr<CFakeUart> pUart = make_shared<CFakeUart>(ModuleReply);
+    CCommandPipeline pipeline(pUart);
+
+    vector<PipelinedCommand> commands;
+    commands.push_back(PipelinedCommand("PING"));
+    commands.push_back(PipelinedCommand("BAD"));
+    commands.push_back(PipelinedCommand("PING"));
+
+    EXPECT_EQ(ERROR_FAILED, pipeline.Execute(commands, 1000));
+    EXPECT_EQ(STATUS_SUCCESS, commands[0].result);
+    EXPECT_EQ(ERROR_FAILED, commands[1].result);
+    EXPECT_EQ(STATUS_SUCCESS, commands[2].result);
+}
+
+TEST_F(CommandPipelineTest, TimesOutWhenTheModuleIsSilent)
+{
+    shared_ptr<CFakeUart> pUart = make_shared<CFakeUart>();
+    CCommandPipeline pipeline(pUart);
+
+    vector<PipelinedCommand> commands;
+    commands.push_back(PipelinedCommand("PING"));
+    commands.push_back(PipelinedCommand("PING"));
+
+    EXPECT_EQ(ERROR_OPERATION_TIMED_OUT, pipeline.Execute(commands, 200));
+    EXPECT_EQ(ERROR_OPERATION_TIMED_OUT, commands[0].result);
+    EXPECT_EQ(ERROR_OPERATION_TIMED_OUT, commands[1].result);
+}
@@ -0,0 +1,106 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "CommandSchedule.h"
+
+TEST(CommandScheduleTest, CycleIsLcmOfPeriods)
+{
+    CCommandSchedule schedule;
+    ASSERT_EQ(STATUS_SUCCESS, schedule.Compile("every 40 pet\n"
+                                               "every 60 inquiry 5\n"));
+    EXPECT_EQ(120u, schedule.GetCycleMS());
+    EXPECT_EQ(2u, schedule.GetCommandCount());
+    EXPECT_EQ(5u, schedule.GetCommand(1).arg);
+
+    // pet at 0, 40, 80; inquiry at 0, 60. Both fire together at 0.
+    ASSERT_EQ(4u, schedule.GetBatchCount());
+    INT32U offsets[] = {0, 40, 60, 80};
+    for (INT32U i = 0; i < 4; i++)
+    {
+        EXPECT_EQ(offsets[i], schedule.GetBatch(i).offsetMS);
+    }
+    ASSERT_EQ(2u, schedule.GetBatch(0).commands.size());
+    EXPECT_EQ(0u, schedule.GetBatch(0).commands[0]);
+    EXPECT_EQ(1u, schedule.GetBatch(0).commands[1]);
+}
+
+TEST(CommandScheduleTest, OffsetsShiftFirings)
+{
+    CCommandSchedule schedule;
+    ASSERT_EQ(STATUS_SUCCESS, schedule.Compile("# comment\n"
+                                               "every 100 pet\n"
+                                               "every 100 +30 play  # trailing\n"));
+    EXPECT_EQ(100u, schedule.GetCycleMS());
+    ASSERT_EQ(2u, schedule.GetBatchCount());
+    EXPECT_EQ(0u, schedule.GetBatch(0).offsetMS);
+    EXPECT_EQ(30u, schedule.GetBatch(1).offsetMS);
+    EXPECT_EQ(30u, schedule.GetCommand(1).offsetMS);
+    EXPECT_EQ("play", schedule.GetCommand(1).name);
+}
+
+TEST(CommandScheduleTest, RejectsBadScripts)
+{
+    CCommandSchedule schedule;
+    EXPECT_NE(STATUS_SUCCESS, schedule.Compile(""));
+    EXPECT_NE(STATUS_SUCCESS, schedule.Compile("every 0 pet\n"));
+    EXPECT_NE(STATUS_SUCCESS, schedule.Compile("every 100 +100 pet\n"));
+    EXPECT_NE(STATUS_SUCCESS, schedule.Compile("every 100\n"));
+    EXPECT_NE(STATUS_SUCCESS, schedule.Compile("every 100 pet 1 2\n"));
+    EXPECT_NE(STATUS_SUCCESS, schedule.Compile("each 100 pet\n"));
+    // Coprime periods blow the cycle past the limit.
+    EXPECT_NE(STATUS_SUCCESS, schedule.Compile("every 99991 pet\nevery 99989 play\n"));
+}
+
+TEST(CommandSequencerTest, BatchesFollowTheCycleWithoutDrift)
+{
+    CCommandSchedule schedule;
+    ASSERT_EQ(STATUS_SUCCESS, schedule.Compile("every 100 pet\nevery 100 +30 play\n"));
+
+    CCommandSequencer sequencer;
+    EXPECT_FALSE(sequencer.IsStarted());
+    sequencer.Start(&schedule, 1000);
+    ASSERT_TRUE(sequencer.IsStarted());
+
+    INT32U delayMS;
+    const CommandBatch *pBatch = sequencer.GetDueBatch(1000, delayMS);
+    ASSERT_TRUE(pBatch != NULL);
+    EXPECT_EQ(0u, pBatch->offsetMS);
+    EXPECT_EQ(30u, delayMS);
+
+    EXPECT_TRUE(sequencer.GetDueBatch(1020, delayMS) == NULL);
+    EXPECT_EQ(10u, delayMS);
+
+    // Running late doesn't push the following batch back.
+    pBatch = sequencer.GetDueBatch(1045, delayMS);
+    ASSERT_TRUE(pBatch != NULL);
+    EXPECT_EQ(30u, pBatch->offsetMS);
+    EXPECT_EQ(55u, delayMS);
+    EXPECT_EQ(55u, sequencer.GetDelayMS(1045));
+
+    pBatch = sequencer.GetDueBatch(1100, delayMS);
+    ASSERT_TRUE(pBatch != NULL);
+    EXPECT_EQ(0u, pBatch->offsetMS);
+}
+
+TEST(CommandSequencerTest, FarBehindResyncsInsteadOfReplaying)
+{
+    CCommandSchedule schedule;
+    ASSERT_EQ(STATUS_SUCCESS, schedule.Compile("every 100 pet\nevery 100 +30 play\n"));
+
+    CCommandSequencer sequencer;
+    sequencer.Start(&schedule, 0);
+
+    // Over two cycles late: skip to the latest batch of the current cycle
+    // rather than firing every missed one.
+    INT32U delayMS;
+    const CommandBatch *pBatch = sequencer.GetDueBatch(1040, delayMS);
+    ASSERT_TRUE(pBatch != NULL);
+    EXPECT_EQ(30u, pBatch->offsetMS);
+    EXPECT_EQ(60u, delayMS);
+
+    EXPECT_TRUE(sequencer.GetDueBatch(1050, delayMS) == NULL);
+    pBatch = sequencer.GetDueBatch(1100, delayMS);
+    ASSERT_TRUE(pBatch != NULL);
+    EXPECT_EQ(0u, pBatch->offsetMS);
+}
@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+
+#include <map>
+#include <memory>
+
+#include "ConfigShadow.h"
+#include "FakeUart.h"
+#include "VirtualClockTest.h"
+
+// Module with a small option table. Unknown options answer ERROR.
+class CFakeConfigModule
+{
+  public:
+    string Reply(const string &command)
+    {
+        if (command.compare(0, 4, "GET ") == 0)
+        {
+            map<string, string>::iterator iter = m_options.find(command.substr(4));
+            if (iter == m_options.end())
+                return "ERROR\r\n";
+            return iter->first + "=" + iter->second + "\r\nOK\r\n";
+        }
+
+        return "ERROR\r\n";
+    }
+
+    map<string, string> m_options;
+};
+
+class ConfigShadowTest : public VirtualClockTest
+{
+  protected:
+    ConfigShadowTest() : VirtualClockTest(true)
+    {
+        m_module.m_options["NAME"] = "card";
+        m_module.m_options["NAME_SHORT"] = "c";
+        m_module.m_options["BAUD"] = "115200";
+
+        m_pUart = make_shared<CFakeUart>([this](const string &command) { return m_module.Reply(command); });
+        m_pShadow = make_shared<CConfigShadow>(make_shared<CCommandPipeline>(m_pUart));
+    }
+
+    CFakeConfigModule m_module;
+    shared_ptr<CFakeUart> m_pUart;
+    shared_ptr<CConfigShadow> m_pShadow;
+};
+
+TEST_F(ConfigShadowTest, OptionsSharingAPrefixGetTheirOwnValues)
+{
+    vector<string> options = {"NAME", "NAME_SHORT"};
+    ASSERT_EQ(STATUS_SUCCESS, m_pShadow->Populate(options, 1000));
+
+    string value;
+    ASSERT_EQ(STATUS_SUCCESS, m_pShadow->GetCfgValue(value, "NAME"));
+    EXPECT_EQ("card", value);
+    ASSERT_EQ(STATUS_SUCCESS, m_pShadow->GetCfgValue(value, "NAME_SHORT"));
+    EXPECT_EQ("c", value);
+}
+
+TEST_F(ConfigShadowTest, UnreadableOptionDoesNotFailPopulate)
+{
+    vector<string> options = {"NAME", "MISSING", "BAUD"};
+    ASSERT_EQ(STATUS_SUCCESS, m_pShadow->Populate(options, 1000));
+
+    string value;
+    EXPECT_EQ(STATUS_SUCCESS, m_pShadow->GetCfgValue(value, "BAUD"));
+    EXPECT_EQ("115200", value);
+    EXPECT_EQ(ERROR_INVALID_PARAMETER, m_pShadow->GetCfgValue(value, "MISSING"));
+}
+
+TEST_F(ConfigShadowTest, PopulateFailsWhenNothingCanBeRead)
+{
+    vector<string> options = {"MISSING"};
+    EXPECT_NE(STATUS_SUCCESS, m_pShadow->Populate(options, 1000));
+    EXPECT_FALSE(m_pShadow->IsPopulated());
+}
@@ -0,0 +1,162 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "DetectedDeviceIndex.h"
+
+// The smallest table the index allocates; six entries fit before it grows.
+#define TEST_CAPACITY 8
+#define TEST_MASK (TEST_CAPACITY - 1)
+
+// Mirrors CDetectedDeviceIndex::GetHomeSlot so tests can build collisions.
+static INT32U GetHomeSlot(uint64_t address)
+{
+    return (INT32U)((address * 0x9E3779B97F4A7C15ULL) >> 32) & TEST_MASK;
+}
+
+// The next addresses, counting up from *pNext, whose home slot is homeSlot.
+static vector<uint64_t> GetAddressesHomedAt(INT32U homeSlot, INT32U count, uint64_t *pNext)
+{
+    vector<uint64_t> addresses;
+    while (addresses.size() < count)
+    {
+        uint64_t address = (*pNext)++;
+        if (GetHomeSlot(address) == homeSlot)
+            addresses.push_back(address);
+    }
+    return addresses;
+}
+
+// Slot holding the address, found by walking the table in slot order.
+static INT32U GetSlotOf(const CDetectedDeviceIndex &index, uint64_t address)
+{
+    INT32U cursor = 0;
+    const DetectedDeviceEntry *pEntry;
+    while ((pEntry = index.GetNext(&cursor)) != NULL)
+    {
+        if (pEntry->address == address)
+            return cursor - 1;
+    }
+    return 0xFFFFFFFF;
+}
+
+class DetectedDeviceIndexTest : public ::testing::Test
+{
+  protected:
+    DetectedDeviceIndexTest() : m_index(TEST_CAPACITY), m_nextAddress(1)
+    {
+    }
+
+    CDetectedDeviceIndex m_index;
+    uint64_t m_nextAddress;
+};
+
+TEST_F(DetectedDeviceIndexTest, UpsertDedupesWithinAGeneration)
+{
+    bool isNew = false;
+    ASSERT_EQ(STATUS_SUCCESS, m_index.Upsert(0x001122AABBCCULL, "speaker", 100, 1, &isNew));
+    EXPECT_TRUE(isNew);
+    ASSERT_EQ(STATUS_SUCCESS, m_index.Upsert(0x001122AABBCCULL, "speaker 2", 200, 1, &isNew));
+    EXPECT_FALSE(isNew);
+    EXPECT_EQ(1u, m_index.GetSize());
+
+    const DetectedDeviceEntry *pEntry = m_index.Find(0x001122AABBCCULL);
+    ASSERT_TRUE(pEntry != NULL);
+    EXPECT_STREQ("speaker 2", pEntry->name);
+    EXPECT_EQ(200u, pEntry->lastSeenMS);
+
+    // The next inquiry reports it as new again, still in the same slot.
+    ASSERT_EQ(STATUS_SUCCESS, m_index.Upsert(0x001122AABBCCULL, NULL, 300, 2, &isNew));
+    EXPECT_TRUE(isNew);
+    EXPECT_EQ(1u, m_index.GetSize());
+    EXPECT_STREQ("speaker 2", m_index.Find(0x001122AABBCCULL)->name);
+}
+
+TEST_F(DetectedDeviceIndexTest, RejectsTheEmptyAddress)
+{
+    EXPECT_EQ(ERROR_INVALID_PARAMETER, m_index.Upsert(0, "none", 0, 1));
+    // Only the low 48 bits are the address.
+    EXPECT_EQ(ERROR_INVALID_PARAMETER, m_index.Upsert(0xFFFF000000000000ULL, "none", 0, 1));
+    EXPECT_EQ(0u, m_index.GetSize());
+}
+
+TEST_F(DetectedDeviceIndexTest, RemoveInsideAWrappingProbeRun)
+{
+    // Three devices homed at the last slot fill 7, 0 and 1; a fourth homed
+    // at 0 is pushed to 2.
+    vector<uint64_t> atLast = GetAddressesHomedAt(TEST_MASK, 3, &m_nextAddress);
+    vector<uint64_t> atFirst = GetAddressesHomedAt(0, 1, &m_nextAddress);
+    for (size_t i = 0; i < atLast.size(); i++)
+    {
+        ASSERT_EQ(STATUS_SUCCESS, m_index.Upsert(atLast[i], "last", 0, 1));
+    }
+    ASSERT_EQ(STATUS_SUCCESS, m_index.Upsert(atFirst[0], "first", 0, 1));
+    ASSERT_EQ(7u, GetSlotOf(m_index, atLast[0]));
+    ASSERT_EQ(0u, GetSlotOf(m_index, atLast[1]));
+    ASSERT_EQ(1u, GetSlotOf(m_index, atLast[2]));
+    ASSERT_EQ(2u, GetSlotOf(m_index, atFirst[0]));
+
+    // Removing from the middle of the run shifts the rest back past the end
+    // of the table, and nothing is left behind the hole.
+    EXPECT_TRUE(m_index.Remove(atLast[1]));
+    EXPECT_EQ(3u, m_index.GetSize());
+    EXPECT_TRUE(m_index.Find(atLast[1]) == NULL);
+    EXPECT_EQ(0u, GetSlotOf(m_index, atLast[2]));
+    EXPECT_EQ(1u, GetSlotOf(m_index, atFirst[0]));
+    EXPECT_TRUE(m_index.Find(atLast[0]) != NULL);
+    EXPECT_TRUE(m_index.Find(atLast[2]) != NULL);
+    EXPECT_TRUE(m_index.Find(atFirst[0]) != NULL);
+
+    // Removing the head of the run pulls the wrapped entry back to 7, but
+    // the one homed at 0 must stay at or after its home.
+    EXPECT_TRUE(m_index.Remove(atLast[0]));
+    EXPECT_EQ(7u, GetSlotOf(m_index, atLast[2]));
+    EXPECT_EQ(0u, GetSlotOf(m_index, atFirst[0]));
+    EXPECT_FALSE(m_index.Remove(atLast[0]));
+    EXPECT_EQ(2u, m_index.GetSize());
+}
+
+TEST_F(DetectedDeviceIndexTest, AgeOutAcrossTheClockWrap)
+{
+    // Seen just before the millisecond clock wraps, checked just after it.
+    vector<uint64_t> run = GetAddressesHomedAt(TEST_MASK, 3, &m_nextAddress);
+    ASSERT_EQ(STATUS_SUCCESS, m_index.Upsert(run[0], "old", 0xFFFFFF00, 1));
+    ASSERT_EQ(STATUS_SUCCESS, m_index.Upsert(run[1], "old", 0xFFFFFF10, 1));
+    ASSERT_EQ(STATUS_SUCCESS, m_index.Upsert(run[2], "recent", 0xFFFFFFF0, 1));
+    uint64_t other = GetAddressesHomedAt(3, 1, &m_nextAddress)[0];
+    ASSERT_EQ(STATUS_SUCCESS, m_index.Upsert(other, "recent", 0x00000010, 1));
+
+    // 0x200 and 0x1F0 ms old go; 0x110 and 0xF0 ms old stay. Each removal
+    // shifts the rest of the run into the slot just checked, the last one
+    // back across the end of the table.
+    EXPECT_EQ(2u, m_index.AgeOut(0x00000100, 0x180));
+    EXPECT_EQ(2u, m_index.GetSize());
+    EXPECT_TRUE(m_index.Find(run[0]) == NULL);
+    EXPECT_TRUE(m_index.Find(run[1]) == NULL);
+    EXPECT_EQ(7u, GetSlotOf(m_index, run[2]));
+    EXPECT_TRUE(m_index.Find(other) != NULL);
+}
+
+TEST_F(DetectedDeviceIndexTest, GrowKeepsEveryEntry)
+{
+    for (uint64_t address = 1; address <= 100; address++)
+    {
+        ASSERT_EQ(STATUS_SUCCESS, m_index.Upsert(address << 8, "device", (INT32U)address, 1));
+    }
+    EXPECT_EQ(100u, m_index.GetSize());
+
+    INT32U walked = 0;
+    INT32U cursor = 0;
+    while (m_index.GetNext(&cursor) != NULL)
+    {
+        walked++;
+    }
+    EXPECT_EQ(100u, walked);
+
+    for (uint64_t address = 1; address <= 100; address++)
+    {
+        const DetectedDeviceEntry *pEntry = m_index.Find(address << 8);
+        ASSERT_TRUE(pEntry != NULL) << address;
+        EXPECT_EQ((INT32U)address, pEntry->lastSeenMS);
+    }
+}
@@ -0,0 +1,213 @@
+#include <gtest/gtest.h>
+
+#include "DeviceStatusCache.h"
+#include "ReconnectStateMachine.h"
+#include "VirtualClockTest.h"
+
+#define TEST_TICK_MS 100
+#define TEST_TICKS 20
+
+// The driver's three link queries, counted one by one.
+class CFakeStatusDriver
+{
+  public:
+    CFakeStatusDriver() : ready(true), connected(true), paired(true), fail(false)
+    {
+        for (INT32U i = 0; i < DEVICE_STATUS_FIELD_COUNT; i++)
+        {
+            queries[i] = 0;
+        }
+    }
+
+    ERROR_CODE_T Query(DeviceStatusField_t field, bool &valueOut)
+    {
+        queries[field]++;
+        if (fail)
+            return ERROR_FAILED;
+
+        valueOut = (field == DEVICE_STATUS_READY) ? ready : (field == DEVICE_STATUS_CONNECTED) ? connected : paired;
+        return STATUS_SUCCESS;
+    }
+
+    INT32U GetQueryCount(void) const
+    {
+        return queries[DEVICE_STATUS_READY] + queries[DEVICE_STATUS_CONNECTED] + queries[DEVICE_STATUS_PAIRED];
+    }
+
+    bool ready;
+    bool connected;
+    bool paired;
+    bool fail;
+    INT32U queries[DEVICE_STATUS_FIELD_COUNT];
+};
+
+// The card's status path: readiness gates every tick, the reconnect state
+// machine reads the link through the cache, and link changes invalidate it.
+// Counts every check, which is what each would have cost without the cache.
+class CStatusCard : public IReconnectActions
+{
+  public:
+    CStatusCard(CFakeStatusDriver &driver, INT32U ttlMS)
+        : m_status([&driver](DeviceStatusField_t field, bool &valueOut) { return driver.Query(field, valueOut); },
+                   ttlMS),
+          m_reconnect(this), m_hasDetectedDevices(false), m_checks(0)
+    {
+    }
+
+    ERROR_CODE_T Tick(void)
+    {
+        m_checks++;
+        RETURN_EC_IF_FALSE(ERROR_NOT_INITIALIZED, m_status.IsReady());
+
+        ReconnectState_t previousState = m_reconnect.GetState();
+        m_reconnect.Poll();
+        if ((m_reconnect.GetState() == RECONNECT_STATE_CONNECTED) != (previousState == RECONNECT_STATE_CONNECTED))
+        {
+            m_status.Invalidate();
+        }
+
+        if (m_reconnect.GetState() == RECONNECT_STATE_CONNECTED && m_hasDetectedDevices)
+        {
+            m_checks++;
+            m_hasDetectedDevices = m_status.IsPaired();
+        }
+        return STATUS_SUCCESS;
+    }
+
+    virtual ERROR_CODE_T RunInquiry(void)
+    {
+        return STATUS_SUCCESS;
+    }
+
+    virtual bool IsConnected(void)
+    {
+        m_checks++;
+        return m_status.IsConnected();
+    }
+
+    CDeviceStatusCache m_status;
+    CReconnectStateMachine m_reconnect;
+    bool m_hasDetectedDevices;
+    INT32U m_checks;
+};
+
+class DeviceStatusCacheTest : public VirtualClockTest
+{
+  protected:
+    DeviceStatusCacheTest() : VirtualClockTest(false)
+    {
+    }
+
+    DeviceStatusFetch GetFetch(void)
+    {
+        return [this](DeviceStatusField_t field, bool &valueOut) { return m_driver.Query(field, valueOut); };
+    }
+
+    void RunTicks(CStatusCard &card, INT32U ticks)
+    {
+        for (INT32U i = 0; i < ticks; i++)
+        {
+            EXPECT_EQ(STATUS_SUCCESS, card.Tick());
+            m_clock.Advance(TEST_TICK_MS * 1000);
+        }
+    }
+
+    CFakeStatusDriver m_driver;
+};
+
+TEST_F(DeviceStatusCacheTest, TtlZeroCostsWhatUncachedChecksDid)
+{
+    CStatusCard card(m_driver, 0);
+    card.m_hasDetectedDevices = true;
+    RunTicks(card, TEST_TICKS);
+
+    // One query per check, and only for the field checked: readiness and
+    // the link every tick, pairing while there were detected devices.
+    EXPECT_EQ(card.m_checks, m_driver.GetQueryCount());
+    EXPECT_EQ((INT32U)TEST_TICKS, m_driver.queries[DEVICE_STATUS_READY]);
+    EXPECT_EQ((INT32U)TEST_TICKS, m_driver.queries[DEVICE_STATUS_CONNECTED]);
+    EXPECT_EQ((INT32U)TEST_TICKS, m_driver.queries[DEVICE_STATUS_PAIRED]);
+    EXPECT_EQ(0u, card.m_status.GetHitCount());
+}
+
+TEST_F(DeviceStatusCacheTest, DefaultTtlCutsQueriesOnASteadyLink)
+{
+    CStatusCard card(m_driver, DEVICE_STATUS_DEFAULT_TTL_MS);
+    RunTicks(card, TEST_TICKS);
+
+    // The first tick's connect invalidates, so the second tick asks again;
+    // from then on each field is asked once per 500 ms: at 100, 600, 1100
+    // and 1600 ms.
+    EXPECT_EQ(5u, m_driver.queries[DEVICE_STATUS_READY]);
+    EXPECT_EQ(5u, m_driver.queries[DEVICE_STATUS_CONNECTED]);
+    EXPECT_EQ(0u, m_driver.queries[DEVICE_STATUS_PAIRED]);
+    EXPECT_EQ(2u * TEST_TICKS, card.m_checks);
+    EXPECT_EQ(card.m_checks - m_driver.GetQueryCount(), card.m_status.GetHitCount());
+}
+
+TEST_F(DeviceStatusCacheTest, DroppedLinkIsSeenWithinTtlAndInvalidates)
+{
+    CStatusCard card(m_driver, DEVICE_STATUS_DEFAULT_TTL_MS);
+    RunTicks(card, 2);
+    ASSERT_EQ(RECONNECT_STATE_CONNECTED, card.m_reconnect.GetState());
+
+    m_driver.connected = false;
+    RunTicks(card, DEVICE_STATUS_DEFAULT_TTL_MS / TEST_TICK_MS);
+    EXPECT_NE(RECONNECT_STATE_CONNECTED, card.m_reconnect.GetState());
+
+    // The disconnect dropped the cached readiness too.
+    INT32U readyQueries = m_driver.queries[DEVICE_STATUS_READY];
+    EXPECT_EQ(STATUS_SUCCESS, card.Tick());
+    EXPECT_EQ(readyQueries + 1, m_driver.queries[DEVICE_STATUS_READY]);
+}
+
+TEST_F(DeviceStatusCacheTest, FieldsAreCachedIndependently)
+{
+    CDeviceStatusCache status(GetFetch(), 500);
+
+    EXPECT_TRUE(status.IsReady());
+    EXPECT_TRUE(status.IsReady());
+    EXPECT_EQ(1u, m_driver.GetQueryCount());
+
+    EXPECT_TRUE(status.IsPaired());
+    EXPECT_EQ(1u, m_driver.queries[DEVICE_STATUS_PAIRED]);
+    EXPECT_EQ(0u, m_driver.queries[DEVICE_STATUS_CONNECTED]);
+}
+
+TEST_F(DeviceStatusCacheTest, ServesValueUntilTtlExpires)
+{
+    CDeviceStatusCache status(GetFetch(), 500);
+    EXPECT_TRUE(status.IsConnected());
+    m_driver.connected = false;
+
+    m_clock.Advance(499000);
+    EXPECT_TRUE(status.IsConnected());
+    EXPECT_EQ(1u, status.GetFetchCount());
+    EXPECT_EQ(1u, status.GetHitCount());
+
+    m_clock.Advance(1000);
+    EXPECT_FALSE(status.IsConnected());
+    EXPECT_EQ(2u, status.GetFetchCount());
+}
+
+TEST_F(DeviceStatusCacheTest, InvalidateForcesRefresh)
+{
+    CDeviceStatusCache status(GetFetch(), 500);
+    EXPECT_TRUE(status.IsConnected());
+    m_driver.connected = false;
+
+    status.Invalidate();
+    EXPECT_FALSE(status.IsConnected());
+    EXPECT_EQ(2u, status.GetFetchCount());
+}
+
+TEST_F(DeviceStatusCacheTest, FailedFetchIsNotCached)
+{
+    CDeviceStatusCache status(GetFetch(), 500);
+
+    m_driver.fail = true;
+    EXPECT_FALSE(status.IsReady());
+    m_driver.fail = false;
+    EXPECT_TRUE(status.IsReady());
+    EXPECT_EQ(2u, m_driver.queries[DEVICE_STATUS_READY]);
+}
@@ -0,0 +1,413 @@
+#include <gtest/gtest.h>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "EventSocketServer.h"
+
+#define TEST_WAIT_MS 2000
+// Long enough for the server thread to go round its poll loop a few times.
+#define TEST_SETTLE_MS 300
+#define TEST_BACKLOG_EVENTS 3000
+#define TEST_NAME_SIZE 200
+#define TEST_COMMAND 2
+
+static void PutU32(vector<INT8U> &buffer, INT32U value)
+{
+    for (INT32U i = 0; i < 4; i++)
+    {
+        buffer.push_back((INT8U)(value >> (8 * i)));
+    }
+}
+
+static INT32U GetU32(const INT8U *pData)
+{
+    return (INT32U)pData[0] | ((INT32U)pData[1] << 8) | ((INT32U)pData[2] << 16) | ((INT32U)pData[3] << 24);
+}
+
+static uint64_t GetU64(const INT8U *pData)
+{
+    return (uint64_t)GetU32(pData) | ((uint64_t)GetU32(pData + 4) << 32);
+}
+
+static vector<INT8U> MakeFrame(INT8U type, const vector<INT8U> &payload)
+{
+    vector<INT8U> frame;
+    PutU32(frame, (INT32U)payload.size());
+    frame.push_back(type);
+    frame.insert(frame.end(), payload.begin(), payload.end());
+    return frame;
+}
+
+static vector<INT8U> MakeSubscribe(INT32U mask)
+{
+    vector<INT8U> payload;
+    PutU32(payload, mask);
+    return MakeFrame(EVENT_MSG_SUBSCRIBE, payload);
+}
+
+static vector<INT8U> MakeCommand(INT32U requestId, INT8U cardNumber, INT8U command, INT32U arg)
+{
+    vector<INT8U> payload;
+    PutU32(payload, requestId);
+    payload.push_back(cardNumber);
+    payload.push_back(command);
+    PutU32(payload, arg);
+    return MakeFrame(EVENT_MSG_COMMAND, payload);
+}
+
+static void SendAll(int fd, const vector<INT8U> &data)
+{
+    size_t offset = 0;
+    while (offset < data.size())
+    {
+        ssize_t sent = send(fd, &data[offset], data.size() - offset, MSG_NOSIGNAL);
+        ASSERT_GT(sent, 0);
+        offset += (size_t)sent;
+    }
+}
+
+// Fills the buffer or fails on a timeout or a closed socket.
+static bool ReadExactly(int fd, INT8U *pBuffer, size_t length, int timeoutMS)
+{
+    size_t offset = 0;
+    while (offset < length)
+    {
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        if (poll(&pfd, 1, timeoutMS) <= 0)
+            return false;
+
+        ssize_t received = recv(fd, pBuffer + offset, length - offset, 0);
+        if (received <= 0)
+            return false;
+        offset += (size_t)received;
+    }
+    return true;
+}
+
+static bool ReadFrame(int fd, INT8U &typeOut, vector<INT8U> &payloadOut, int timeoutMS = TEST_WAIT_MS)
+{
+    INT8U header[EVENT_FRAME_HEADER_SIZE];
+    if (!ReadExactly(fd, header, sizeof(header), timeoutMS))
+        return false;
+
+    typeOut = header[4];
+    payloadOut.resize(GetU32(header));
+    return payloadOut.empty() || ReadExactly(fd, &payloadOut[0], payloadOut.size(), timeoutMS);
+}
+
+// True once the server has closed its end.
+static bool WaitForClose(int fd)
+{
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    INT8U byte;
+    return poll(&pfd, 1, TEST_WAIT_MS) == 1 && recv(fd, &byte, 1, 0) == 0;
+}
+
+static SocketEvent MakeEvent(INT8U type, INT8U cardNumber, uint64_t address, const string &name = "")
+{
+    SocketEvent event;
+    event.type = type;
+    event.cardNumber = cardNumber;
+    event.address = address;
+    event.name = name;
+    return event;
+}
+
+class EventSocketServerTest : public ::testing::Test
+{
+  protected:
+    void SetUp() override
+    {
+        m_path = string("/tmp/bta-events-test-") + to_string(getpid()) + ".sock";
+        ASSERT_EQ(STATUS_SUCCESS, m_server.Start(m_path));
+        m_server.SetCommandHandler([this](INT8U cardNumber, INT8U command, INT32U arg, SocketCommandDone done) {
+            {
+                lock_guard<mutex> guard(m_lock);
+                m_commands.push_back(MakeCommand(0, cardNumber, command, arg));
+            }
+            done(ERROR_FAILED);
+        });
+    }
+
+    void TearDown() override
+    {
+        m_server.Stop();
+        for (size_t i = 0; i < m_fds.size(); i++)
+        {
+            close(m_fds[i]);
+        }
+    }
+
+    // Attaches one end of a socketpair and returns the other once the
+    // server has picked it up. A nonzero buffer size shrinks both ends'
+    // socket buffers so a client that doesn't read backs up quickly.
+    int Attach(int bufferSize = 0)
+    {
+        int fds[2];
+        EXPECT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+        if (bufferSize != 0)
+        {
+            setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof(bufferSize));
+            setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+        }
+
+        INT32U clients = m_server.GetClientCount();
+        EXPECT_EQ(STATUS_SUCCESS, m_server.AttachClient(fds[0]));
+        EXPECT_TRUE(WaitFor([&]() { return m_server.GetClientCount() == clients + 1; }));
+        m_fds.push_back(fds[1]);
+        return fds[1];
+    }
+
+    bool WaitFor(function<bool(void)> condition)
+    {
+        for (INT32U elapsedMS = 0; elapsedMS < TEST_WAIT_MS; elapsedMS += 10)
+        {
+            if (condition())
+                return true;
+            this_thread::sleep_for(chrono::milliseconds(10));
+        }
+        return condition();
+    }
+
+    size_t GetCommandCount(void)
+    {
+        lock_guard<mutex> guard(m_lock);
+        return m_commands.size();
+    }
+
+    string m_path;
+    CEventSocketServer m_server;
+    vector<int> m_fds;
+    mutex m_lock;
+    vector<vector<INT8U> > m_commands;
+};
+
+TEST_F(EventSocketServerTest, CommandSplitAcrossWritesIsAnswered)
+{
+    int fd = Attach();
+
+    // One byte per write, so the server sees every partial header and
+    // payload.
+    vector<INT8U> frame = MakeCommand(0x01020304, 7, TEST_COMMAND, 0xA0B0C0D0);
+    for (size_t i = 0; i < frame.size(); i++)
+    {
+        SendAll(fd, vector<INT8U>(1, frame[i]));
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+
+    INT8U type;
+    vector<INT8U> payload;
+    ASSERT_TRUE(ReadFrame(fd, type, payload));
+    EXPECT_EQ(EVENT_MSG_COMMAND_RESULT, type);
+    ASSERT_EQ(8u, payload.size());
+    EXPECT_EQ(0x01020304u, GetU32(&payload[0]));
+    EXPECT_EQ((INT32U)ERROR_FAILED, GetU32(&payload[4]));
+
+    ASSERT_EQ(1u, GetCommandCount());
+    EXPECT_EQ(MakeCommand(0, 7, TEST_COMMAND, 0xA0B0C0D0), m_commands[0]);
+}
+
+TEST_F(EventSocketServerTest, FramesInOneWriteAreAllHandled)
+{
+    int fd = Attach();
+
+    vector<INT8U> frames = MakeSubscribe(1u << 2);
+    vector<INT8U> command = MakeCommand(9, 1, TEST_COMMAND, 0);
+    frames.insert(frames.end(), command.begin(), command.end());
+    SendAll(fd, frames);
+
+    INT8U type;
+    vector<INT8U> payload;
+    ASSERT_TRUE(ReadFrame(fd, type, payload));
+    EXPECT_EQ(EVENT_MSG_COMMAND_RESULT, type);
+    EXPECT_EQ(9u, GetU32(&payload[0]));
+
+    // The subscription in the same write took effect too.
+    m_server.Publish(MakeEvent(2, 1, 0x112233445566ull, "speaker"));
+    ASSERT_TRUE(ReadFrame(fd, type, payload));
+    EXPECT_EQ(EVENT_MSG_EVENT, type);
+    ASSERT_EQ(11u + 7u, payload.size());
+    EXPECT_EQ(2, payload[0]);
+    EXPECT_EQ(1, payload[1]);
+    EXPECT_EQ(0x112233445566ull, GetU64(&payload[2]));
+    EXPECT_EQ(7, payload[10]);
+    EXPECT_EQ("speaker", string(payload.begin() + 11, payload.end()));
+}
+
+TEST_F(EventSocketServerTest, MalformedFramesCloseTheClient)
+{
+    vector<INT8U> oversized;
+    PutU32(oversized, EVENT_MAX_PAYLOAD_SIZE + 1);
+    oversized.push_back(EVENT_MSG_COMMAND);
+
+    vector<vector<INT8U> > frames;
+    frames.push_back(oversized);
+    frames.push_back(MakeFrame(0x7F, vector<INT8U>()));
+    frames.push_back(MakeFrame(EVENT_MSG_SUBSCRIBE, vector<INT8U>(5, 0)));
+    frames.push_back(MakeFrame(EVENT_MSG_COMMAND, vector<INT8U>(9, 0)));
+
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        int fd = Attach();
+        SendAll(fd, frames[i]);
+        EXPECT_TRUE(WaitForClose(fd));
+        EXPECT_TRUE(WaitFor([&]() { return m_server.GetClientCount() == 0; }));
+    }
+    EXPECT_EQ(0u, GetCommandCount());
+}
+
+TEST_F(EventSocketServerTest, SubscriptionFiltersByTypeAndCard)
+{
+    int all = Attach();
+    int filtered = Attach();
+    int none = Attach();
+
+    SendAll(all, MakeSubscribe(0xFFFFFFFF));
+
+    // Type 1 only, and only cards 3 and 200.
+    vector<INT8U> payload;
+    PutU32(payload, 1u << 1);
+    payload.resize(36, 0);
+    payload[4 + 3 / 8] |= 1 << (3 % 8);
+    payload[4 + 200 / 8] |= 1 << (200 % 8);
+    SendAll(filtered, MakeFrame(EVENT_MSG_SUBSCRIBE, payload));
+
+    // A command round trip on each client makes sure the server has read
+    // its subscription before anything is published.
+    INT8U type;
+    SendAll(all, MakeCommand(1, 0, TEST_COMMAND, 0));
+    ASSERT_TRUE(ReadFrame(all, type, payload));
+    SendAll(filtered, MakeCommand(1, 0, TEST_COMMAND, 0));
+    ASSERT_TRUE(ReadFrame(filtered, type, payload));
+
+    m_server.Publish(MakeEvent(1, 3, 1));
+    m_server.Publish(MakeEvent(2, 3, 2));
+    m_server.Publish(MakeEvent(1, 4, 3));
+    m_server.Publish(MakeEvent(1, 200, 4));
+    // Types past the mask's 32 bits reach no one.
+    m_server.Publish(MakeEvent(40, 3, 5));
+
+    vector<uint64_t> received;
+    while (ReadFrame(all, type, payload, TEST_SETTLE_MS))
+    {
+        ASSERT_EQ(EVENT_MSG_EVENT, type);
+        received.push_back(GetU64(&payload[2]));
+    }
+    EXPECT_EQ(vector<uint64_t>({1, 2, 3, 4}), received);
+
+    received.clear();
+    while (ReadFrame(filtered, type, payload, TEST_SETTLE_MS))
+    {
+        ASSERT_EQ(EVENT_MSG_EVENT, type);
+        received.push_back(GetU64(&payload[2]));
+    }
+    EXPECT_EQ(vector<uint64_t>({1, 4}), received);
+
+    // Without a subscription a client gets nothing.
+    EXPECT_FALSE(ReadFrame(none, type, payload, TEST_SETTLE_MS));
+    EXPECT_EQ(0u, m_server.GetDroppedCount());
+}
+
+TEST_F(EventSocketServerTest, BackloggedClientLosesEventsAndIsToldOnceItCatchesUp)
+{
+    int fd = Attach(4096);
+    SendAll(fd, MakeSubscribe(1u << 1));
+    INT8U type;
+    vector<INT8U> payload;
+    SendAll(fd, MakeCommand(1, 0, TEST_COMMAND, 0));
+    ASSERT_TRUE(ReadFrame(fd, type, payload));
+
+    // Far more than the client buffer limit, with the client not reading.
+    // The first burst overflows it; whatever the socket then took is made up
+    // by the second, so the client is left at the limit with nothing more
+    // going out.
+    string name(TEST_NAME_SIZE, 'n');
+    uint64_t published = 0;
+    for (INT32U burst = 0; burst < 2; burst++)
+    {
+        for (INT32U i = 0; i < TEST_BACKLOG_EVENTS; i++)
+        {
+            m_server.Publish(MakeEvent(1, 0, published++, name));
+        }
+
+        // The dropped count stops moving once the server has worked through
+        // every publish.
+        ASSERT_TRUE(WaitFor([&]() {
+            INT32U before = m_server.GetDroppedCount();
+            this_thread::sleep_for(chrono::milliseconds(TEST_SETTLE_MS));
+            return before != 0 && before == m_server.GetDroppedCount();
+        }));
+    }
+    INT32U dropped = m_server.GetDroppedCount();
+    EXPECT_LT(dropped, (INT32U)published);
+
+    // A backlogged client's commands aren't read, since their results
+    // couldn't be dropped like the events it isn't reading either.
+    size_t commands = GetCommandCount();
+    SendAll(fd, MakeCommand(2, 0, TEST_COMMAND, 0));
+    this_thread::sleep_for(chrono::milliseconds(TEST_SETTLE_MS));
+    EXPECT_EQ(commands, GetCommandCount());
+
+    // Draining gets the events that fit, in order, and the count of the
+    // ones that didn't, and the held-back command is answered.
+    INT32U delivered = 0;
+    INT32U reportedDropped = 0;
+    uint64_t lastAddress = 0;
+    bool answered = false;
+    while (!answered || delivered + reportedDropped < published)
+    {
+        ASSERT_TRUE(ReadFrame(fd, type, payload));
+        if (type == EVENT_MSG_EVENT)
+        {
+            uint64_t address = GetU64(&payload[2]);
+            ASSERT_TRUE(delivered == 0 || address > lastAddress);
+            lastAddress = address;
+            delivered++;
+        }
+        else if (type == EVENT_MSG_DROPPED)
+        {
+            ASSERT_EQ(4u, payload.size());
+            reportedDropped += GetU32(&payload[0]);
+        }
+        else
+        {
+            ASSERT_EQ(EVENT_MSG_COMMAND_RESULT, type);
+            EXPECT_EQ(2u, GetU32(&payload[0]));
+            answered = true;
+        }
+    }
+
+    EXPECT_EQ(dropped, reportedDropped);
+    EXPECT_EQ(published, delivered + reportedDropped);
+    EXPECT_EQ(commands + 1, GetCommandCount());
+
+    // Caught up, it gets new events again.
+    m_server.Publish(MakeEvent(1, 0, published, name));
+    ASSERT_TRUE(ReadFrame(fd, type, payload));
+    EXPECT_EQ(EVENT_MSG_EVENT, type);
+    EXPECT_EQ(published, GetU64(&payload[2]));
+    EXPECT_EQ(dropped, m_server.GetDroppedCount());
+}
+
+TEST_F(EventSocketServerTest, AttachAfterStopIsRejected)
+{
+    m_server.Stop();
+    int fds[2];
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    m_fds.push_back(fds[1]);
+    EXPECT_EQ(ERROR_NOT_INITIALIZED, m_server.AttachClient(fds[0]));
+    // The server closed its end.
+    EXPECT_TRUE(WaitForClose(fds[1]));
+}
@@ -0,0 +1,212 @@
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+
+#include "FakeUart.h"
+#include "FaultInjectingUart.h"
+#include "VirtualClockTest.h"
+
+#define TEST_PAYLOAD_SIZE 1000
+
+static string MakePayload(void)
+{
+    string payload;
+    for (INT32U i = 0; i < TEST_PAYLOAD_SIZE; i++)
+    {
+        payload += (CHAR8)('a' + i % 26);
+    }
+    return payload;
+}
+
+static UartFaultConfig ParseConfig(const string &spec)
+{
+    UartFaultConfig config;
+    EXPECT_EQ(STATUS_SUCCESS, config.Parse(spec));
+    return config;
+}
+
+// Reads until the fake has nothing left, as the driver's receive loop does.
+static string ReadAll(IUart &uart)
+{
+    string received;
+    INT8U buf[64];
+    INT32U bytesRead;
+    do
+    {
+        uart.ReadPort(buf, sizeof(buf), &bytesRead);
+        received.append(reinterpret_cast<CHAR8 *>(buf), bytesRead);
+    } while (bytesRead > 0 || uart.RxBytesAvailable() > 0);
+    return received;
+}
+
+class FaultInjectingUartTest : public VirtualClockTest
+{
+  protected:
+    FaultInjectingUartTest() : VirtualClockTest(true), m_pFake(make_shared<CFakeUart>())
+    {
+    }
+
+    shared_ptr<CFakeUart> m_pFake;
+};
+
+TEST_F(FaultInjectingUartTest, SameSeedGivesSameFaults)
+{
+    string payload = MakePayload();
+    string written[3];
+    string received[3];
+    UartFaultStats stats[3];
+    const CHAR8 *specs[3] = {"drop=50000,corrupt=50000,seed=7", "drop=50000,corrupt=50000,seed=7",
+                             "drop=50000,corrupt=50000,seed=8"};
+
+    for (INT32U run = 0; run < 3; run++)
+    {
+        shared_ptr<CFakeUart> pFake = make_shared<CFakeUart>();
+        CFaultInjectingUart uart(pFake, ParseConfig(specs[run]));
+
+        INT32U bytesWritten;
+        uart.WritePort(reinterpret_cast<const INT8U *>(payload.data()), payload.size(), &bytesWritten);
+        // Dropped bytes are still reported as written.
+        EXPECT_EQ((INT32U)payload.size(), bytesWritten);
+        written[run] = pFake->m_written;
+
+        pFake->QueueRx(payload);
+        received[run] = ReadAll(uart);
+        stats[run] = uart.GetStats();
+    }
+
+    EXPECT_EQ(written[0], written[1]);
+    EXPECT_EQ(received[0], received[1]);
+    EXPECT_EQ(stats[0].bytesDropped, stats[1].bytesDropped);
+    EXPECT_EQ(stats[0].bytesCorrupted, stats[1].bytesCorrupted);
+
+    EXPECT_NE(payload, written[0]);
+    EXPECT_LT(written[0].size(), payload.size());
+    EXPECT_NE(payload, received[0]);
+    EXPECT_GT(stats[0].bytesDropped, 0u);
+    EXPECT_GT(stats[0].bytesCorrupted, 0u);
+
+    EXPECT_NE(written[0], written[2]);
+}
+
+TEST_F(FaultInjectingUartTest, PassThroughWithoutFaults)
+{
+    CFaultInjectingUart uart(m_pFake, UartFaultConfig());
+    string payload = MakePayload();
+
+    uart.WriteString(payload.c_str());
+    EXPECT_EQ(payload, m_pFake->m_written);
+
+    m_pFake->QueueRx(payload);
+    EXPECT_EQ(payload, ReadAll(uart));
+    EXPECT_EQ(0u, uart.GetStats().bytesDropped);
+    EXPECT_EQ(0u, uart.GetStats().bytesCorrupted);
+}
+
+TEST_F(FaultInjectingUartTest, ChunkedReadsNeverExceedMaxReadChunk)
+{
+    CFaultInjectingUart uart(m_pFake, ParseConfig("chunk=4,seed=3"));
+    string payload = MakePayload();
+    m_pFake->QueueRx(payload);
+
+    string received;
+    INT8U buf[64];
+    while (received.size() < payload.size())
+    {
+        INT32U bytesRead = 0;
+        uart.ReadPort(buf, sizeof(buf), &bytesRead);
+        ASSERT_GE(bytesRead, 1u);
+        ASSERT_LE(bytesRead, 4u);
+        received.append(reinterpret_cast<CHAR8 *>(buf), bytesRead);
+    }
+
+    EXPECT_EQ(payload, received);
+    EXPECT_GT(uart.GetStats().fragmentedReads, 0u);
+}
+
+TEST_F(FaultInjectingUartTest, LinkDownDropsIo)
+{
+    CFaultInjectingUart uart(m_pFake, UartFaultConfig());
+    m_pFake->QueueRx("OK\r");
+
+    uart.SetLinkDown(true);
+    INT32U bytesWritten = 0;
+    uart.WritePort(reinterpret_cast<const INT8U *>("AT\r"), 3, &bytesWritten);
+    EXPECT_EQ(3u, bytesWritten);
+    EXPECT_EQ("", m_pFake->m_written);
+
+    INT8U buf[16];
+    INT32U bytesRead = 1;
+    uart.ReadPort(buf, sizeof(buf), &bytesRead);
+    EXPECT_EQ(0u, bytesRead);
+    EXPECT_EQ(0u, uart.RxBytesAvailable());
+    EXPECT_EQ(3u, m_pFake->RxBytesAvailable());
+
+    uart.SetLinkDown(false);
+    uart.WriteString("AT\r");
+    EXPECT_EQ("AT\r", m_pFake->m_written);
+    EXPECT_EQ("OK\r", ReadAll(uart));
+}
+
+TEST_F(FaultInjectingUartTest, ByteHelpersGoThroughThePortCalls)
+{
+    CFaultInjectingUart uart(m_pFake, UartFaultConfig());
+
+    // The fake's own word and dword calls do nothing, so these bytes can
+    // only have come through WritePort.
+    uart.WriteByte(0x01);
+    uart.WriteWord(0x0302);
+    uart.WriteDWord(0x07060504);
+    EXPECT_EQ(string("\x01\x02\x03\x04\x05\x06\x07", 7), m_pFake->m_written);
+
+    m_pFake->QueueRx(string("\x11\x22\x33\x44\x55\x66\x77", 7));
+    INT8U byte = 0;
+    INT16U word = 0;
+    INT32U dword = 0;
+    EXPECT_TRUE(uart.ReadByte(&byte));
+    EXPECT_TRUE(uart.ReadWord(&word));
+    EXPECT_TRUE(uart.ReadDWord(&dword));
+    EXPECT_EQ(0x11, byte);
+    EXPECT_EQ(0x3322, word);
+    EXPECT_EQ(0x77665544u, dword);
+    EXPECT_FALSE(uart.ReadByte(&byte));
+
+    uart.SetLinkDown(true);
+    m_pFake->QueueRx("x");
+    EXPECT_FALSE(uart.ReadByte(&byte));
+}
+
+TEST(UartFaultConfigTest, ParsesEveryKey)
+{
+    UartFaultConfig config;
+    ASSERT_EQ(STATUS_SUCCESS,
+              config.Parse("latency=2000,jitter=500,drop=100,corrupt=50,chunk=4,stall=1000:50000,seed=7"));
+    EXPECT_EQ(2000u, config.latencyUs);
+    EXPECT_EQ(500u, config.jitterUs);
+    EXPECT_EQ(100u, config.dropPerMillion);
+    EXPECT_EQ(50u, config.corruptPerMillion);
+    EXPECT_EQ(4u, config.maxReadChunk);
+    EXPECT_EQ(1000u, config.stallPerMillion);
+    EXPECT_EQ(50000u, config.stallUs);
+    EXPECT_EQ(7u, config.seed);
+
+    // Empty items are skipped and left-out keys keep their defaults.
+    UartFaultConfig defaults;
+    ASSERT_EQ(STATUS_SUCCESS, defaults.Parse(",drop=1,,"));
+    EXPECT_EQ(1u, defaults.dropPerMillion);
+    EXPECT_EQ(0u, defaults.latencyUs);
+    EXPECT_EQ(1u, defaults.seed);
+}
+
+TEST(UartFaultConfigTest, RejectsBadSpecs)
+{
+    const CHAR8 *specs[] = {"drop", "drop=", "drop=abc", "drop=10x", "=10", "bogus=1", "stall=1000", "stall=1000:",
+                            "stall=:50000", "drop=1000001", "corrupt=1000001", "stall=1000001:1", "seed=-1",
+                            "seed=4294967296", "latency=1,jitter"};
+
+    for (size_t i = 0; i < sizeof(specs) / sizeof(specs[0]); i++)
+    {
+        UartFaultConfig config;
+        EXPECT_EQ(ERROR_INVALID_PARAMETER, config.Parse(specs[i])) << specs[i];
+    }
+}
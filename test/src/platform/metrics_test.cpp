@@ -0,0 +1,60 @@
+#include <gtest/gtest.h>
+
+#include "Metrics.h"
+
+TEST(LatencyHistogramTest, EveryValueFallsInsideItsBucket)
+{
+    for (uint64_t value = 0; value < 100000; value += 37)
+    {
+        INT32U index = CLatencyHistogram::GetBucketIndex(value);
+        EXPECT_LE(value, CLatencyHistogram::GetBucketUpperBound(index));
+        if (index > 0)
+        {
+            EXPECT_GT(value, CLatencyHistogram::GetBucketUpperBound(index - 1));
+        }
+    }
+}
+
+TEST(LatencyHistogramTest, CountAtOrBelowIncludesTheBucketHoldingTheBound)
+{
+    CLatencyHistogram histogram;
+    histogram.Record(90);
+    // 1000 shares a bucket with values a little above it.
+    histogram.Record(1000);
+    histogram.Record(5000);
+
+    EXPECT_EQ(0u, histogram.GetCountAtOrBelow(50));
+    EXPECT_EQ(1u, histogram.GetCountAtOrBelow(100));
+    EXPECT_EQ(2u, histogram.GetCountAtOrBelow(1000));
+    EXPECT_EQ(2u, histogram.GetCountAtOrBelow(2500));
+    EXPECT_EQ(3u, histogram.GetCountAtOrBelow(5000));
+}
+
+TEST(LatencyHistogramTest, PercentilesStayWithinOneBucket)
+{
+    CLatencyHistogram histogram;
+    for (uint64_t value = 1; value <= 1000; value++)
+    {
+        histogram.Record(value);
+    }
+
+    EXPECT_EQ(1000u, histogram.GetCount());
+    EXPECT_EQ(1000u, histogram.GetMaxUs());
+    uint64_t median = histogram.GetPercentileUs(50);
+    EXPECT_GE(median, 500u);
+    EXPECT_LE(median, 532u);
+    EXPECT_EQ(1000u, histogram.GetPercentileUs(100));
+}
+
+TEST(MetricsRegistryTest, TimeoutsAreCountedAndExported)
+{
+    CMetricsRegistry &registry = CMetricsRegistry::GetInstance();
+    uint64_t before = registry.GetCounter(200, METRIC_COUNTER_TIMEOUTS);
+    registry.RecordResult(200, "pet", 1500, ERROR_OPERATION_TIMED_OUT);
+    registry.RecordResult(200, "pet", 700, STATUS_SUCCESS);
+    EXPECT_EQ(before + 1, registry.GetCounter(200, METRIC_COUNTER_TIMEOUTS));
+
+    string text;
+    registry.WritePrometheusText(text);
+    EXPECT_NE(string::npos, text.find("bta_timeouts_total{card=\"200\"}"));
+}
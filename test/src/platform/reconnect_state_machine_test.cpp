@@ -0,0 +1,167 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "ReconnectStateMachine.h"
+#include "VirtualClockTest.h"
+
+#define TEST_MIN_BACKOFF_MS 100
+#define TEST_MAX_BACKOFF_MS 300
+
+#define PEER_A "00:11:22:33:44:55"
+#define PEER_B "66:77:88:99:AA:BB"
+
+// Scripted card: each inquiry takes the next queued result, or the default
+// once the queue is empty.
+class CFakeReconnectActions : public IReconnectActions
+{
+  public:
+    CFakeReconnectActions() : inquiryDefault(STATUS_OPERATION_INCOMPLETE), connected(false), inquiryCount(0)
+    {
+    }
+
+    ERROR_CODE_T RunInquiry(void) override
+    {
+        inquiryCount++;
+        if (inquiryResults.empty())
+            return inquiryDefault;
+        ERROR_CODE_T result = inquiryResults.front();
+        inquiryResults.erase(inquiryResults.begin());
+        return result;
+    }
+
+    bool IsConnected(void) override
+    {
+        return connected;
+    }
+
+    ERROR_CODE_T inquiryDefault;
+    vector<ERROR_CODE_T> inquiryResults;
+    bool connected;
+    INT32U inquiryCount;
+};
+
+class ReconnectStateMachineTest : public VirtualClockTest
+{
+  protected:
+    ReconnectStateMachineTest() : VirtualClockTest(false), m_reconnect(&m_actions, TEST_MIN_BACKOFF_MS, TEST_MAX_BACKOFF_MS)
+    {
+    }
+
+    void AdvanceMS(INT32U ms)
+    {
+        m_clock.Advance((uint64_t)ms * 1000);
+    }
+
+    CFakeReconnectActions m_actions;
+    CReconnectStateMachine m_reconnect;
+};
+
+TEST_F(ReconnectStateMachineTest, AlreadyConnectedSkipsInquiry)
+{
+    m_actions.connected = true;
+    EXPECT_EQ(STATUS_SUCCESS, m_reconnect.Poll());
+    EXPECT_EQ(RECONNECT_STATE_CONNECTED, m_reconnect.GetState());
+    EXPECT_EQ(0u, m_actions.inquiryCount);
+    // Nothing says who the link is up to.
+    EXPECT_TRUE(m_reconnect.GetPeer().empty());
+}
+
+TEST_F(ReconnectStateMachineTest, PeerIsTheFirstDeviceTheInquiryFound)
+{
+    m_reconnect.Poll();
+    EXPECT_EQ(RECONNECT_STATE_INQUIRY, m_reconnect.GetState());
+    m_reconnect.OnInquiryResult(PEER_A);
+    m_reconnect.OnInquiryResult(PEER_B);
+
+    m_actions.connected = true;
+    m_reconnect.Poll();
+    EXPECT_EQ(RECONNECT_STATE_CONNECTED, m_reconnect.GetState());
+    EXPECT_EQ(PEER_A, m_reconnect.GetPeer());
+}
+
+TEST_F(ReconnectStateMachineTest, LinkDuringBackoffKeepsTheInquiryPeer)
+{
+    m_reconnect.Poll();
+    m_reconnect.OnInquiryResult(PEER_B);
+    m_actions.inquiryResults.push_back(STATUS_SUCCESS);
+    m_reconnect.Poll();
+    EXPECT_EQ(RECONNECT_STATE_BACKOFF, m_reconnect.GetState());
+
+    // Results outside an inquiry are ignored.
+    m_reconnect.OnInquiryResult(PEER_A);
+    m_actions.connected = true;
+    m_reconnect.Poll();
+    EXPECT_EQ(RECONNECT_STATE_CONNECTED, m_reconnect.GetState());
+    EXPECT_EQ(PEER_B, m_reconnect.GetPeer());
+}
+
+TEST_F(ReconnectStateMachineTest, FailedInquiryBacksOff)
+{
+    m_actions.inquiryResults.push_back(ERROR_FAILED);
+    m_reconnect.Poll();
+    EXPECT_EQ(RECONNECT_STATE_BACKOFF, m_reconnect.GetState());
+    EXPECT_EQ(1u, m_actions.inquiryCount);
+}
+
+TEST_F(ReconnectStateMachineTest, BackoffDoublesUpToTheCap)
+{
+    m_actions.inquiryDefault = STATUS_SUCCESS;
+
+    // Each round is an empty inquiry followed by a backoff.
+    INT32U expectedMS[] = {TEST_MIN_BACKOFF_MS, 2 * TEST_MIN_BACKOFF_MS, TEST_MAX_BACKOFF_MS, TEST_MAX_BACKOFF_MS};
+    m_reconnect.Poll();
+    for (INT32U round = 0; round < 4; round++)
+    {
+        ASSERT_EQ(RECONNECT_STATE_BACKOFF, m_reconnect.GetState());
+        AdvanceMS(expectedMS[round] - 10);
+        m_reconnect.Poll();
+        EXPECT_EQ(RECONNECT_STATE_BACKOFF, m_reconnect.GetState());
+        AdvanceMS(10);
+        m_reconnect.Poll();
+        EXPECT_EQ(RECONNECT_STATE_INQUIRY, m_reconnect.GetState());
+        m_reconnect.Poll();
+    }
+    EXPECT_EQ(5u, m_actions.inquiryCount);
+}
+
+TEST_F(ReconnectStateMachineTest, DroppedLinkStartsANewRound)
+{
+    m_reconnect.Poll();
+    m_reconnect.OnInquiryResult(PEER_A);
+    m_actions.connected = true;
+    m_reconnect.Poll();
+    ASSERT_EQ(PEER_A, m_reconnect.GetPeer());
+
+    m_actions.connected = false;
+    m_reconnect.Poll();
+    EXPECT_EQ(RECONNECT_STATE_INQUIRY, m_reconnect.GetState());
+    EXPECT_TRUE(m_reconnect.GetPeer().empty());
+
+    // The new round's peer comes from its own inquiry only.
+    m_reconnect.OnInquiryResult(PEER_B);
+    m_actions.connected = true;
+    m_reconnect.Poll();
+    EXPECT_EQ(PEER_B, m_reconnect.GetPeer());
+}
+
+TEST_F(ReconnectStateMachineTest, ConnectingResetsTheBackoff)
+{
+    m_actions.inquiryDefault = STATUS_SUCCESS;
+    m_reconnect.Poll();
+    AdvanceMS(TEST_MIN_BACKOFF_MS);
+    m_reconnect.Poll();
+    m_reconnect.Poll();
+    ASSERT_EQ(RECONNECT_STATE_BACKOFF, m_reconnect.GetState());
+
+    m_actions.connected = true;
+    m_reconnect.Poll();
+    m_actions.connected = false;
+    m_reconnect.Poll();
+    m_reconnect.Poll();
+    ASSERT_EQ(RECONNECT_STATE_BACKOFF, m_reconnect.GetState());
+    AdvanceMS(TEST_MIN_BACKOFF_MS);
+    m_reconnect.Poll();
+    EXPECT_EQ(RECONNECT_STATE_INQUIRY, m_reconnect.GetState());
+}
@@ -0,0 +1,215 @@
+#include <gtest/gtest.h>
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include "SharedAdapterState.h"
+
+#define TEST_NUM_CARDS 4
+#define TEST_PUBLISH_COUNT 50000
+
+// Every field of a published state is derived from one counter, so a
+// snapshot mixing two updates can't satisfy IsConsistent.
+static void FillState(SharedCardState &state, uint64_t counter)
+{
+    state.isOnline = 1;
+    state.isConnected = (INT8U)(counter & 1);
+    state.numDetected = (INT16U)(counter % SHARED_ADAPTER_MAX_DETECTED);
+    state.peerAddress = counter;
+    memset(state.peerName, 'a' + (CHAR8)(counter % 26), sizeof(state.peerName) - 1);
+    state.peerName[sizeof(state.peerName) - 1] = '\0';
+    for (INT32U i = 0; i < SHARED_ADAPTER_MAX_DETECTED; i++)
+    {
+        state.detected[i].address = counter;
+        memset(state.detected[i].name, 'A' + (CHAR8)(counter % 26), sizeof(state.detected[i].name) - 1);
+        state.detected[i].name[sizeof(state.detected[i].name) - 1] = '\0';
+    }
+}
+
+static bool IsConsistent(const SharedCardState &state)
+{
+    SharedCardState expected;
+    memset(&expected, 0, sizeof(expected));
+    FillState(expected, state.peerAddress);
+    return memcmp(&expected, &state, sizeof(state)) == 0;
+}
+
+class SharedAdapterStateTest : public ::testing::Test
+{
+  protected:
+    void SetUp() override
+    {
+        m_name = string("/bta-state-test-") + to_string(getpid()) + "-" +
+                 ::testing::UnitTest::GetInstance()->current_test_info()->name();
+        ASSERT_EQ(STATUS_SUCCESS, m_writer.Create(m_name, TEST_NUM_CARDS));
+    }
+
+    void TearDown() override
+    {
+        m_writer.Close();
+    }
+
+    void Publish(INT16U cardNumber, uint64_t counter)
+    {
+        SharedCardState *pState = m_writer.BeginUpdate(cardNumber);
+        ASSERT_TRUE(pState != NULL);
+        FillState(*pState, counter);
+        m_writer.EndUpdate(cardNumber);
+    }
+
+    // Maps the header writable, the way a writer from an older or newer
+    // build would have laid it out.
+    SharedAdapterStateHeader *MapHeader(void)
+    {
+        int fd = shm_open(m_name.c_str(), O_RDWR, 0);
+        if (fd < 0)
+            return NULL;
+        void *pMapping = mmap(NULL, sizeof(SharedAdapterStateHeader), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        return (pMapping == MAP_FAILED) ? NULL : (SharedAdapterStateHeader *)pMapping;
+    }
+
+    string m_name;
+    CSharedAdapterStateWriter m_writer;
+};
+
+TEST_F(SharedAdapterStateTest, SlotsAreCacheLineAligned)
+{
+    EXPECT_EQ(0u, alignof(SharedCardSlot) % SHARED_ADAPTER_CACHE_LINE);
+    EXPECT_EQ(0u, sizeof(SharedCardSlot) % SHARED_ADAPTER_CACHE_LINE);
+
+    // Each card lands in its own slot as seen from another mapping.
+    for (INT16U card = 0; card < TEST_NUM_CARDS; card++)
+    {
+        Publish(card, 100 + card);
+    }
+
+    CSharedAdapterStateReader reader;
+    ASSERT_EQ(STATUS_SUCCESS, reader.Open(m_name));
+    ASSERT_EQ(TEST_NUM_CARDS, reader.GetNumCards());
+    for (INT16U card = 0; card < TEST_NUM_CARDS; card++)
+    {
+        SharedCardState state;
+        ASSERT_EQ(STATUS_SUCCESS, reader.ReadCard(card, state));
+        EXPECT_EQ(100u + card, state.peerAddress);
+        EXPECT_TRUE(IsConsistent(state));
+    }
+
+    SharedCardState state;
+    EXPECT_EQ(ERROR_INVALID_PARAMETER, reader.ReadCard(TEST_NUM_CARDS, state));
+    EXPECT_TRUE(m_writer.BeginUpdate(TEST_NUM_CARDS) == NULL);
+}
+
+TEST_F(SharedAdapterStateTest, ReaderNeverSeesATornSnapshot)
+{
+    Publish(1, 0);
+
+    CSharedAdapterStateReader reader;
+    ASSERT_EQ(STATUS_SUCCESS, reader.Open(m_name));
+
+    atomic<bool> done(false);
+    // The writer gives up the CPU halfway through each update, so the
+    // reader also runs into half-written slots on a single core.
+    thread writer([this, &done]() {
+        for (uint64_t counter = 1; counter <= TEST_PUBLISH_COUNT; counter++)
+        {
+            SharedCardState *pState = m_writer.BeginUpdate(1);
+            FillState(*pState, counter);
+            pState->peerAddress = counter - 1;
+            this_thread::yield();
+            pState->peerAddress = counter;
+            m_writer.EndUpdate(1);
+        }
+        done = true;
+    });
+
+    INT32U reads = 0;
+    INT32U torn = 0;
+    uint64_t lastSeen = 0;
+    bool wentBackwards = false;
+    while (!done)
+    {
+        SharedCardState state;
+        if (reader.ReadCard(1, state) != STATUS_SUCCESS)
+            continue;
+
+        reads++;
+        if (!IsConsistent(state))
+            torn++;
+        if (state.peerAddress < lastSeen)
+            wentBackwards = true;
+        lastSeen = state.peerAddress;
+    }
+    writer.join();
+
+    EXPECT_GT(reads, 0u);
+    EXPECT_EQ(0u, torn);
+    EXPECT_FALSE(wentBackwards);
+
+    SharedCardState state;
+    ASSERT_EQ(STATUS_SUCCESS, reader.ReadCard(1, state));
+    EXPECT_EQ((uint64_t)TEST_PUBLISH_COUNT, state.peerAddress);
+}
+
+TEST_F(SharedAdapterStateTest, ReadTimesOutWhileTheWriterHoldsTheSlot)
+{
+    CSharedAdapterStateReader reader;
+    ASSERT_EQ(STATUS_SUCCESS, reader.Open(m_name));
+
+    ASSERT_TRUE(m_writer.BeginUpdate(2) != NULL);
+    SharedCardState state;
+    EXPECT_EQ(ERROR_OPERATION_TIMED_OUT, reader.ReadCard(2, state));
+    // Other cards stay readable.
+    EXPECT_EQ(STATUS_SUCCESS, reader.ReadCard(3, state));
+
+    m_writer.EndUpdate(2);
+    EXPECT_EQ(STATUS_SUCCESS, reader.ReadCard(2, state));
+}
+
+TEST_F(SharedAdapterStateTest, OpenRejectsAForeignLayout)
+{
+    SharedAdapterStateHeader *pHeader = MapHeader();
+    ASSERT_TRUE(pHeader != NULL);
+    CSharedAdapterStateReader reader;
+
+    pHeader->version = SHARED_ADAPTER_STATE_VERSION + 1;
+    EXPECT_EQ(ERROR_INVALID_CONFIGURATION, reader.Open(m_name));
+    pHeader->version = SHARED_ADAPTER_STATE_VERSION;
+
+    pHeader->slotSize = sizeof(SharedCardSlot) - SHARED_ADAPTER_CACHE_LINE;
+    EXPECT_EQ(ERROR_INVALID_CONFIGURATION, reader.Open(m_name));
+    pHeader->slotSize = sizeof(SharedCardSlot);
+
+    // More cards than the mapping holds.
+    pHeader->numCards = TEST_NUM_CARDS + 1;
+    EXPECT_EQ(ERROR_INVALID_CONFIGURATION, reader.Open(m_name));
+    pHeader->numCards = TEST_NUM_CARDS;
+
+    pHeader->magic = 0;
+    EXPECT_EQ(ERROR_INVALID_CONFIGURATION, reader.Open(m_name));
+    pHeader->magic = SHARED_ADAPTER_STATE_MAGIC;
+
+    EXPECT_EQ(STATUS_SUCCESS, reader.Open(m_name));
+    munmap(pHeader, sizeof(SharedAdapterStateHeader));
+}
+
+TEST_F(SharedAdapterStateTest, OpenFailsWithoutAWriter)
+{
+    CSharedAdapterStateReader reader;
+    m_writer.Close();
+    EXPECT_EQ(ERROR_NOT_INITIALIZED, reader.Open(m_name));
+
+    // A mapping too short to hold the header.
+    int fd = shm_open(m_name.c_str(), O_CREAT | O_RDWR, 0600);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(0, ftruncate(fd, sizeof(SharedAdapterStateHeader) - 1));
+    close(fd);
+    EXPECT_EQ(ERROR_NOT_INITIALIZED, reader.Open(m_name));
+    shm_unlink(m_name.c_str());
+}
@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+
+#include "FakeUart.h"
+#include "UartDrain.h"
+#include "VirtualClockTest.h"
+
+// A module that never stops talking: every read finds a few more bytes,
+// each costing the time they take on the wire.
+class CChattyUart : public CFakeUart
+{
+  public:
+    INT32U RxBytesAvailable(void) override
+    {
+        if (m_rx.empty())
+            QueueRx("noise");
+        return CFakeUart::RxBytesAvailable();
+    }
+
+    void ReadPort(INT8U *pBuf, INT32U maxBytes, INT32U *pBytesRead) override
+    {
+        GetClockSource().SleepUs(100);
+        CFakeUart::ReadPort(pBuf, maxBytes, pBytesRead);
+    }
+};
+
+class UartDrainTest : public VirtualClockTest
+{
+  protected:
+    UartDrainTest() : VirtualClockTest(true)
+    {
+    }
+};
+
+TEST_F(UartDrainTest, CharTimeFollowsBaudRate)
+{
+    EXPECT_EQ(87u, UartCharTimeUs(BAUDRATE_115200));
+    EXPECT_EQ(1042u, UartCharTimeUs(BAUDRATE_9600));
+    // Unknown rates are treated as the slowest one.
+    EXPECT_EQ(1042u, UartCharTimeUs(BAUDRATE_UNKNOWN));
+}
+
+TEST_F(UartDrainTest, ReturnsOnceTheLineGoesQuiet)
+{
+    CFakeUart uart;
+    uart.QueueRx(string(600, 'x'));
+
+    INT32U drained = 0;
+    ASSERT_EQ(STATUS_SUCCESS, UartDrainUntilQuiet(&uart, BAUDRATE_115200, 1000, UART_DRAIN_DEFAULT_QUIET_CHARS, &drained));
+    EXPECT_EQ(600u, drained);
+    EXPECT_EQ(0u, uart.RxBytesAvailable());
+    // The quiet window, not the 1 s upper bound.
+    EXPECT_LT(m_clock.GetNowUs(), 5000u);
+}
+
+TEST_F(UartDrainTest, TimeoutBelowOneTimerTickStillDrains)
+{
+    CChattyUart uart;
+
+    INT32U drained = 0;
+    ASSERT_EQ(STATUS_SUCCESS, UartDrainUntilQuiet(&uart, BAUDRATE_115200, 5, UART_DRAIN_DEFAULT_QUIET_CHARS, &drained));
+    EXPECT_GT(drained, 0u);
+    EXPECT_GE(m_clock.GetNowUs(), 5000u);
+    EXPECT_LT(m_clock.GetNowUs(), 6000u);
+}
+
+TEST_F(UartDrainTest, QuietLineCostsOnlyTheQuietWindow)
+{
+    CFakeUart uart;
+
+    ASSERT_EQ(STATUS_SUCCESS, UartDrainUntilQuiet(&uart, BAUDRATE_9600, 1000, 4));
+    // Four character times at 9600 baud, about 4.2 ms.
+    EXPECT_GE(m_clock.GetNowUs(), 4168u);
+    EXPECT_LT(m_clock.GetNowUs(), 6000u);
+}
@@ -0,0 +1,167 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "WorkStealingExecutor.h"
+
+#define TEST_WAIT_MS 2000
+
+static bool WaitFor(const atomic<INT32U> &counter, INT32U expected)
+{
+    chrono::steady_clock::time_point deadline = chrono::steady_clock::now() + chrono::milliseconds(TEST_WAIT_MS);
+    while (counter < expected)
+    {
+        if (chrono::steady_clock::now() > deadline)
+            return false;
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    return true;
+}
+
+TEST(WorkStealingExecutorTest, IdleWorkerStealsFromBusyOne)
+{
+    CWorkStealingExecutor executor(2);
+    ASSERT_EQ(STATUS_SUCCESS, executor.Start());
+
+    // Work spawned by a task lands on its own worker's deque; that worker
+    // then blocks until all of it has run, so only a thief can run it.
+    const INT32U numTasks = 32;
+    atomic<INT32U> done(0);
+    atomic<bool> drained(false);
+    executor.Submit([&]() {
+        for (INT32U i = 0; i < numTasks; i++)
+        {
+            executor.Submit([&]() { done++; });
+        }
+        drained = WaitFor(done, numTasks);
+    });
+
+    ASSERT_TRUE(WaitFor(done, numTasks));
+    executor.Stop();
+    EXPECT_TRUE(drained);
+    // The spawning task itself may have been stolen as well.
+    EXPECT_GE(executor.GetStealCount(), numTasks);
+}
+
+TEST(WorkStealingExecutorTest, StrandRunsTasksInOrderWithoutOverlap)
+{
+    CWorkStealingExecutor executor(4);
+    ASSERT_EQ(STATUS_SUCCESS, executor.Start());
+    shared_ptr<CExecutorStrand> pStrand = make_shared<CExecutorStrand>(&executor);
+
+    // More than one batch, so the strand has to requeue itself part way.
+    const INT32U numTasks = 100;
+    vector<INT32U> order;
+    atomic<INT32U> running(0);
+    atomic<INT32U> overlaps(0);
+    atomic<INT32U> done(0);
+    for (INT32U i = 0; i < numTasks; i++)
+    {
+        ASSERT_EQ(STATUS_SUCCESS, pStrand->Post([&, i]() {
+            if (running.fetch_add(1) != 0)
+                overlaps++;
+            order.push_back(i);
+            running--;
+            done++;
+        }));
+    }
+
+    ASSERT_TRUE(WaitFor(done, numTasks));
+    executor.Stop();
+    EXPECT_EQ(0u, overlaps);
+    ASSERT_EQ(numTasks, order.size());
+    for (INT32U i = 0; i < numTasks; i++)
+    {
+        EXPECT_EQ(i, order[i]);
+    }
+}
+
+TEST(WorkStealingExecutorTest, DelayedTasksRunInDueOrder)
+{
+    CWorkStealingExecutor executor(2);
+    ASSERT_EQ(STATUS_SUCCESS, executor.Start());
+
+    mutex orderLock;
+    vector<INT32U> order;
+    atomic<INT32U> done(0);
+    INT32U delaysMS[] = {30, 10, 40, 20};
+    for (INT32U i = 0; i < 4; i++)
+    {
+        executor.SubmitAfter(delaysMS[i], [&, i]() {
+            lock_guard<mutex> guard(orderLock);
+            order.push_back(i);
+            done++;
+        });
+    }
+
+    ASSERT_TRUE(WaitFor(done, 4));
+    executor.Stop();
+    vector<INT32U> expected = {1, 3, 0, 2};
+    EXPECT_EQ(expected, order);
+}
+
+TEST(WorkStealingExecutorTest, StrandRunsAgainAfterRestart)
+{
+    CWorkStealingExecutor executor(1);
+    ASSERT_EQ(STATUS_SUCCESS, executor.Start());
+    shared_ptr<CExecutorStrand> pStrand = make_shared<CExecutorStrand>(&executor);
+
+    // Hold the only worker so the strand's drain is still queued at Stop.
+    promise<void> release;
+    shared_future<void> released = release.get_future().share();
+    atomic<INT32U> started(0);
+    executor.Submit([&]() {
+        started++;
+        released.wait();
+    });
+    ASSERT_TRUE(WaitFor(started, 1));
+
+    atomic<INT32U> staleRuns(0);
+    ASSERT_EQ(STATUS_SUCCESS, pStrand->Post([&]() { staleRuns++; }));
+    thread stopper([&]() { executor.Stop(); });
+    this_thread::sleep_for(chrono::milliseconds(10));
+    release.set_value();
+    stopper.join();
+
+    ASSERT_EQ(STATUS_SUCCESS, executor.Start());
+    atomic<INT32U> done(0);
+    ASSERT_EQ(STATUS_SUCCESS, pStrand->Post([&]() { done++; }));
+    EXPECT_TRUE(WaitFor(done, 1));
+    executor.Stop();
+    EXPECT_EQ(0u, staleRuns);
+}
+
+TEST(WorkStealingExecutorTest, BlockingTaskLeavesWorkersFree)
+{
+    CWorkStealingExecutor executor(1);
+    ASSERT_EQ(STATUS_SUCCESS, executor.Start());
+    shared_ptr<CExecutorStrand> pBlocked = make_shared<CExecutorStrand>(&executor);
+    shared_ptr<CExecutorStrand> pOther = make_shared<CExecutorStrand>(&executor);
+
+    // The blocking task only returns once the other strand has run on the
+    // single worker, which it couldn't if the blocking task held it.
+    atomic<INT32U> otherRan(0);
+    atomic<INT32U> blockedDone(0);
+    atomic<INT32U> afterBlocked(0);
+    atomic<bool> sawOther(false);
+    ASSERT_EQ(STATUS_SUCCESS, pBlocked->PostBlocking([&]() {
+        sawOther = WaitFor(otherRan, 1);
+        blockedDone++;
+    }));
+    ASSERT_EQ(STATUS_SUCCESS, pBlocked->Post([&]() {
+        // Strand order still holds across the blocking task.
+        if (blockedDone == 1)
+            afterBlocked++;
+    }));
+    ASSERT_EQ(STATUS_SUCCESS, pOther->Post([&]() { otherRan++; }));
+
+    EXPECT_TRUE(WaitFor(afterBlocked, 1));
+    executor.Stop();
+    EXPECT_TRUE(sawOther);
+}